@@ -41,6 +41,7 @@
 #include <stdio.h>
 
 #include "antelope.h"
+#include "storage.h"
 
 static db_output_function_t output = printf;
 
@@ -51,6 +52,12 @@ db_init(void)
   index_init();
 }
 
+db_result_t
+db_flush(void)
+{
+  return storage_flush();
+}
+
 void
 db_set_output_function(db_output_function_t f)
 {
@@ -44,6 +44,7 @@
 typedef int (*db_output_function_t)(const char *, ...);
 
 void db_init(void);
+db_result_t db_flush(void);
 void db_set_output_function(db_output_function_t f);
 const char *db_get_result_message(db_result_t code);
 db_result_t db_print_header(db_handle_t *handle);
@@ -87,6 +87,8 @@ aql_clear(aql_adt_t *adt)
   adt->attribute_count = 0;
   adt->value_count = 0;
   adt->flags = 0;
+  adt->group_attribute = 0;
+  adt->window = 0;
   memset(adt->aggregators, 0, sizeof(adt->aggregators));
 }
 
@@ -62,6 +62,66 @@ clear_handle(db_handle_t *handle)
   handle->join_rel = NULL;
 }
 
+#if DB_FEATURE_JOIN
+static int
+is_integer(attribute_t *attr)
+{
+  return attr->domain == DOMAIN_INT || attr->domain == DOMAIN_LONG;
+}
+
+/*
+ * Choose the join operator. A merge join is used when both relations
+ * have an inline index on the join attribute, since they are then
+ * stored in the order of the attribute. Otherwise, the cost of
+ * looking up each left row in the index of the right relation is
+ * compared with the cost of reading both relations once in a hash
+ * join, which requires that the smaller relation fits in the hash
+ * table.
+ */
+static uint8_t
+plan_join(db_handle_t *handle, aql_adt_t *adt)
+{
+  attribute_t *left_attr;
+  attribute_t *right_attr;
+  index_t *left_index;
+  index_t *right_index;
+  tuple_id_t left_cardinality;
+  tuple_id_t right_cardinality;
+  int hashable;
+
+  left_attr = relation_attribute_get(handle->left_rel, adt->attributes[0].name);
+  right_attr = relation_attribute_get(handle->right_rel, adt->attributes[0].name);
+  if(left_attr == NULL || right_attr == NULL ||
+     !is_integer(left_attr) || !is_integer(right_attr)) {
+    return DB_JOIN_INDEX;
+  }
+
+  left_index = (index_t *)left_attr->index;
+  right_index = (index_t *)right_attr->index;
+  if(left_index != NULL && left_index->type == INDEX_INLINE &&
+     right_index != NULL && right_index->type == INDEX_INLINE) {
+    return DB_JOIN_MERGE;
+  }
+
+  left_cardinality = relation_cardinality(handle->left_rel);
+  right_cardinality = relation_cardinality(handle->right_rel);
+  if(left_cardinality == INVALID_TUPLE || right_cardinality == INVALID_TUPLE) {
+    return DB_JOIN_INDEX;
+  }
+
+  hashable = left_cardinality <= DB_JOIN_HASH_ROWS ||
+             right_cardinality <= DB_JOIN_HASH_ROWS;
+
+  if(index_exists(right_attr) &&
+     (!hashable || (unsigned long)left_cardinality * DB_JOIN_INDEX_COST <
+                   (unsigned long)left_cardinality + right_cardinality)) {
+    return DB_JOIN_INDEX;
+  }
+
+  return hashable ? DB_JOIN_HASH : DB_JOIN_INDEX;
+}
+#endif /* DB_FEATURE_JOIN */
+
 static db_result_t
 aql_execute(db_handle_t *handle, aql_adt_t *adt)
 {
@@ -171,6 +231,7 @@ aql_execute(db_handle_t *handle, aql_adt_t *adt)
       relation_release(handle->left_rel);
       break;
     }
+    handle->join_method = plan_join(handle, adt);
     result = relation_join(handle, adt);
     break;
 #endif /* DB_FEATURE_JOIN */
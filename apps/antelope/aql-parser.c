@@ -479,8 +479,52 @@ PARSER(join)
   RETURN(OK);
 }
 
+#if DB_FEATURE_GROUP
+PARSER(group)
+{
+  int i;
+
+  CONSUME(BY);
+  CONSUME(IDENTIFIER);
+
+  /* The rows are grouped by one of the projected attributes. */
+  for(i = 0; i < AQL_ATTRIBUTE_COUNT(adt); i++) {
+    if(adt->aggregators[i] == AQL_NONE &&
+       !(adt->attributes[i].flags & ATTRIBUTE_FLAG_NO_STORE) &&
+       strcmp(adt->attributes[i].name, VALUE) == 0) {
+      break;
+    }
+  }
+  if(i == AQL_ATTRIBUTE_COUNT(adt)) {
+    RETURN(SYNTAX_ERROR);
+  }
+
+  PRINTF("Group by attribute %s\n", VALUE);
+  adt->group_attribute = i;
+  AQL_SET_FLAG(adt, AQL_FLAG_GROUP);
+
+  /* An optional window width puts the values of the attribute
+     into buckets, e.g., for aggregating over time intervals. */
+  NEXT;
+  if(TOKEN == WINDOW) {
+    CONSUME(INTEGER_VALUE);
+    adt->window = *(long *)lexer->value;
+    if(adt->window <= 0) {
+      RETURN(SYNTAX_ERROR);
+    }
+    PRINTF("Window width %ld\n", adt->window);
+  } else {
+    REWIND;
+  }
+
+  RETURN(OK);
+}
+#endif /* DB_FEATURE_GROUP */
+
 PARSER(select)
 {
+  int has_clauses;
+
   AQL_SET_TYPE(adt, AQL_TYPE_SELECT);
 
   /* projection attributes... */
@@ -493,6 +537,8 @@ PARSER(select)
     RETURN(SYNTAX_ERROR);
   }
 
+  has_clauses = 0;
+
   NEXT;
   if(TOKEN == WHERE) {
     lvm_reset(&p, vmcode, sizeof(vmcode));
@@ -502,12 +548,28 @@ PARSER(select)
     }
 
     AQL_SET_CONDITION(adt, &p);
-  } else {
+    has_clauses = 1;
+    NEXT;
+  }
+
+#if DB_FEATURE_GROUP
+  if(TOKEN == GROUP) {
+    if(!PARSE(group)) {
+      RETURN(SYNTAX_ERROR);
+    }
+    has_clauses = 1;
+    NEXT;
+  }
+#endif /* DB_FEATURE_GROUP */
+
+  if(!has_clauses) {
     REWIND;
     RETURN(OK);
   }
 
-  CONSUME(END);
+  if(TOKEN != END) {
+    RETURN(SYNTAX_ERROR);
+  }
 
   return OK;
 }
@@ -645,6 +707,9 @@ PARSER_TOKEN(index_type)
   case MEMHASH:
     type = INDEX_MEMHASH;
     break;
+  case BTREE:
+    type = INDEX_BTREE;
+    break;
   default:
     return NONE;
   };
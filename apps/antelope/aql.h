@@ -104,6 +104,10 @@ enum token {
   MEMHASH = 46,
   RELATION = 47,
   ATTRIBUTE = 48,
+  GROUP = 49,
+  BY = 50,
+  WINDOW = 51,
+  BTREE = 52,
 
   INTEGER_VALUE = 251,
   FLOAT_VALUE = 252,
@@ -151,6 +155,8 @@ struct aql_adt {
   aql_aggregator_t aggregators[AQL_ATTRIBUTE_LIMIT];
   attribute_value_t values[AQL_ATTRIBUTE_LIMIT];
   index_type_t index_type;
+  long window;
+  uint8_t group_attribute;
   uint8_t relation_count;
   uint8_t attribute_count;
   uint8_t value_count;
@@ -179,6 +185,7 @@ typedef struct aql_adt aql_adt_t;
 #define AQL_FLAG_AGGREGATE		1
 #define AQL_FLAG_ASSIGN			2
 #define AQL_FLAG_INVERSE_LOGIC		4
+#define AQL_FLAG_GROUP			8
 
 #define AQL_CLEAR(adt)			aql_clear(adt)
 #define AQL_SET_TYPE(adt, type)	(((adt))->optype = (type))
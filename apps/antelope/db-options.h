@@ -54,6 +54,11 @@
 #define DB_FEATURE_REMOVE		1
 #endif /* DB_FEATURE_REMOVE */
 
+/* Support grouped and windowed aggregates (GROUP BY). */
+#ifndef DB_FEATURE_GROUP
+#define DB_FEATURE_GROUP		1
+#endif /* DB_FEATURE_GROUP */
+
 /* Support floating-point values in attributes. */
 #ifndef DB_FEATURE_FLOATS
 #define DB_FEATURE_FLOATS		0
@@ -103,6 +108,47 @@
 #define DB_MAX_ELEMENT_SIZE		16
 #endif /* DB_MAX_ELEMENT_SIZE */
 
+/* The size of the buffers used for reading and appending rows in
+   blocks. Rows longer than this are accessed one at a time. */
+#ifndef DB_ROW_BLOCK_SIZE
+#define DB_ROW_BLOCK_SIZE		128
+#endif /* DB_ROW_BLOCK_SIZE */
+
+/* The number of relations that can have a block of rows buffered
+   for reading at the same time. A join needs two. */
+#ifndef DB_ROW_BLOCK_COUNT
+#define DB_ROW_BLOCK_COUNT		2
+#endif /* DB_ROW_BLOCK_COUNT */
+
+/* The maximum number of rows in the smaller relation of a hash join.
+   The hash table is allocated from the mmem pool during the join,
+   and needs 12 bytes per row on most platforms. */
+#ifndef DB_JOIN_HASH_ROWS
+#define DB_JOIN_HASH_ROWS		128
+#endif /* DB_JOIN_HASH_ROWS */
+
+/* The number of hash chains in the hash table of a hash join. */
+#ifndef DB_JOIN_HASH_BUCKETS
+#define DB_JOIN_HASH_BUCKETS		16
+#endif /* DB_JOIN_HASH_BUCKETS */
+
+/* The cost of looking up the rows that match a join key through an
+   index, relative to reading one row sequentially. The join planner
+   uses it to choose between an index join and a hash join. */
+#ifndef DB_JOIN_INDEX_COST
+#define DB_JOIN_INDEX_COST		4
+#endif /* DB_JOIN_INDEX_COST */
+
+/* The maximum number of groups in a GROUP BY query. The group table
+   is allocated from the mmem pool while the query is processed. */
+#ifndef DB_GROUP_LIMIT
+#define DB_GROUP_LIMIT			16
+#endif /* DB_GROUP_LIMIT */
+
+/* The number of hash chains in the group table. */
+#ifndef DB_GROUP_HASH_BUCKETS
+#define DB_GROUP_HASH_BUCKETS		8
+#endif /* DB_GROUP_HASH_BUCKETS */
 
 /* The maximum size of the LVM bytecode compiled from a
    single database query. */
@@ -206,6 +252,28 @@
 #define DB_HEAP_CACHE_LIMIT		1
 #endif /* DB_HEAP_CACHE_LIMIT */
 
+/* The maximum number of B+-tree indexes. */
+#ifndef DB_BTREE_INDEX_LIMIT
+#define DB_BTREE_INDEX_LIMIT		2
+#endif /* DB_BTREE_INDEX_LIMIT */
+
+/* The size of a B+-tree page. Each page holds (size - 8) / 8 keys. */
+#ifndef DB_BTREE_PAGE_SIZE
+#define DB_BTREE_PAGE_SIZE		128
+#endif /* DB_BTREE_PAGE_SIZE */
+
+/* The number of B+-tree pages cached in RAM, shared by all B+-tree
+   indexes. The cache should hold at least the path from the root
+   to a leaf. */
+#ifndef DB_BTREE_CACHE_SIZE
+#define DB_BTREE_CACHE_SIZE		4
+#endif /* DB_BTREE_CACHE_SIZE */
+
+/* The file size to reserve for a B+-tree index when using Coffee. */
+#ifndef DB_BTREE_RESERVE_SIZE
+#define DB_BTREE_RESERVE_SIZE		(16 * 1024UL)
+#endif /* DB_BTREE_RESERVE_SIZE */
+
 /*----------------------------------------------------------------------------*/
 
 /* LVM options. */
@@ -0,0 +1,689 @@
+/*
+ * Copyright (c) 2010, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *     A B+-tree index stored in a CFS file.
+ *
+ *     The tree consists of fixed-size pages. Internal pages hold
+ *     (key, child page) pairs, in which the key is the smallest key in
+ *     the subtree of the child. Leaf pages hold (key, tuple ID) pairs
+ *     sorted by the key, and are linked from left to right so that a
+ *     range can be scanned sequentially once its first key has been
+ *     found.
+ *
+ *     When a key is appended at the end of the rightmost leaf, a full
+ *     page is not split in half; the new key starts a new page
+ *     instead. Hence, loading keys in ascending order, as when indexing
+ *     a relation of time-stamped samples, builds the tree bottom-up
+ *     with full pages, and each page is written only while it is the
+ *     rightmost one.
+ *
+ *     Recently used pages are kept in a small cache, whose size is set
+ *     by DB_BTREE_CACHE_SIZE. Modified pages are written through to
+ *     storage immediately.
+ */
+
+#include <string.h>
+
+#include "cfs/cfs.h"
+#include "lib/memb.h"
+
+#include "db-options.h"
+#include "index.h"
+#include "result.h"
+#include "storage.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#define BTREE_MAGIC		0x42542b31UL
+#define BTREE_MAX_HEIGHT	8
+#define BTREE_NO_PAGE		0
+
+typedef int32_t btree_key_t;
+typedef uint32_t btree_page_id_t;
+
+struct btree_entry {
+  btree_key_t key;
+  uint32_t value;
+};
+
+#define BTREE_PAGE_HEADER_SIZE	8
+#define BTREE_FANOUT							\
+  ((DB_BTREE_PAGE_SIZE - BTREE_PAGE_HEADER_SIZE) / sizeof(struct btree_entry))
+
+struct btree_page {
+  uint8_t leaf;
+  uint8_t count;
+  uint16_t unused;
+  /* The right sibling of a leaf page. */
+  btree_page_id_t next;
+  struct btree_entry entries[BTREE_FANOUT];
+};
+
+/* The header is stored in the place of page 0. */
+struct btree_header {
+  uint32_t magic;
+  btree_page_id_t root;
+  btree_page_id_t page_count;
+  btree_page_id_t last_leaf;
+  uint8_t height;
+};
+
+struct btree {
+  db_storage_id_t fd;
+  struct btree_header header;
+};
+
+struct page_cache {
+  struct btree *tree;
+  btree_page_id_t page_id;
+  uint16_t last_use;
+  struct btree_page page;
+};
+
+/* The position of the range scan in progress. */
+struct cursor {
+  index_iterator_t *iterator;
+  struct btree *tree;
+  btree_page_id_t page_id;
+  uint8_t slot;
+};
+
+static struct page_cache page_cache[DB_BTREE_CACHE_SIZE];
+static uint16_t cache_clock;
+static struct btree_page new_page;
+static struct cursor cursor;
+
+MEMB(btrees, struct btree, DB_BTREE_INDEX_LIMIT);
+
+static db_result_t create(index_t *);
+static db_result_t destroy(index_t *);
+static db_result_t load(index_t *);
+static db_result_t release(index_t *);
+static db_result_t insert(index_t *, attribute_value_t *, tuple_id_t);
+static db_result_t delete(index_t *, attribute_value_t *);
+static tuple_id_t get_next(index_iterator_t *);
+
+index_api_t index_btree = {
+  INDEX_BTREE,
+  INDEX_API_EXTERNAL | INDEX_API_RANGE_QUERIES,
+  create,
+  destroy,
+  load,
+  release,
+  insert,
+  delete,
+  get_next
+};
+
+static unsigned long
+page_offset(btree_page_id_t page_id)
+{
+  return (unsigned long)page_id * sizeof(struct btree_page);
+}
+
+static struct btree_page *
+page_get(struct btree *tree, btree_page_id_t page_id)
+{
+  struct page_cache *entry;
+  struct page_cache *victim;
+  int i;
+
+  victim = &page_cache[0];
+  for(i = 0; i < DB_BTREE_CACHE_SIZE; i++) {
+    entry = &page_cache[i];
+    if(entry->tree == tree && entry->page_id == page_id) {
+      entry->last_use = ++cache_clock;
+      return &entry->page;
+    }
+    if(entry->tree == NULL) {
+      victim = entry;
+    } else if(victim->tree != NULL &&
+              (uint16_t)(cache_clock - entry->last_use) >
+              (uint16_t)(cache_clock - victim->last_use)) {
+      victim = entry;
+    }
+  }
+
+  victim->tree = NULL;
+  if(DB_ERROR(storage_read(tree->fd, &victim->page, page_offset(page_id),
+                           sizeof(victim->page)))) {
+    PRINTF("DB: Failed to read B+-tree page %lu\n", (unsigned long)page_id);
+    return NULL;
+  }
+
+  victim->tree = tree;
+  victim->page_id = page_id;
+  victim->last_use = ++cache_clock;
+  return &victim->page;
+}
+
+static db_result_t
+page_put(struct btree *tree, btree_page_id_t page_id, struct btree_page *page)
+{
+  int i;
+
+  if(page == &new_page) {
+    /* Replace any cached copy of a page that is written from outside
+       the cache. */
+    for(i = 0; i < DB_BTREE_CACHE_SIZE; i++) {
+      if(page_cache[i].tree == tree && page_cache[i].page_id == page_id) {
+        memcpy(&page_cache[i].page, page, sizeof(*page));
+      }
+    }
+  }
+
+  return storage_write(tree->fd, page, page_offset(page_id), sizeof(*page));
+}
+
+static void
+cache_invalidate(struct btree *tree)
+{
+  int i;
+
+  for(i = 0; i < DB_BTREE_CACHE_SIZE; i++) {
+    if(page_cache[i].tree == tree) {
+      page_cache[i].tree = NULL;
+    }
+  }
+
+  if(cursor.tree == tree) {
+    cursor.tree = NULL;
+    cursor.iterator = NULL;
+  }
+}
+
+static db_result_t
+header_put(struct btree *tree)
+{
+  return storage_write(tree->fd, &tree->header, 0, sizeof(tree->header));
+}
+
+/* The child to descend into when searching for the first occurrence
+   of the key. */
+static int
+child_lower(struct btree_page *page, btree_key_t key)
+{
+  int i;
+
+  for(i = page->count - 1; i > 0; i--) {
+    if(page->entries[i].key < key) {
+      break;
+    }
+  }
+  return i;
+}
+
+/* The child to descend into when inserting the key after all
+   occurrences of it. */
+static int
+child_upper(struct btree_page *page, btree_key_t key)
+{
+  int i;
+
+  for(i = page->count - 1; i > 0; i--) {
+    if(page->entries[i].key <= key) {
+      break;
+    }
+  }
+  return i;
+}
+
+static int
+leaf_lower(struct btree_page *page, btree_key_t key)
+{
+  int low;
+  int high;
+  int mid;
+
+  for(low = 0, high = page->count; low < high;) {
+    mid = (low + high) / 2;
+    if(page->entries[mid].key < key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static int
+leaf_upper(struct btree_page *page, btree_key_t key)
+{
+  int low;
+  int high;
+  int mid;
+
+  for(low = 0, high = page->count; low < high;) {
+    mid = (low + high) / 2;
+    if(page->entries[mid].key <= key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static db_result_t
+tree_insert(struct btree *tree, btree_key_t key, tuple_id_t tuple_id)
+{
+  btree_page_id_t path[BTREE_MAX_HEIGHT];
+  uint8_t child[BTREE_MAX_HEIGHT];
+  uint8_t rightmost[BTREE_MAX_HEIGHT];
+  struct btree_page *page;
+  struct btree_entry entry;
+  btree_page_id_t page_id;
+  int level;
+  int pos;
+  int half;
+
+  entry.key = key;
+  entry.value = tuple_id;
+
+  if(tree->header.root == BTREE_NO_PAGE) {
+    memset(&new_page, 0, sizeof(new_page));
+    new_page.leaf = 1;
+    new_page.count = 1;
+    new_page.entries[0] = entry;
+    page_id = tree->header.page_count++;
+    if(DB_ERROR(page_put(tree, page_id, &new_page))) {
+      return DB_STORAGE_ERROR;
+    }
+    tree->header.root = tree->header.last_leaf = page_id;
+    tree->header.height = 1;
+    return header_put(tree);
+  }
+
+  /* Find the path to the leaf. For each page on it, remember the
+     position of the child that was taken, and whether the page is the
+     rightmost one on its level. */
+  page_id = tree->header.root;
+  rightmost[0] = 1;
+  for(level = 0; level < tree->header.height - 1; level++) {
+    page = page_get(tree, page_id);
+    if(page == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+    path[level] = page_id;
+    child[level] = child_upper(page, key);
+    rightmost[level + 1] = rightmost[level] &&
+                           child[level] == page->count - 1;
+    page_id = page->entries[child[level]].value;
+  }
+  path[level] = page_id;
+
+  /* Insert the entry at the leaf, and then insert a separator in
+     the parent for each page that was split. */
+  for(; level >= 0; level--) {
+    page = page_get(tree, path[level]);
+    if(page == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+
+    if(page->leaf) {
+      pos = leaf_upper(page, entry.key);
+    } else {
+      pos = child[level] + 1;
+    }
+
+    if(page->count < BTREE_FANOUT) {
+      memmove(&page->entries[pos + 1], &page->entries[pos],
+              (page->count - pos) * sizeof(struct btree_entry));
+      page->entries[pos] = entry;
+      page->count++;
+      return page_put(tree, path[level], page);
+    }
+
+    memset(&new_page, 0, sizeof(new_page));
+    new_page.leaf = page->leaf;
+
+    if(rightmost[level] && pos == page->count) {
+      /* Appending: leave the full page as it is. */
+      new_page.entries[0] = entry;
+      new_page.count = 1;
+    } else {
+      half = page->count / 2;
+      new_page.count = page->count - half;
+      memcpy(new_page.entries, &page->entries[half],
+             new_page.count * sizeof(struct btree_entry));
+      page->count = half;
+      if(pos <= half) {
+        memmove(&page->entries[pos + 1], &page->entries[pos],
+                (page->count - pos) * sizeof(struct btree_entry));
+        page->entries[pos] = entry;
+        page->count++;
+      } else {
+        pos -= half;
+        memmove(&new_page.entries[pos + 1], &new_page.entries[pos],
+                (new_page.count - pos) * sizeof(struct btree_entry));
+        new_page.entries[pos] = entry;
+        new_page.count++;
+      }
+    }
+
+    page_id = tree->header.page_count++;
+    if(page->leaf) {
+      new_page.next = page->next;
+      page->next = page_id;
+      if(tree->header.last_leaf == path[level]) {
+        tree->header.last_leaf = page_id;
+      }
+    }
+
+    PRINTF("DB: Split B+-tree page %lu into %lu (%u + %u entries)\n",
+           (unsigned long)path[level], (unsigned long)page_id,
+           (unsigned)page->count, (unsigned)new_page.count);
+
+    if(DB_ERROR(page_put(tree, path[level], page)) ||
+       DB_ERROR(page_put(tree, page_id, &new_page))) {
+      return DB_STORAGE_ERROR;
+    }
+
+    if(DB_ERROR(header_put(tree))) {
+      return DB_STORAGE_ERROR;
+    }
+
+    entry.key = new_page.entries[0].key;
+    entry.value = page_id;
+  }
+
+  /* The root was split. */
+  if(tree->header.height == BTREE_MAX_HEIGHT) {
+    return DB_LIMIT_ERROR;
+  }
+  memset(&new_page, 0, sizeof(new_page));
+  new_page.count = 2;
+  new_page.entries[0].value = tree->header.root;
+  new_page.entries[1] = entry;
+  page_id = tree->header.page_count++;
+  if(DB_ERROR(page_put(tree, page_id, &new_page))) {
+    return DB_STORAGE_ERROR;
+  }
+  tree->header.root = page_id;
+  tree->header.height++;
+
+  return header_put(tree);
+}
+
+/* Find the leaf page and the slot of the first entry whose key is
+   equal to or greater than the given key. */
+static db_result_t
+tree_seek(struct btree *tree, btree_key_t key,
+          btree_page_id_t *page_id, uint8_t *slot)
+{
+  struct btree_page *page;
+  int level;
+
+  *page_id = tree->header.root;
+  *slot = 0;
+  if(*page_id == BTREE_NO_PAGE) {
+    return DB_OK;
+  }
+
+  for(level = 0;; level++) {
+    page = page_get(tree, *page_id);
+    if(page == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+    if(page->leaf) {
+      break;
+    }
+    *page_id = page->entries[child_lower(page, key)].value;
+  }
+
+  *slot = leaf_lower(page, key);
+  return DB_OK;
+}
+
+static db_result_t
+create(index_t *index)
+{
+  char *filename;
+  struct btree *tree;
+
+  filename = storage_generate_file("btree", DB_BTREE_RESERVE_SIZE);
+  if(filename == NULL) {
+    PRINTF("DB: Failed to generate a B+-tree file\n");
+    return DB_INDEX_ERROR;
+  }
+
+  memcpy(index->descriptor_file, filename, sizeof(index->descriptor_file));
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    cfs_remove(index->descriptor_file);
+    index->descriptor_file[0] = '\0';
+    return DB_ALLOCATION_ERROR;
+  }
+
+  tree->fd = storage_open(index->descriptor_file);
+  if(tree->fd < 0) {
+    memb_free(&btrees, tree);
+    cfs_remove(index->descriptor_file);
+    index->descriptor_file[0] = '\0';
+    return DB_STORAGE_ERROR;
+  }
+
+  memset(&tree->header, 0, sizeof(tree->header));
+  tree->header.magic = BTREE_MAGIC;
+  tree->header.page_count = 1;
+  if(DB_ERROR(header_put(tree))) {
+    release(index);
+    cfs_remove(index->descriptor_file);
+    index->descriptor_file[0] = '\0';
+    return DB_STORAGE_ERROR;
+  }
+
+  PRINTF("DB: Created a B+-tree index in %s with %u entries per page\n",
+         index->descriptor_file, (unsigned)BTREE_FANOUT);
+
+  return DB_OK;
+}
+
+static db_result_t
+destroy(index_t *index)
+{
+  if(index->opaque_data != NULL) {
+    release(index);
+  }
+  if(cfs_remove(index->descriptor_file) < 0) {
+    return DB_STORAGE_ERROR;
+  }
+  return DB_OK;
+}
+
+static db_result_t
+load(index_t *index)
+{
+  struct btree *tree;
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    return DB_ALLOCATION_ERROR;
+  }
+
+  tree->fd = storage_open(index->descriptor_file);
+  if(tree->fd < 0 ||
+     DB_ERROR(storage_read(tree->fd, &tree->header, 0,
+                           sizeof(tree->header))) ||
+     tree->header.magic != BTREE_MAGIC) {
+    PRINTF("DB: Failed to load the B+-tree in %s\n", index->descriptor_file);
+    release(index);
+    return DB_STORAGE_ERROR;
+  }
+
+  PRINTF("DB: Loaded a B+-tree index from %s: %lu pages, height %u\n",
+         index->descriptor_file, (unsigned long)tree->header.page_count,
+         (unsigned)tree->header.height);
+
+  return DB_OK;
+}
+
+static db_result_t
+release(index_t *index)
+{
+  struct btree *tree;
+
+  tree = index->opaque_data;
+  cache_invalidate(tree);
+  if(tree->fd >= 0) {
+    storage_close(tree->fd);
+  }
+  memb_free(&btrees, tree);
+  index->opaque_data = NULL;
+
+  return DB_OK;
+}
+
+static db_result_t
+insert(index_t *index, attribute_value_t *key, tuple_id_t value)
+{
+  struct btree *tree;
+
+  tree = (struct btree *)index->opaque_data;
+
+  if(DB_ERROR(tree_insert(tree, (btree_key_t)db_value_to_long(key), value))) {
+    PRINTF("DB: Failed to insert key %ld into a B+-tree index\n",
+           db_value_to_long(key));
+    return DB_INDEX_ERROR;
+  }
+  return DB_OK;
+}
+
+static db_result_t
+delete(index_t *index, attribute_value_t *value)
+{
+  struct btree *tree;
+  struct btree_page *page;
+  btree_page_id_t page_id;
+  btree_key_t key;
+  uint8_t slot;
+  int end;
+
+  tree = (struct btree *)index->opaque_data;
+  key = (btree_key_t)db_value_to_long(value);
+
+  if(DB_ERROR(tree_seek(tree, key, &page_id, &slot))) {
+    return DB_INDEX_ERROR;
+  }
+
+  /* Remove the entries with the key from the leaves. The pages are not
+     merged, so the tree does not shrink. */
+  while(page_id != BTREE_NO_PAGE) {
+    page = page_get(tree, page_id);
+    if(page == NULL) {
+      return DB_INDEX_ERROR;
+    }
+
+    for(end = slot; end < page->count && page->entries[end].key == key; end++);
+    if(end > slot) {
+      memmove(&page->entries[slot], &page->entries[end],
+              (page->count - end) * sizeof(struct btree_entry));
+      page->count -= end - slot;
+      if(DB_ERROR(page_put(tree, page_id, page))) {
+        return DB_INDEX_ERROR;
+      }
+    }
+    if(slot < page->count) {
+      break;
+    }
+    page_id = page->next;
+    slot = 0;
+  }
+
+  if(cursor.tree == tree) {
+    cursor.iterator = NULL;
+  }
+
+  return DB_OK;
+}
+
+static tuple_id_t
+get_next(index_iterator_t *iterator)
+{
+  struct btree *tree;
+  struct btree_page *page;
+  struct btree_entry *entry;
+  btree_key_t min;
+  btree_key_t max;
+  tuple_id_t skip;
+
+  tree = (struct btree *)iterator->index->opaque_data;
+  min = (btree_key_t)db_value_to_long(&iterator->min_value);
+  max = (btree_key_t)db_value_to_long(&iterator->max_value);
+
+  skip = 0;
+  if(cursor.iterator != iterator || cursor.tree != tree ||
+     iterator->next_item_no == 0) {
+    /* Start a new scan, or resume a scan that was interrupted by
+       another one by skipping the entries already returned. */
+    if(DB_ERROR(tree_seek(tree, min, &cursor.page_id, &cursor.slot))) {
+      return INVALID_TUPLE;
+    }
+    cursor.iterator = iterator;
+    cursor.tree = tree;
+    skip = iterator->next_item_no;
+  }
+
+  while(cursor.page_id != BTREE_NO_PAGE) {
+    page = page_get(tree, cursor.page_id);
+    if(page == NULL) {
+      break;
+    }
+
+    if(cursor.slot >= page->count) {
+      cursor.page_id = page->next;
+      cursor.slot = 0;
+      continue;
+    }
+
+    entry = &page->entries[cursor.slot++];
+    if(entry->key > max) {
+      break;
+    }
+    if(entry->key < min) {
+      continue;
+    }
+    if(skip > 0) {
+      skip--;
+      continue;
+    }
+
+    iterator->next_item_no++;
+    return (tuple_id_t)entry->value;
+  }
+
+  cursor.page_id = BTREE_NO_PAGE;
+  return INVALID_TUPLE;
+}
@@ -40,6 +40,7 @@
 #include "lib/crc16.h"
 #include "lib/list.h"
 #include "lib/memb.h"
+#include "lib/mmem.h"
 
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
@@ -79,8 +80,86 @@ struct source_map {
 };
 
 static struct source_map source_map[AQL_ATTRIBUTE_LIMIT];
+
+/* An entry in the hash table of a hash join. */
+struct join_entry {
+  long key;
+  tuple_id_t tuple_id;
+  uint16_t next;
+};
+
+#define JOIN_NO_ENTRY		0xffff
+#define JOIN_HASH(key)		((unsigned long)(key) % DB_JOIN_HASH_BUCKETS)
+
+#define JOIN_PHASE_BUILD	0
+#define JOIN_PHASE_PROBE	1
+#define JOIN_PHASE_LEFT_NEXT	0
+#define JOIN_PHASE_LEFT_READ	1
+
+#define INDEX_TYPE_OF(attr)						\
+  ((attr)->index == NULL ? INDEX_NONE : ((index_t *)(attr)->index)->type)
+
+/*
+ * The state of the join being processed. The build relation is the
+ * one that is accessed by tuple ID: the relation that the hash table
+ * is built on, or the right relation in a merge join. The probe
+ * relation is scanned sequentially. The key offsets are calculated
+ * once when setting up the join.
+ */
+static struct {
+  relation_t *build_rel;
+  relation_t *probe_rel;
+  attribute_t *build_attr;
+  attribute_t *probe_attr;
+  unsigned char *build_row;
+  unsigned char *probe_row;
+  unsigned build_offset;
+  unsigned probe_offset;
+  tuple_id_t build_id;
+  tuple_id_t probe_id;
+  tuple_id_t mark;
+  long key;
+  long run_key;
+  uint16_t entry_count;
+  uint16_t entry_limit;
+  uint16_t chain;
+  uint8_t phase;
+  uint8_t in_run;
+} join;
 #endif /* DB_FEATURE_JOIN */
 
+#if DB_FEATURE_GROUP
+/*
+ * A group in a GROUP BY query. The aggregation values are stored in
+ * the order of the attributes of the result relation.
+ */
+struct group {
+  long key;
+  long values[AQL_ATTRIBUTE_LIMIT];
+  tuple_id_t count;
+  uint16_t next;
+};
+
+#define GROUP_NO_ENTRY		0xffff
+#define GROUP_HASH(key)		((unsigned long)(key) % DB_GROUP_HASH_BUCKETS)
+
+static struct {
+  long window;
+  uint16_t group_count;
+  uint16_t next_output;
+  uint8_t key_index;
+} grouping;
+#endif /* DB_FEATURE_GROUP */
+
+#if DB_FEATURE_JOIN || DB_FEATURE_GROUP
+/*
+ * Memory for the hash tables of the query being processed, allocated
+ * from the mmem pool when the query starts and freed when it ends.
+ */
+static struct mmem query_arena;
+static uint8_t query_arena_allocated;
+#endif /* DB_FEATURE_JOIN || DB_FEATURE_GROUP */
+
 static unsigned char row[DB_MAX_ATTRIBUTES_PER_RELATION * DB_MAX_ELEMENT_SIZE];
 static unsigned char extra_row[DB_MAX_ATTRIBUTES_PER_RELATION * DB_MAX_ELEMENT_SIZE];
 static unsigned char result_row[AQL_ATTRIBUTE_LIMIT * DB_MAX_ELEMENT_SIZE];
@@ -219,6 +298,9 @@ relation_init(void)
   list_init(relations);
   memb_init(&relations_memb);
   memb_init(&attributes_memb);
+#if DB_FEATURE_JOIN || DB_FEATURE_GROUP
+  mmem_init();
+#endif /* DB_FEATURE_JOIN || DB_FEATURE_GROUP */
 
   return DB_OK;
 }
@@ -480,9 +562,17 @@ relation_insert(relation_t *rel, attribute_value_t *values)
   unsigned char *ptr;
   attribute_value_t *value;
   db_result_t result;
+  tuple_id_t tuple_id;
 
   value = values;
 
+  /* The new row gets the next tuple ID. The cardinality is cached in
+     the relation, so this does not normally access the storage. */
+  tuple_id = relation_cardinality(rel);
+  if(tuple_id == INVALID_TUPLE) {
+    return DB_STORAGE_ERROR;
+  }
+
   PRINTF("DB: Relation %s has a record size of %u bytes\n",
 	 rel->name, (unsigned)rel->row_length);
   ptr = record;
@@ -534,7 +624,7 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 
     ptr += attr->element_size;
     if(attr->index != NULL) {
-      if(DB_ERROR(index_insert(attr->index, value, rel->next_row))) {
+      if(DB_ERROR(index_insert(attr->index, value, tuple_id))) {
         return DB_INDEX_ERROR;
       }
     }
@@ -542,46 +632,56 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 
   PRINTF(")\n");
 
-  rel->cardinality++;
-  rel->next_row++;
+  rel->next_row = tuple_id + 1;
   return storage_put_row(rel, record);
 }
 
-static void
-aggregate(attribute_t *attr, attribute_value_t *value)
+#if DB_FEATURE_JOIN || DB_FEATURE_GROUP
+static db_result_t
+query_arena_alloc(unsigned size)
 {
-  long long_value;
+  relation_query_free();
+  if(!mmem_alloc(&query_arena, size)) {
+    return DB_ALLOCATION_ERROR;
+  }
+  query_arena_allocated = 1;
+  return DB_OK;
+}
+#endif /* DB_FEATURE_JOIN || DB_FEATURE_GROUP */
 
-  switch(value->domain) {
-  case DOMAIN_INT:
-    long_value = VALUE_INT(value);
-    break;
-  case DOMAIN_LONG:
-    long_value = VALUE_LONG(value);
-    break;
-  default:
-    return;
+void
+relation_query_free(void)
+{
+#if DB_FEATURE_JOIN || DB_FEATURE_GROUP
+  if(query_arena_allocated) {
+    mmem_free(&query_arena);
+    query_arena_allocated = 0;
   }
+#endif /* DB_FEATURE_JOIN || DB_FEATURE_GROUP */
+}
 
-  switch(attr->aggregator) {
+static void
+update_aggregate(uint8_t aggregator, long *aggregation_value, long long_value)
+{
+  switch(aggregator) {
   case AQL_COUNT:
-    attr->aggregation_value++;
+    (*aggregation_value)++;
     break;
   case AQL_SUM:
-    attr->aggregation_value += long_value;
+    *aggregation_value += long_value;
     break;
   case AQL_MEAN:
     break;
   case AQL_MEDIAN:
     break;
   case AQL_MAX:
-    if(long_value > attr->aggregation_value) {
-      attr->aggregation_value = long_value;
+    if(long_value > *aggregation_value) {
+      *aggregation_value = long_value;
     }
     break;
   case AQL_MIN:
-    if(long_value < attr->aggregation_value) {
-      attr->aggregation_value = long_value;
+    if(long_value < *aggregation_value) {
+      *aggregation_value = long_value;
     }
     break;
   default:
@@ -589,6 +689,211 @@ aggregate(attribute_t *attr, attribute_value_t *value)
   }
 }
 
+static long
+initial_aggregate(uint8_t aggregator)
+{
+  switch(aggregator) {
+  case AQL_MAX:
+    return LONG_MIN;
+  case AQL_MIN:
+    return LONG_MAX;
+  default:
+    return 0;
+  }
+}
+
+static void
+aggregate(attribute_t *attr, attribute_value_t *value)
+{
+  long long_value;
+
+  switch(value->domain) {
+  case DOMAIN_INT:
+    long_value = VALUE_INT(value);
+    break;
+  case DOMAIN_LONG:
+    long_value = VALUE_LONG(value);
+    break;
+  default:
+    return;
+  }
+
+  update_aggregate(attr->aggregator, &attr->aggregation_value, long_value);
+}
+
+#if DB_FEATURE_GROUP
+/*
+ * Add the current row to its group. The groups are kept in a fixed-size
+ * hash table in the query arena, so that only one row at a time has to
+ * be read, and only one row per group is returned.
+ */
+static db_result_t
+group_update(struct source_dest_map *attr_map_end)
+{
+  struct group *groups;
+  struct group *group;
+  uint16_t *buckets;
+  uint16_t *bucket;
+  uint16_t i;
+  struct source_dest_map *attr_map_ptr;
+  struct source_dest_map *key_map;
+  attribute_value_t value;
+  long key;
+  long long_value;
+  uint8_t aggregator;
+
+  groups = (struct group *)MMEM_PTR(&query_arena);
+  buckets = (uint16_t *)(groups + DB_GROUP_LIMIT);
+
+  key_map = &attr_map[grouping.key_index];
+  if(DB_ERROR(db_phy_to_value(&value, key_map->from_attr,
+                              row + key_map->from_offset))) {
+    return DB_TYPE_ERROR;
+  }
+  key = db_value_to_long(&value);
+  if(grouping.window > 0) {
+    /* Round down to the start of the window. */
+    key -= ((key % grouping.window) + grouping.window) % grouping.window;
+  }
+
+  bucket = &buckets[GROUP_HASH(key)];
+  for(i = *bucket; i != GROUP_NO_ENTRY; i = groups[i].next) {
+    if(groups[i].key == key) {
+      break;
+    }
+  }
+
+  if(i == GROUP_NO_ENTRY) {
+    if(grouping.group_count == DB_GROUP_LIMIT) {
+      PRINTF("DB: Too many groups; the limit is %d\n", DB_GROUP_LIMIT);
+      return DB_LIMIT_ERROR;
+    }
+    i = grouping.group_count++;
+    group = &groups[i];
+    group->key = key;
+    group->count = 0;
+    group->next = *bucket;
+    *bucket = i;
+    for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
+      group->values[attr_map_ptr - attr_map] =
+        initial_aggregate(attr_map_ptr->to_attr->aggregator);
+    }
+  }
+
+  group = &groups[i];
+  group->count++;
+
+  for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
+    aggregator = attr_map_ptr->to_attr->aggregator;
+    if(aggregator == AQL_NONE) {
+      continue;
+    }
+    if(DB_ERROR(db_phy_to_value(&value, attr_map_ptr->from_attr,
+                                row + attr_map_ptr->from_offset))) {
+      return DB_TYPE_ERROR;
+    }
+    long_value = db_value_to_long(&value);
+    /* The mean is calculated from the sum when the group is returned. */
+    update_aggregate(aggregator == AQL_MEAN ? AQL_SUM : aggregator,
+                     &group->values[attr_map_ptr - attr_map], long_value);
+  }
+
+  return DB_OK;
+}
+
+/* Return the next group as a row of the result relation. */
+static db_result_t
+group_output(db_handle_t *handle)
+{
+  struct group *group;
+  struct source_dest_map *attr_map_ptr;
+  struct source_dest_map *attr_map_end;
+  attribute_t *result_attr;
+  attribute_value_t value;
+  long long_value;
+
+  if(grouping.next_output == grouping.group_count) {
+    relation_query_free();
+    return DB_FINISHED;
+  }
+
+  group = (struct group *)MMEM_PTR(&query_arena) + grouping.next_output++;
+
+  attr_map_end = attr_map + handle->result_rel->attribute_count;
+  for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
+    result_attr = attr_map_ptr->to_attr;
+    if(result_attr->flags & ATTRIBUTE_FLAG_NO_STORE) {
+      continue;
+    }
+
+    switch(result_attr->aggregator) {
+    case AQL_NONE:
+      long_value = group->key;
+      break;
+    case AQL_MEAN:
+      long_value = group->values[attr_map_ptr - attr_map] / (long)group->count;
+      break;
+    default:
+      long_value = group->values[attr_map_ptr - attr_map];
+      break;
+    }
+
+    value.domain = result_attr->domain;
+    if(result_attr->domain == DOMAIN_INT) {
+      VALUE_INT(&value) = long_value;
+    } else {
+      VALUE_LONG(&value) = long_value;
+    }
+    if(DB_ERROR(db_value_to_phy(result_row + attr_map_ptr->to_offset,
+                                result_attr, &value))) {
+      return DB_TYPE_ERROR;
+    }
+  }
+
+  if(AQL_GET_FLAGS((aql_adt_t *)handle->adt) & AQL_FLAG_ASSIGN) {
+    if(DB_ERROR(storage_put_row(handle->result_rel, result_row))) {
+      PRINTF("DB: Failed to store a row in the result relation!\n");
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  handle->current_row++;
+  return DB_GOT_ROW;
+}
+
+static db_result_t
+group_init(aql_adt_t *adt, relation_t *result_rel)
+{
+  uint16_t *buckets;
+  unsigned i;
+
+  grouping.window = adt->window;
+  grouping.group_count = 0;
+  grouping.next_output = 0;
+  grouping.key_index = adt->group_attribute;
+
+  if(attr_map[grouping.key_index].from_attr->domain != DOMAIN_INT &&
+     attr_map[grouping.key_index].from_attr->domain != DOMAIN_LONG) {
+    PRINTF("DB: Only integer attributes can be grouped by\n");
+    return DB_TYPE_ERROR;
+  }
+
+  if(DB_ERROR(query_arena_alloc(DB_GROUP_LIMIT * sizeof(struct group) +
+                                DB_GROUP_HASH_BUCKETS * sizeof(uint16_t)))) {
+    PRINTF("DB: Failed to allocate the group table\n");
+    return DB_ALLOCATION_ERROR;
+  }
+
+  buckets = (uint16_t *)((struct group *)MMEM_PTR(&query_arena) +
+                         DB_GROUP_LIMIT);
+  for(i = 0; i < DB_GROUP_HASH_BUCKETS; i++) {
+    buckets[i] = GROUP_NO_ENTRY;
+  }
+
+  return DB_OK;
+}
+#endif /* DB_FEATURE_GROUP */
+
 static db_result_t
 generate_attribute_map(struct source_dest_map *attr_map, unsigned attribute_count,
                        relation_t *from_rel, relation_t *to_rel, 
@@ -677,6 +982,9 @@ generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
   relation_t *result_rel;
   unsigned attribute_count;
   attribute_t *attr;
+#if DB_FEATURE_GROUP
+  db_result_t result;
+#endif /* DB_FEATURE_GROUP */
 
   result_rel = handle->result_rel;
 
@@ -696,6 +1004,15 @@ generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
     return DB_IMPLEMENTATION_ERROR;
   }
 
+#if DB_FEATURE_GROUP
+  if(AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP) {
+    result = group_init(adt, result_rel);
+    if(DB_ERROR(result)) {
+      return result;
+    }
+  }
+#endif /* DB_FEATURE_GROUP */
+
   if(adt->lvm_instance != NULL) {
     /* Try to establish acceptable ranges for the attribute values. */
     if(!LVM_ERROR(lvm_derive(adt->lvm_instance))) {
@@ -753,6 +1070,12 @@ relation_process_select(void *handle_ptr)
   attribute_count = handle->result_rel->attribute_count;
   attr_map_end = attr_map + attribute_count;
 
+#if DB_FEATURE_GROUP
+  if(handle->flags & DB_HANDLE_FLAG_GROUP_OUTPUT) {
+    return group_output(handle);
+  }
+#endif /* DB_FEATURE_GROUP */
+
   if(handle->flags & DB_HANDLE_FLAG_SEARCH_INDEX) {
     handle->tuple_id = index_get_next(&handle->index_iterator);
     if(handle->tuple_id == INVALID_TUPLE) {
@@ -761,6 +1084,13 @@ relation_process_select(void *handle_ptr)
         return DB_INDEX_ERROR;
       }
 
+#if DB_FEATURE_GROUP
+      if(adt->flags & AQL_FLAG_GROUP) {
+        handle->flags |= DB_HANDLE_FLAG_GROUP_OUTPUT;
+        return group_output(handle);
+      }
+#endif /* DB_FEATURE_GROUP */
+
       if(adt->flags & AQL_FLAG_AGGREGATE) {
         goto end_aggregation;
       }
@@ -777,6 +1107,12 @@ relation_process_select(void *handle_ptr)
     PRINTF("DB: Failed to get a row in relation %s!\n", handle->rel->name);
     return result;
   } else if(result == DB_FINISHED) {
+#if DB_FEATURE_GROUP
+    if(AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP) {
+      handle->flags |= DB_HANDLE_FLAG_GROUP_OUTPUT;
+      return group_output(handle);
+    }
+#endif /* DB_FEATURE_GROUP */
     if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
       goto end_aggregation;
     }
@@ -788,11 +1124,13 @@ relation_process_select(void *handle_ptr)
     from_ptr = row + attr_map_ptr->from_offset;
     result_attr = attr_map_ptr->to_attr;
 
-    /* Update the internal state of the PLE. */
-    if(result_attr->domain == DOMAIN_INT) {
+    /* Update the internal state of the PLE. The value is decoded
+       according to the source attribute, since the domain of an
+       aggregated result attribute may differ. */
+    if(attr_map_ptr->from_attr->domain == DOMAIN_INT) {
       operand_value.l = from_ptr[0] << 8 | from_ptr[1];
       lvm_set_variable_value(result_attr->name, operand_value);
-    } else if(result_attr->domain == DOMAIN_LONG) {
+    } else if(attr_map_ptr->from_attr->domain == DOMAIN_LONG) {
       operand_value.l = (uint32_t)from_ptr[0] << 24 |
                         (uint32_t)from_ptr[1] << 16 |
                         (uint32_t)from_ptr[2] << 8 |
@@ -821,6 +1159,11 @@ relation_process_select(void *handle_ptr)
   /* Check whether the given predicate is true for this tuple. */
   if(adt->lvm_instance == NULL ||
      lvm_execute(adt->lvm_instance) == wanted_result) {
+#if DB_FEATURE_GROUP
+    if(AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP) {
+      return group_update(attr_map_end);
+    }
+#endif /* DB_FEATURE_GROUP */
     if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
       for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
         from_ptr = row + attr_map_ptr->from_offset;
@@ -916,6 +1259,13 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
     PRINTF("DB: Found attribute %s in relation %s\n",
 	attribute_name, rel->name);
 
+#if DB_FEATURE_GROUP
+    if(adt->aggregators[i] && (AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP)) {
+      /* Grouped aggregates are returned as long integers. */
+      attr = relation_attribute_add(handle->result_rel, dir,
+                                    attribute_name, DOMAIN_LONG, 4);
+    } else
+#endif /* DB_FEATURE_GROUP */
     attr = relation_attribute_add(handle->result_rel, dir,
 				  attribute_name, 
 				  adt->aggregators[i] ? DOMAIN_INT : attr->domain,
@@ -948,6 +1298,17 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
     attr->flags = adt->attributes[i].flags;
   }
 
+#if DB_FEATURE_GROUP
+  /* The attribute grouped by is the only normal attribute allowed
+     in a grouped result. */
+  if(AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP) {
+    if(normal_attributes > 1) {
+      return DB_RELATIONAL_ERROR;
+    }
+    return generate_selection_result(handle, rel, adt);
+  }
+#endif /* DB_FEATURE_GROUP */
+
   /* Preclude mixes of normal attributes and aggregated ones in 
      selection results. */
   if(normal_attributes > 0 &&
@@ -959,24 +1320,59 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
 }
 
 #if DB_FEATURE_JOIN
-db_result_t
-relation_process_join(void *handle_ptr)
+static long
+join_key(attribute_t *attr, unsigned char *ptr)
+{
+  attribute_value_t value;
+
+  if(DB_ERROR(db_phy_to_value(&value, attr, ptr))) {
+    return 0;
+  }
+  return db_value_to_long(&value);
+}
+
+static db_result_t
+join_emit(db_handle_t *handle)
 {
-  db_handle_t *handle;
-  db_result_t result;
-  relation_t *left_rel;
-  relation_t *right_rel;
   relation_t *join_rel;
   unsigned char *join_next_attribute_ptr;
   size_t element_size;
+  int i;
+
+  join_rel = handle->join_rel;
+
+  /* Use the source attribute map to fill in the physical representation
+     of the resulting tuple. */
+  join_next_attribute_ptr = join_row;
+
+  for(i = 0; i < join_rel->attribute_count; i++) {
+    element_size = source_map[i].attr->element_size;
+
+    memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
+    join_next_attribute_ptr += element_size;
+  }
+
+  if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
+    if(DB_ERROR(storage_put_row(join_rel, join_row))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  handle->current_row++;
+  return DB_GOT_ROW;
+}
+
+static db_result_t
+process_index_join(db_handle_t *handle)
+{
+  db_result_t result;
+  relation_t *left_rel;
+  relation_t *right_rel;
   tuple_id_t right_tuple_id;
   attribute_value_t value;
-  int i;
 
-  handle = (db_handle_t *)handle_ptr;
   left_rel = handle->left_rel;
   right_rel = handle->right_rel;
-  join_rel = handle->join_rel;
 
   if(!(handle->flags & DB_HANDLE_FLAG_INDEX_STEP)) {
     goto inner_loop;
@@ -993,7 +1389,8 @@ relation_process_join(void *handle_ptr)
       return DB_FINISHED;
     }
 
-    if(DB_ERROR(relation_get_value(left_rel, handle->left_join_attr, left_row, &value))) {
+    if(DB_ERROR(db_phy_to_value(&value, handle->left_join_attr,
+                                left_row + join.probe_offset))) {
       PRINTF("DB: Failed to get a value of the attribute \"%s\" to join on\n",
 	handle->left_join_attr->name);
       return DB_IMPLEMENTATION_ERROR;
@@ -1030,28 +1427,241 @@ inner_loop:
         return DB_IMPLEMENTATION_ERROR;
       }
 
-      /* Use the source attribute map to fill in the physical representation
-	 of the resulting tuple. */
-      join_next_attribute_ptr = join_row;
+      return join_emit(handle);
+    }
+  }
+
+  return DB_OK;
+}
+
+/*
+ * Hash join. The rows of the smaller relation are read first, one
+ * per call, and their join keys are entered in a hash table. The
+ * table holds only the keys and the tuple IDs, and is allocated from
+ * the mmem pool for the duration of the join. The larger relation
+ * is then scanned once, and each of its rows is matched against the
+ * rows in the hash chain of its key.
+ */
+static db_result_t
+process_hash_join(db_handle_t *handle)
+{
+  db_result_t result;
+  struct join_entry *entries;
+  struct join_entry *entry;
+  uint16_t *buckets;
+  tuple_id_t tuple_id;
+
+  entries = (struct join_entry *)MMEM_PTR(&query_arena);
+  buckets = (uint16_t *)(entries + join.entry_limit);
 
-      for(i = 0; i < join_rel->attribute_count; i++) {
-	element_size = source_map[i].attr->element_size;
+  if(join.phase == JOIN_PHASE_BUILD) {
+    result = storage_get_row(join.build_rel, &join.build_id, join.build_row);
+    if(DB_ERROR(result)) {
+      relation_query_free();
+      return result;
+    } else if(result == DB_FINISHED || join.entry_count == join.entry_limit) {
+      join.phase = JOIN_PHASE_PROBE;
+      join.chain = JOIN_NO_ENTRY;
+      return DB_OK;
+    }
 
-	memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
-	join_next_attribute_ptr += element_size;
+    entry = &entries[join.entry_count];
+    entry->key = join_key(join.build_attr, join.build_row + join.build_offset);
+    entry->tuple_id = join.build_id++;
+    entry->next = buckets[JOIN_HASH(entry->key)];
+    buckets[JOIN_HASH(entry->key)] = join.entry_count++;
+    return DB_OK;
+  }
+
+  if(join.chain == JOIN_NO_ENTRY) {
+    result = storage_get_row(join.probe_rel, &join.probe_id, join.probe_row);
+    if(DB_ERROR(result) || result == DB_FINISHED) {
+      relation_query_free();
+      return result;
+    }
+    join.probe_id++;
+    join.key = join_key(join.probe_attr, join.probe_row + join.probe_offset);
+    join.chain = buckets[JOIN_HASH(join.key)];
+  }
+
+  /* Continue in the hash chain where the previous match was found. */
+  while(join.chain != JOIN_NO_ENTRY) {
+    entry = &entries[join.chain];
+    join.chain = entry->next;
+    if(entry->key == join.key) {
+      tuple_id = entry->tuple_id;
+      result = storage_get_row(join.build_rel, &tuple_id, join.build_row);
+      if(DB_ERROR(result) || result == DB_FINISHED) {
+        relation_query_free();
+        return DB_IMPLEMENTATION_ERROR;
       }
+      return join_emit(handle);
+    }
+  }
 
-      if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
-        if(DB_ERROR(storage_put_row(join_rel, join_row))) {
-          return DB_STORAGE_ERROR;
-        }
+  return DB_OK;
+}
+
+/*
+ * Sort-merge join. Both relations are stored in ascending order of
+ * the join attribute, which is a requirement of the inline index.
+ * Each call advances one of the relations by one row. When a run of
+ * equal keys in the right relation has been joined with a left row,
+ * the scan of the right relation restarts at the beginning of the run
+ * if the next left row has the same key.
+ */
+static db_result_t
+process_merge_join(db_handle_t *handle)
+{
+  db_result_t result;
+  long right_key;
+
+  if(join.phase != JOIN_PHASE_LEFT_READ) {
+    result = storage_get_row(handle->left_rel, &join.probe_id, left_row);
+    if(DB_ERROR(result) || result == DB_FINISHED) {
+      return result;
+    }
+    join.key = join_key(join.probe_attr, left_row + join.probe_offset);
+    join.phase = JOIN_PHASE_LEFT_READ;
+
+    if(join.in_run) {
+      if(join.key == join.run_key) {
+        join.build_id = join.mark;
+      } else {
+        join.in_run = 0;
       }
+    }
+  }
 
-      handle->current_row++;
-      return DB_GOT_ROW;
+  result = storage_get_row(handle->right_rel, &join.build_id, right_row);
+  if(DB_ERROR(result)) {
+    return result;
+  } else if(result == DB_FINISHED) {
+    if(!join.in_run) {
+      return DB_FINISHED;
+    }
+    /* The run ended with the right relation. */
+    join.probe_id++;
+    join.phase = JOIN_PHASE_LEFT_NEXT;
+    return DB_OK;
+  }
+
+  right_key = join_key(join.build_attr, right_row + join.build_offset);
+
+  if(right_key == join.key) {
+    if(!join.in_run) {
+      join.in_run = 1;
+      join.run_key = join.key;
+      join.mark = join.build_id;
+    }
+    join.build_id++;
+    return join_emit(handle);
+  }
+
+  if(join.in_run || right_key > join.key) {
+    join.probe_id++;
+    join.phase = JOIN_PHASE_LEFT_NEXT;
+  } else {
+    join.build_id++;
+  }
+
+  return DB_OK;
+}
+
+db_result_t
+relation_process_join(void *handle_ptr)
+{
+  db_handle_t *handle;
+
+  handle = (db_handle_t *)handle_ptr;
+
+  switch(handle->join_method) {
+  case DB_JOIN_HASH:
+    return process_hash_join(handle);
+  case DB_JOIN_MERGE:
+    return process_merge_join(handle);
+  default:
+    return process_index_join(handle);
+  }
+}
+
+static db_result_t
+setup_join_method(db_handle_t *handle)
+{
+  relation_t *build_rel;
+  tuple_id_t cardinality;
+  uint16_t *buckets;
+  unsigned i;
+
+  memset(&join, 0, sizeof(join));
+  join.probe_attr = handle->left_join_attr;
+  join.build_attr = handle->right_join_attr;
+  join.probe_offset = get_attribute_value_offset(handle->left_rel,
+                                                 handle->left_join_attr);
+  join.build_offset = get_attribute_value_offset(handle->right_rel,
+                                                 handle->right_join_attr);
+
+  switch(handle->join_method) {
+  case DB_JOIN_MERGE:
+    if(INDEX_TYPE_OF(handle->left_join_attr) != INDEX_INLINE ||
+       INDEX_TYPE_OF(handle->right_join_attr) != INDEX_INLINE) {
+      PRINTF("DB: A merge join requires inline indexes on both relations\n");
+      return DB_INDEX_ERROR;
+    }
+    join.phase = JOIN_PHASE_LEFT_NEXT;
+    return DB_OK;
+  case DB_JOIN_HASH:
+    /* Build the hash table on the smaller relation. */
+    if(relation_cardinality(handle->left_rel) <
+       relation_cardinality(handle->right_rel)) {
+      build_rel = handle->left_rel;
+      join.build_rel = handle->left_rel;
+      join.build_row = left_row;
+      join.probe_rel = handle->right_rel;
+      join.probe_row = right_row;
+      join.probe_attr = handle->right_join_attr;
+      join.build_attr = handle->left_join_attr;
+      i = join.probe_offset;
+      join.probe_offset = join.build_offset;
+      join.build_offset = i;
+    } else {
+      build_rel = handle->right_rel;
+      join.build_rel = handle->right_rel;
+      join.build_row = right_row;
+      join.probe_rel = handle->left_rel;
+      join.probe_row = left_row;
+    }
+
+    cardinality = relation_cardinality(build_rel);
+    if(cardinality == INVALID_TUPLE || cardinality > DB_JOIN_HASH_ROWS) {
+      PRINTF("DB: The relation %s is too large for a hash join\n",
+             build_rel->name);
+      break;
     }
+    join.entry_limit = cardinality;
+    if(DB_ERROR(query_arena_alloc(cardinality * sizeof(struct join_entry) +
+                                  DB_JOIN_HASH_BUCKETS * sizeof(uint16_t)))) {
+      PRINTF("DB: Failed to allocate the hash join table\n");
+      break;
+    }
+
+    buckets = (uint16_t *)((struct join_entry *)MMEM_PTR(&query_arena) +
+                           join.entry_limit);
+    for(i = 0; i < DB_JOIN_HASH_BUCKETS; i++) {
+      buckets[i] = JOIN_NO_ENTRY;
+    }
+    join.phase = JOIN_PHASE_BUILD;
+    return DB_OK;
+  default:
+    break;
   }
 
+  /* Fall back to an index nested-loop join. */
+  handle->join_method = DB_JOIN_INDEX;
+  if(!index_exists(handle->right_join_attr)) {
+    PRINTF("DB: The attribute to join on is not indexed\n");
+    return DB_INDEX_ERROR;
+  }
   return DB_OK;
 }
 
@@ -1120,6 +1730,7 @@ relation_join(void *query_result, void *adt_ptr)
   int i;
   char *attribute_name;
   attribute_t *attr;
+  db_result_t result;
 
   adt = (aql_adt_t *)adt_ptr;
 
@@ -1158,9 +1769,10 @@ relation_join(void *query_result, void *adt_ptr)
     return DB_RELATIONAL_ERROR;
   }
 
-  if(!index_exists(handle->right_join_attr)) {
-    PRINTF("DB: The attribute to join on is not indexed\n");
-    return DB_INDEX_ERROR;
+  relation_query_free();
+  result = setup_join_method(handle);
+  if(DB_ERROR(result)) {
+    return result;
   }
 
   /*
@@ -1198,7 +1810,6 @@ relation_cardinality(relation_t *rel)
 {
   tuple_id_t tuple_id;
 
-
   if(rel->cardinality != INVALID_TUPLE) {
     return rel->cardinality;
   }
@@ -1207,12 +1818,12 @@ relation_cardinality(relation_t *rel)
     return 0;
   }
 
+  /* The storage layer caches the result in rel->cardinality and keeps
+     it up to date when rows are appended. */
   if(DB_ERROR(storage_get_row_amount(rel, &tuple_id))) {
     return INVALID_TUPLE;
   }
 
-  rel->cardinality = tuple_id;
-
   PRINTF("DB: Relation %s has cardinality %lu\n", rel->name,
 	(unsigned long)tuple_id);
 
@@ -97,6 +97,7 @@ db_result_t relation_remove(char *, int);
 db_result_t relation_insert(relation_t *, attribute_value_t *);
 db_result_t relation_select(void *, relation_t *, void *);
 db_result_t relation_join(void *, void *);
+void relation_query_free(void);
 tuple_id_t relation_cardinality(relation_t *);
 
 #endif /* RELATION_H */
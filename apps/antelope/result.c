@@ -178,6 +178,7 @@ db_free(db_handle_t *handle)
   if(handle->right_rel != NULL) {
     relation_release(handle->right_rel);
   }
+  relation_query_free();
 
   handle->flags = 0;
 
@@ -68,6 +68,42 @@ struct index_record {
 
 #define ROW_XOR 0xf6U
 
+/*
+ * Rows are read from the tuple files in blocks of consecutive rows, so
+ * that a scan costs one seek and one read per block rather than per
+ * row. Each loaded relation may hold at most one of the read blocks.
+ */
+struct row_block {
+  relation_t *rel;
+  tuple_id_t first;
+  tuple_id_t count;
+  unsigned char data[DB_ROW_BLOCK_SIZE];
+};
+
+static struct row_block read_blocks[DB_ROW_BLOCK_COUNT];
+static unsigned next_block;
+
+/*
+ * Appended rows are collected in a single block, which is written to
+ * its tuple file when it fills up, when rows are appended to another
+ * relation, when the file is read, or by storage_flush(). The block is
+ * identified by file name because relations are loaded and released
+ * around every query.
+ *
+ * The rows in the block have already been counted in the relation's
+ * cardinality and may be indexed, so a block that cannot be written is
+ * kept, and every later flush retries it. The file offset at which the
+ * block starts is remembered, so that a retry continues after the part
+ * of the block that was written before the failure.
+ */
+static struct {
+  char filename[RELATION_NAME_LENGTH + 1];
+  unsigned row_length;
+  unsigned length;
+  cfs_offset_t start;
+  unsigned char data[DB_ROW_BLOCK_SIZE];
+} append_block;
+
 static void
 merge_strings(char *dest, char *prefix, char *suffix)
 {
@@ -75,6 +111,71 @@ merge_strings(char *dest, char *prefix, char *suffix)
   strcat(dest, suffix);
 }
 
+static db_result_t
+write_all(int fd, unsigned char *ptr, unsigned length)
+{
+  int r;
+
+  while(length > 0) {
+    r = cfs_write(fd, ptr, length);
+    if(r <= 0) {
+      return DB_STORAGE_ERROR;
+    }
+    ptr += r;
+    length -= r;
+  }
+
+  return DB_OK;
+}
+
+#if DB_FEATURE_INTEGRITY
+/* Pad an incomplete row at the end of a tuple file, left by an
+   interrupted write, so that the rows written after it are aligned. */
+static db_result_t
+pad_row(int fd, cfs_offset_t end, unsigned row_length)
+{
+  unsigned char buf[16];
+  unsigned missing;
+  unsigned n;
+
+  missing = end % row_length;
+  if(missing == 0) {
+    return DB_OK;
+  }
+  missing = row_length - missing;
+
+  memset(buf, 0xff, sizeof(buf));
+  while(missing > 0) {
+    n = missing < sizeof(buf) ? missing : sizeof(buf);
+    if(DB_ERROR(write_all(fd, buf, n))) {
+      return DB_STORAGE_ERROR;
+    }
+    missing -= n;
+  }
+
+  return DB_OK;
+}
+#endif /* DB_FEATURE_INTEGRITY */
+
+static int
+append_pending(const char *filename)
+{
+  return append_block.length > 0 &&
+         strcmp(append_block.filename, filename) == 0;
+}
+
+static void
+invalidate_blocks(relation_t *rel)
+{
+  int i;
+
+  for(i = 0; i < DB_ROW_BLOCK_COUNT; i++) {
+    if(read_blocks[i].rel == rel) {
+      read_blocks[i].rel = NULL;
+    }
+  }
+}
+
 char *
 storage_generate_file(char *prefix, unsigned long size)
 {
@@ -120,6 +221,7 @@ storage_unload(relation_t *rel)
   if(RELATION_HAS_TUPLES(rel)) {
     PRINTF("DB: Unload tuple file %s\n", rel->tuple_filename);
 
+    invalidate_blocks(rel);
     cfs_close(rel->tuple_storage);
     rel->tuple_storage = -1;
   }
@@ -279,7 +381,11 @@ storage_put_attribute(relation_t *rel, attribute_t *attr)
 db_result_t
 storage_drop_relation(relation_t *rel, int remove_tuples)
 {
+  invalidate_blocks(rel);
   if(remove_tuples && RELATION_HAS_TUPLES(rel)) {
+    if(append_pending(rel->tuple_filename)) {
+      append_block.length = 0;
+    }
     cfs_remove(rel->tuple_filename);
   }
   return cfs_remove(rel->name) < 0 ? DB_STORAGE_ERROR : DB_OK;
@@ -400,21 +506,66 @@ storage_put_index(index_t *index)
   return result;
 }
 
-db_result_t
-storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
+static db_result_t
+read_block(relation_t *rel, struct row_block *block,
+           tuple_id_t tuple_id, tuple_id_t nrows)
 {
+  tuple_id_t rows_per_block;
+  unsigned length;
   int r;
-  tuple_id_t nrows;
 
-  if(DB_ERROR(storage_get_row_amount(rel, &nrows))) {
+  if(append_pending(rel->tuple_filename) && DB_ERROR(storage_flush())) {
     return DB_STORAGE_ERROR;
   }
 
-  if(*tuple_id >= nrows) {
-    return DB_FINISHED;
+  rows_per_block = DB_ROW_BLOCK_SIZE / rel->row_length;
+  block->rel = NULL;
+  block->first = tuple_id - tuple_id % rows_per_block;
+  block->count = nrows - block->first;
+  if(block->count > rows_per_block) {
+    block->count = rows_per_block;
   }
 
-  if(cfs_seek(rel->tuple_storage, *tuple_id * rel->row_length, CFS_SEEK_SET) ==
+  if(cfs_seek(rel->tuple_storage, block->first * rel->row_length,
+              CFS_SEEK_SET) == (cfs_offset_t)-1) {
+    return DB_STORAGE_ERROR;
+  }
+
+  for(length = 0; length < block->count * rel->row_length; length += r) {
+    r = cfs_read(rel->tuple_storage, block->data + length,
+                 block->count * rel->row_length - length);
+    if(r < 0) {
+      PRINTF("DB: Reading failed on fd %d\n", rel->tuple_storage);
+      return DB_STORAGE_ERROR;
+    } else if(r == 0) {
+      break;
+    }
+  }
+
+  block->count = length / rel->row_length;
+  if(tuple_id >= block->first + block->count) {
+    PRINTF("DB: Incomplete record: %u < %u\n", length, block->count * rel->row_length);
+    return length == 0 ? DB_FINISHED : DB_STORAGE_ERROR;
+  }
+
+  block->rel = rel;
+
+  PRINTF("DB: Read %u rows from relation %s\n", (unsigned)block->count,
+         rel->name);
+
+  return DB_OK;
+}
+
+static db_result_t
+read_row(relation_t *rel, tuple_id_t tuple_id, storage_row_t row)
+{
+  int r;
+
+  if(append_pending(rel->tuple_filename) && DB_ERROR(storage_flush())) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(cfs_seek(rel->tuple_storage, tuple_id * rel->row_length, CFS_SEEK_SET) ==
               (cfs_offset_t)-1) {
     return DB_STORAGE_ERROR;
   }
@@ -430,9 +581,67 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
     return DB_STORAGE_ERROR;
   }
 
-  row[rel->row_length - 1] ^= ROW_XOR;
+  return DB_OK;
+}
+
+db_result_t
+storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
+{
+  tuple_id_t nrows;
+  struct row_block *block;
+  db_result_t result;
+  int i;
+
+  if(DB_ERROR(storage_get_row_amount(rel, &nrows))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(*tuple_id >= nrows) {
+    return DB_FINISHED;
+  }
+
+  if(rel->row_length > DB_ROW_BLOCK_SIZE) {
+    result = read_row(rel, *tuple_id, row);
+    if(result != DB_OK) {
+      return result;
+    }
+  } else {
+    block = NULL;
+    for(i = 0; i < DB_ROW_BLOCK_COUNT; i++) {
+      if(read_blocks[i].rel == rel) {
+        block = &read_blocks[i];
+        if(*tuple_id >= block->first &&
+           *tuple_id < block->first + block->count) {
+          goto found;
+        }
+        break;
+      }
+    }
+
+    if(block == NULL) {
+      for(i = 0; i < DB_ROW_BLOCK_COUNT; i++) {
+        if(read_blocks[i].rel == NULL) {
+          block = &read_blocks[i];
+          break;
+        }
+      }
+      if(block == NULL) {
+        block = &read_blocks[next_block];
+        next_block = (next_block + 1) % DB_ROW_BLOCK_COUNT;
+      }
+    }
 
-  PRINTF("DB: Read %d bytes from relation %s\n", rel->row_length, rel->name);
+    result = read_block(rel, block, *tuple_id, nrows);
+    if(result != DB_OK) {
+      return result;
+    }
+
+found:
+    memcpy(row, block->data + (*tuple_id - block->first) * rel->row_length,
+           rel->row_length);
+  }
+
+  row[rel->row_length - 1] ^= ROW_XOR;
 
   return DB_OK;
 }
@@ -440,52 +649,117 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 db_result_t
 storage_put_row(relation_t *rel, storage_row_t row)
 {
-  cfs_offset_t end;
-  unsigned remaining;
-  int r;
   unsigned char *last_byte;
-#if DB_FEATURE_INTEGRITY
-  int missing_bytes;
-  char buf[rel->row_length];
-#endif
-
-  end = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
-  if(end == (cfs_offset_t)-1) {
-    return DB_STORAGE_ERROR;
-  }
+  db_result_t result;
+  cfs_offset_t end;
 
-#if DB_FEATURE_INTEGRITY
-  missing_bytes = end % rel->row_length;
-  if(missing_bytes > 0) {
-    memset(buf, 0xff, sizeof(buf));
-    r = cfs_write(rel->tuple_storage, buf, sizeof(buf));
-    if(r != missing_bytes) {
+  if(rel->row_length > DB_ROW_BLOCK_SIZE ||
+     !append_pending(rel->tuple_filename) ||
+     append_block.length + rel->row_length > sizeof(append_block.data)) {
+    if(DB_ERROR(storage_flush())) {
       return DB_STORAGE_ERROR;
     }
   }
-#endif
 
   /* Ensure that last written byte is separated from 0, to make file
      lengths correct in Coffee. */
   last_byte = row + rel->row_length - 1;
   *last_byte ^= ROW_XOR;
 
-  remaining = rel->row_length;
-  do {
-    r = cfs_write(rel->tuple_storage, row, remaining);
-    if(r < 0) {
-      PRINTF("DB: Failed to store %u bytes\n", remaining);
-      *last_byte ^= ROW_XOR;
-      return DB_STORAGE_ERROR;
+  if(rel->row_length > DB_ROW_BLOCK_SIZE) {
+    end = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
+    if(end == (cfs_offset_t)-1) {
+      result = DB_STORAGE_ERROR;
+    } else {
+      result = DB_OK;
+#if DB_FEATURE_INTEGRITY
+      result = pad_row(rel->tuple_storage, end, rel->row_length);
+#endif
+      if(result == DB_OK) {
+        result = write_all(rel->tuple_storage, row, rel->row_length);
+      }
     }
-    row += r;
-    remaining -= r;
-  } while(remaining > 0);
-
-  PRINTF("DB: Stored a of %d bytes\n", rel->row_length);
+    if(result != DB_OK) {
+      /* A part of the row may have been written. */
+      rel->cardinality = INVALID_TUPLE;
+    }
+  } else {
+    if(append_block.length == 0) {
+      memcpy(append_block.filename, rel->tuple_filename,
+             sizeof(append_block.filename));
+      append_block.row_length = rel->row_length;
+      append_block.start = (cfs_offset_t)-1;
+    }
+    memcpy(append_block.data + append_block.length, row, rel->row_length);
+    append_block.length += rel->row_length;
+    result = DB_OK;
+  }
 
   *last_byte ^= ROW_XOR;
 
+  if(result == DB_OK && rel->cardinality != INVALID_TUPLE) {
+    rel->cardinality++;
+  }
+
+  PRINTF("DB: Stored a row of %d bytes\n", rel->row_length);
+
+  return result;
+}
+
+db_result_t
+storage_flush(void)
+{
+  int fd;
+  db_result_t result;
+  cfs_offset_t end;
+  cfs_offset_t written;
+
+  if(append_block.length == 0) {
+    return DB_OK;
+  }
+
+  fd = cfs_open(append_block.filename, CFS_WRITE | CFS_APPEND);
+  if(fd < 0) {
+    return DB_STORAGE_ERROR;
+  }
+
+  result = DB_OK;
+  end = cfs_seek(fd, 0, CFS_SEEK_END);
+  if(end == (cfs_offset_t)-1) {
+    result = DB_STORAGE_ERROR;
+  } else if(append_block.start == (cfs_offset_t)-1) {
+#if DB_FEATURE_INTEGRITY
+    result = pad_row(fd, end, append_block.row_length);
+    end += (append_block.row_length - end % append_block.row_length) %
+           append_block.row_length;
+#endif
+    if(result == DB_OK) {
+      append_block.start = end;
+    }
+  }
+
+  if(result == DB_OK) {
+    /* Continue after what an earlier, failed flush has written. */
+    written = end - append_block.start;
+    if(written < 0 || written > append_block.length) {
+      written = 0;
+    }
+    result = write_all(fd, append_block.data + written,
+                       append_block.length - written);
+  }
+
+  cfs_close(fd);
+
+  if(result != DB_OK) {
+    PRINTF("DB: Failed to store %u bytes\n", append_block.length);
+    return result;
+  }
+
+  PRINTF("DB: Flushed %u bytes to %s\n", append_block.length,
+         append_block.filename);
+
+  append_block.length = 0;
+
   return DB_OK;
 }
 
@@ -496,13 +770,31 @@ storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
 
   if(rel->row_length == 0) {
     *amount = 0;
+  } else if(rel->cardinality != INVALID_TUPLE) {
+    *amount = rel->cardinality;
   } else {
+    if(append_pending(rel->tuple_filename) && DB_ERROR(storage_flush())) {
+      return DB_STORAGE_ERROR;
+    }
+
     offset = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
     if(offset == (cfs_offset_t)-1) {
       return DB_STORAGE_ERROR;
     }
 
+#if DB_FEATURE_INTEGRITY
+    /* Pad a torn last row before the next tuple ID is handed out, so
+       that the row appended with that ID ends up at its position. */
+    if(offset % rel->row_length != 0) {
+      if(DB_ERROR(pad_row(rel->tuple_storage, offset, rel->row_length))) {
+        return DB_STORAGE_ERROR;
+      }
+      offset += rel->row_length - offset % rel->row_length;
+    }
+#endif
+
     *amount = (tuple_id_t)(offset / rel->row_length);
+    rel->cardinality = *amount;
   }
 
   return DB_OK;
@@ -67,6 +67,7 @@ db_result_t storage_put_index(index_t *);
 db_result_t storage_get_row(relation_t *, tuple_id_t *, storage_row_t);
 db_result_t storage_put_row(relation_t *, storage_row_t);
 db_result_t storage_get_row_amount(relation_t *, tuple_id_t *);
+db_result_t storage_flush(void);
 
 db_storage_id_t storage_open(const char *);
 void storage_close(db_storage_id_t);
@@ -55,6 +55,17 @@
 /*---------------------------------------------------------------------------*/
 MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
 LIST(observers_list);
+
+/*
+ * Notifications are serialized once per notify call, without a token,
+ * COAP_TOKEN_LEN bytes into this buffer. The header and token of each
+ * observer are then written right in front of the options, so that the
+ * packet for any token length is contiguous without copying the rest.
+ */
+static uint8_t notification_buffer[COAP_TOKEN_LEN + COAP_MAX_PACKET_SIZE + 1];
+
+/* Observe sequence number shared by all observers (RFC 7641, 3.4) */
+static uint32_t observe_seq;
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -79,6 +90,7 @@ add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token,
     o->token_len = token_len;
     memcpy(o->token, token, token_len);
     o->last_mid = 0;
+    o->obs_counter = 0;
 
     PRINTF("Adding observer (%u/%u) for /%s [0x%02X%02X]\n",
            list_length(observers_list) + 1, COAP_MAX_OBSERVERS,
@@ -185,6 +197,28 @@ coap_notify_observers(resource_t *resource)
 {
   coap_notify_observers_sub(resource, NULL);
 }
+/*
+ * Writes the header and token of an observer in front of the options.
+ * This overwrites the template header, so the response code is passed
+ * in rather than read back from the buffer.
+ */
+static uint8_t *
+prepare_notification(coap_observer_t *obs, coap_message_type_t type,
+                     uint8_t code, uint16_t mid)
+{
+  uint8_t *packet;
+
+  packet = notification_buffer + COAP_TOKEN_LEN - obs->token_len;
+  packet[0] = (COAP_HEADER_VERSION_MASK & 1 << COAP_HEADER_VERSION_POSITION)
+    | (COAP_HEADER_TYPE_MASK & type << COAP_HEADER_TYPE_POSITION)
+    | (COAP_HEADER_TOKEN_LEN_MASK & obs->token_len);
+  packet[1] = code;
+  packet[2] = (uint8_t)(mid >> 8);
+  packet[3] = (uint8_t)mid;
+  memcpy(packet + COAP_HEADER_LEN, obs->token, obs->token_len);
+  return packet;
+}
+/*---------------------------------------------------------------------------*/
 void
 coap_notify_observers_sub(resource_t *resource, const char *subpath)
 {
@@ -192,8 +226,14 @@ coap_notify_observers_sub(resource_t *resource, const char *subpath)
   coap_packet_t notification[1]; /* this way the packet can be treated as pointer as usual */
   coap_packet_t request[1]; /* this way the packet can be treated as pointer as usual */
   coap_observer_t *obs = NULL;
+  coap_observer_t *next;
+  coap_transaction_t *transaction;
   int url_len, obs_url_len;
   char url[COAP_OBSERVER_URL_LEN];
+  uint8_t *packet;
+  uint16_t template_len;
+  uint16_t packet_len;
+  uint16_t mid;
 
   url_len = strlen(resource->url);
   strncpy(url, resource->url, COAP_OBSERVER_URL_LEN - 1);
@@ -210,10 +250,13 @@ coap_notify_observers_sub(resource_t *resource, const char *subpath)
   coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
   coap_set_header_uri_path(request, url);
 
+  /* the representation is generated only once for all observers */
+  template_len = 0;
+
   /* iterate over observers */
   url_len = strlen(url);
-  for(obs = (coap_observer_t *)list_head(observers_list); obs;
-      obs = obs->next) {
+  for(obs = (coap_observer_t *)list_head(observers_list); obs; obs = next) {
+    next = obs->next;
     obs_url_len = strlen(obs->url);
 
     /* Do a match based on the parent/sub-resource match so that it is
@@ -223,42 +266,65 @@ coap_notify_observers_sub(resource_t *resource, const char *subpath)
             && (resource->flags & HAS_SUB_RESOURCES)
             && obs->url[url_len] == '/'))
        && strncmp(url, obs->url, url_len) == 0) {
-      coap_transaction_t *transaction = NULL;
-
-      /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers */
-
-      if((transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port))) {
-        if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
-          PRINTF("           Force Confirmable for\n");
-          notification->type = COAP_TYPE_CON;
-        }
-
-        PRINTF("           Observer ");
-        PRINT6ADDR(&obs->addr);
-        PRINTF(":%u\n", obs->port);
-
-        /* update last MID for RST matching */
-        obs->last_mid = transaction->mid;
-
-        /* prepare response */
-        notification->mid = transaction->mid;
 
+      if(template_len == 0) {
         resource->get_handler(request, notification,
-                              transaction->packet + COAP_MAX_HEADER_SIZE,
+                              notification_buffer + COAP_TOKEN_LEN
+                              + COAP_MAX_HEADER_SIZE,
                               REST_MAX_CHUNK_SIZE, NULL);
-
         if(notification->code < BAD_REQUEST_4_00) {
-          coap_set_header_observe(notification, (obs->obs_counter)++);
+          coap_set_header_observe(notification, observe_seq++);
           /* mask out to keep the CoAP observe option length <= 3 bytes */
-          obs->obs_counter &= 0xffffff;
+          observe_seq &= 0xffffff;
+        }
+        template_len = coap_serialize_message(notification,
+                                              notification_buffer
+                                              + COAP_TOKEN_LEN);
+        if(template_len < COAP_HEADER_LEN) {
+          PRINTF("Observe: could not serialize notification\n");
+          return;
         }
-        coap_set_token(notification, obs->token, obs->token_len);
+      }
+
+      PRINTF("           Observer ");
+      PRINT6ADDR(&obs->addr);
+      PRINTF(":%u\n", obs->port);
+
+      packet_len = template_len + obs->token_len;
+      mid = coap_get_mid();
+      transaction = NULL;
+      if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
+        /*
+         * Confirmable notifications need a transaction for
+         * retransmissions. If none is available, the notification is
+         * sent as NON and the refresh is retried with the next one.
+         */
+        transaction = coap_new_transaction(mid, &obs->addr, obs->port);
+        if(transaction == NULL) {
+          PRINTF("           No transaction for CON, sending NON\n");
+        }
+      }
 
-        transaction->packet_len =
-          coap_serialize_message(notification, transaction->packet);
+      /* update last MID for RST matching */
+      obs->last_mid = mid;
 
+      if(transaction) {
+        PRINTF("           Force Confirmable for\n");
+        ++obs->obs_counter;
+        packet = prepare_notification(obs, COAP_TYPE_CON,
+                                      notification->code, mid);
+        memcpy(transaction->packet, packet, packet_len);
+        transaction->packet_len = packet_len;
         coap_send_transaction(transaction);
+      } else {
+        if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL != 0) {
+          ++obs->obs_counter;
+        }
+        packet = prepare_notification(obs, COAP_TYPE_NON,
+                                      notification->code, mid);
+        coap_send_message(&obs->addr, obs->port, packet, packet_len);
       }
+      obs->obs_counter &= 0xffffff;
     }
   }
 }
@@ -277,9 +343,10 @@ coap_observe_handler(resource_t *resource, void *request, void *response)
                            coap_req->token, coap_req->token_len,
                            coap_req->uri_path, coap_req->uri_path_len);
         if(obs) {
-          coap_set_header_observe(coap_res, (obs->obs_counter)++);
+          coap_set_header_observe(coap_res, observe_seq++);
           /* mask out to keep the CoAP observe option length <= 3 bytes */
-          obs->obs_counter &= 0xffffff;
+          observe_seq &= 0xffffff;
+          ++obs->obs_counter;
           /*
            * Following payload is for demonstration purposes only.
            * A subscription should return the same representation as a normal GET.
@@ -57,6 +57,9 @@
 
 #define JSON_TYPE_CALLBACK 'C'
 
+/* returned by the parser when a streamed document needs more input */
+#define JSON_TYPE_INCOMPLETE '?'
+
 /* integer pointer types */
 #define JSON_TYPE_S8PTR 'b'
 #define JSON_TYPE_U8PTR 'B'
@@ -72,7 +75,9 @@ enum {
   JSON_ERROR_UNEXPECTED_END_OF_ARRAY,
   JSON_ERROR_UNEXPECTED_OBJECT,
   JSON_ERROR_UNEXPECTED_END_OF_OBJECT,
-  JSON_ERROR_UNEXPECTED_STRING
+  JSON_ERROR_UNEXPECTED_STRING,
+  JSON_ERROR_TOO_DEEP,
+  JSON_ERROR_TOO_LONG
 };
 
 #define JSON_CONTENT_TYPE "application/json"
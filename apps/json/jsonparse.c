@@ -33,14 +33,23 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* values of the stream field */
+#define STREAM_NONE   0
+#define STREAM_OPEN   1
+#define STREAM_ENDED  2
+
 /*--------------------------------------------------------------------*/
 static int
 push(struct jsonparse_state *state, char c)
 {
+  if(state->depth >= JSONPARSE_MAX_DEPTH) {
+    state->error = JSON_ERROR_TOO_DEEP;
+    return 0;
+  }
   state->stack[state->depth] = c;
   state->depth++;
   state->vtype = 0;
-  return state->depth < JSONPARSE_MAX_DEPTH;
+  return 1;
 }
 /*--------------------------------------------------------------------*/
 static void
@@ -74,7 +83,9 @@ atomic(struct jsonparse_state *state, char type)
 
   state->vstart = state->pos;
   if(type == JSON_TYPE_STRING || type == JSON_TYPE_PAIR_NAME) {
-    while((c = state->json[state->pos++]) && c != '"') {
+    c = 0;
+    while(state->pos < state->len &&
+          (c = state->json[state->pos++]) && c != '"') {
       if(c == '\\') {
         state->pos++;           /* skip current char */
       }
@@ -86,7 +97,7 @@ atomic(struct jsonparse_state *state, char type)
     state->vlen = state->pos - state->vstart - 1;
   } else if(type == JSON_TYPE_NUMBER) {
     do {
-      c = state->json[state->pos];
+      c = state->pos < state->len ? state->json[state->pos] : 0;
       if((c < '0' || c > '9') && c != '.') {
         c = 0;
       } else {
@@ -105,15 +116,15 @@ atomic(struct jsonparse_state *state, char type)
     default:              str = "";      break;
     }
 
-    while ((c = state->json[state->pos]) && c != ' ' && c != ',' && c != ']' && c != '}') {
+    while (state->pos < state->len &&
+           (c = state->json[state->pos]) && c != ' ' && c != ',' && c != ']' && c != '}') {
       state->pos++;
     }
 
     state->vlen = state->pos - state->vstart;
     len = strlen(str);
-    len = state->vlen > len ? state->vlen : len;
 
-    if (strncmp(str, &state->json[state->vstart], len) != 0) {
+    if (state->vlen != len || strncmp(str, &state->json[state->vstart], len) != 0) {
       state->error = JSON_ERROR_SYNTAX;
       return JSON_TYPE_ERROR;
     }
@@ -145,6 +156,65 @@ is_atomic(struct jsonparse_state *state)
   }
 }
 /*--------------------------------------------------------------------*/
+/* check if the element at the current position ends before the end of
+   the current chunk of a streamed document */
+/*--------------------------------------------------------------------*/
+static int
+is_complete(struct jsonparse_state *state)
+{
+  const char *json = state->json;
+  int i = state->pos;
+  char c = json[i];
+
+  if(c == '"') {
+    for(i++; i < state->len; i++) {
+      if(json[i] == '\\') {
+        i++;
+      } else if(json[i] == '"') {
+        return 1;
+      }
+    }
+    return 0;
+  } else if(c == '-' || (c >= '0' && c <= '9')) {
+    for(i++; i < state->len; i++) {
+      if((json[i] < '0' || json[i] > '9') && json[i] != '.') {
+        return 1;
+      }
+    }
+    return 0;
+  } else if(c == 'n' || c == 't' || c == 'f') {
+    for(i++; i < state->len; i++) {
+      c = json[i];
+      if(c == ' ' || c == ',' || c == ']' || c == '}') {
+        return 1;
+      }
+    }
+    return 0;
+  }
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+static int
+incomplete(struct jsonparse_state *state)
+{
+  int rest;
+
+  /* Keep the rest of the chunk in the carry buffer, so that the caller
+     can reuse the chunk. It must fit together with at least one byte
+     from the next chunk. */
+  rest = state->len - state->pos;
+  if(rest >= state->carry_size) {
+    state->error = JSON_ERROR_TOO_LONG;
+    return JSON_TYPE_ERROR;
+  }
+  memmove(state->carry, state->json + state->pos, rest);
+  state->json = state->carry;
+  state->len = rest;
+  state->pos = 0;
+  state->chunk = NULL;
+  return JSON_TYPE_INCOMPLETE;
+}
+/*--------------------------------------------------------------------*/
 void
 jsonparse_setup(struct jsonparse_state *state, const char *json, int len)
 {
@@ -155,6 +225,53 @@ jsonparse_setup(struct jsonparse_state *state, const char *json, int len)
   state->error = 0;
   state->vtype = 0;
   state->stack[0] = 0;
+  state->stream = STREAM_NONE;
+  state->chunk = NULL;
+}
+/*--------------------------------------------------------------------*/
+void
+jsonparse_setup_stream(struct jsonparse_state *state, char *carry, int size)
+{
+  jsonparse_setup(state, carry, 0);
+  state->stream = STREAM_OPEN;
+  state->carry = carry;
+  state->carry_size = size;
+}
+/*--------------------------------------------------------------------*/
+void
+jsonparse_feed(struct jsonparse_state *state, const char *json, int len)
+{
+  int rest;
+  int n;
+
+  rest = state->len - state->pos;
+  if(rest <= 0) {
+    state->json = json;
+    state->len = len;
+    state->pos = 0;
+    state->chunk = NULL;
+    return;
+  }
+
+  /* An element was split between the chunks: add as much as possible
+     of the new chunk to the rest of the old one in the carry buffer,
+     and continue in the new chunk once we have parsed past the old
+     part. */
+  n = state->carry_size - rest;
+  if(n > len) {
+    n = len;
+  }
+  memcpy(state->carry + rest, json, n);
+  state->len = rest + n;
+  state->carry_len = rest;
+  state->chunk = json;
+  state->chunk_len = len;
+}
+/*--------------------------------------------------------------------*/
+void
+jsonparse_finish(struct jsonparse_state *state)
+{
+  state->stream = STREAM_ENDED;
 }
 /*--------------------------------------------------------------------*/
 int
@@ -164,8 +281,26 @@ jsonparse_next(struct jsonparse_state *state)
   char s;
   char v;
 
+  if(state->chunk != NULL && state->pos >= state->carry_len) {
+    /* Done with the carried element, switch to the current chunk */
+    state->pos -= state->carry_len;
+    state->json = state->chunk;
+    state->len = state->chunk_len;
+    state->chunk = NULL;
+  }
+
   skip_ws(state);
-  c = state->json[state->pos];
+  if(state->pos >= state->len) {
+    if(state->stream == STREAM_OPEN) {
+      return JSON_TYPE_INCOMPLETE;
+    }
+    c = 0;
+  } else {
+    if(state->stream == STREAM_OPEN && !is_complete(state)) {
+      return incomplete(state);
+    }
+    c = state->json[state->pos];
+  }
   s = jsonparse_get_type(state);
   v = state->vtype;
   state->pos++;
@@ -173,7 +308,9 @@ jsonparse_next(struct jsonparse_state *state)
   switch(c) {
   case '{':
     if((s == 0 && v == 0) || s == '[' || s == ':') {
-      push(state, c);
+      if(!push(state, c)) {
+        return JSON_TYPE_ERROR;
+      }
     } else {
       state->error = JSON_ERROR_UNEXPECTED_OBJECT;
       return JSON_TYPE_ERROR;
@@ -225,7 +362,9 @@ jsonparse_next(struct jsonparse_state *state)
     return c;
   case '[':
     if((s == 0 && v == 0) || s == '[' || s == ':') {
-      push(state, c);
+      if(!push(state, c)) {
+        return JSON_TYPE_ERROR;
+      }
     } else {
       state->error = JSON_ERROR_UNEXPECTED_ARRAY;
       return JSON_TYPE_ERROR;
@@ -297,13 +436,43 @@ jsonparse_copy_value(struct jsonparse_state *state, char *str, int size)
   return state->vtype;
 }
 /*--------------------------------------------------------------------*/
+const char *
+jsonparse_get_value_ptr(struct jsonparse_state *state)
+{
+  if(!is_atomic(state)) {
+    return NULL;
+  }
+  return &state->json[state->vstart];
+}
+/*--------------------------------------------------------------------*/
+/* the input need not be null-terminated, so the number is parsed
+   within its length rather than with atol() */
+/*--------------------------------------------------------------------*/
+static long
+get_long(struct jsonparse_state *state)
+{
+  const char *p = &state->json[state->vstart];
+  const char *end = p + state->vlen;
+  long value = 0;
+  int negative = 0;
+
+  if(p < end && *p == '-') {
+    negative = 1;
+    p++;
+  }
+  while(p < end && *p >= '0' && *p <= '9') {
+    value = value * 10 + (*p++ - '0');
+  }
+  return negative ? -value : value;
+}
+/*--------------------------------------------------------------------*/
 int
 jsonparse_get_value_as_int(struct jsonparse_state *state)
 {
   if(state->vtype != JSON_TYPE_NUMBER) {
     return 0;
   }
-  return atoi(&state->json[state->vstart]);
+  return (int)get_long(state);
 }
 /*--------------------------------------------------------------------*/
 long
@@ -312,7 +481,7 @@ jsonparse_get_value_as_long(struct jsonparse_state *state)
   if(state->vtype != JSON_TYPE_NUMBER) {
     return 0;
   }
-  return atol(&state->json[state->vstart]);
+  return get_long(state);
 }
 /*--------------------------------------------------------------------*/
 /* strcmp - assume no strange chars that needs to be stuffed in string... */
@@ -52,6 +52,13 @@ struct jsonparse_state {
   char vtype;
   char error;
   char stack[JSONPARSE_MAX_DEPTH];
+  /* for parsing a document that arrives in chunks */
+  char stream;
+  char *carry;
+  int carry_size;
+  int carry_len;
+  const char *chunk;
+  int chunk_len;
 };
 
 /**
@@ -66,6 +73,45 @@ struct jsonparse_state {
 void jsonparse_setup(struct jsonparse_state *state, const char *json,
                      int len);
 
+/**
+ * \brief      Initialize a JSON parser state for a streamed document.
+ * \param state A pointer to a JSON parser state
+ * \param carry A buffer for values that are split between chunks
+ * \param size The size of the carry buffer
+ *
+ *             This function initializes a JSON parser state for
+ *             parsing a document that is fed to the parser in chunks
+ *             with jsonparse_feed(). When the parser reaches the end
+ *             of a chunk, jsonparse_next() returns
+ *             JSON_TYPE_INCOMPLETE and the next chunk should be fed.
+ *             A value that is split between two chunks is put
+ *             together in the carry buffer, which must be large
+ *             enough for the longest string or number in the
+ *             document. The unparsed tail of a chunk is copied there
+ *             before JSON_TYPE_INCOMPLETE is returned, so the chunk
+ *             need not remain valid after that.
+ */
+void jsonparse_setup_stream(struct jsonparse_state *state, char *carry,
+                            int size);
+
+/**
+ * \brief      Feed the next chunk of a streamed document.
+ * \param state A pointer to a JSON parser state
+ * \param json The next part of the document
+ * \param len  The length of the chunk
+ *
+ *             The chunk must remain valid until jsonparse_next() has
+ *             returned JSON_TYPE_INCOMPLETE for it.
+ */
+void jsonparse_feed(struct jsonparse_state *state, const char *json,
+                    int len);
+
+/**
+ * \brief      Tell the parser that a streamed document has ended.
+ * \param state A pointer to a JSON parser state
+ */
+void jsonparse_finish(struct jsonparse_state *state);
+
 /* move to next JSON element */
 int jsonparse_next(struct jsonparse_state *state);
 
@@ -73,6 +119,12 @@ int jsonparse_next(struct jsonparse_state *state);
 int jsonparse_copy_value(struct jsonparse_state *state, char *buf,
                          int buf_size);
 
+/* get a pointer to the current JSON value in the input, without
+   copying it. The value is jsonparse_get_len() characters long, is not
+   null-terminated and may contain escape sequences. It is valid until
+   the next call to jsonparse_next() or jsonparse_feed(). */
+const char *jsonparse_get_value_ptr(struct jsonparse_state *state);
+
 /* get the current JSON value parsed as an int */
 int jsonparse_get_value_as_int(struct jsonparse_state *state);
 
@@ -50,32 +50,83 @@
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+static void
+write_data(const struct jsontree_context *js_ctx, const char *data, int len)
+{
+  struct jsontree_buffer *out = js_ctx->out;
+  int n;
+
+  if(out == NULL) {
+    while(len-- > 0) {
+      js_ctx->putchar(*data++);
+    }
+    return;
+  }
+
+  while(len > 0) {
+    if(out->len == out->size) {
+      if(out->flush == NULL) {
+        out->overflow = 1;
+        return;
+      }
+      out->flush(out->data, out->len);
+      out->len = 0;
+    }
+    n = out->size - out->len;
+    if(n > len) {
+      n = len;
+    }
+    memcpy(out->data + out->len, data, n);
+    out->len += n;
+    data += n;
+    len -= n;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+jsontree_putchar(const struct jsontree_context *js_ctx, int c)
+{
+  struct jsontree_buffer *out = js_ctx->out;
+  char ch;
+
+  if(out != NULL && out->len < out->size) {
+    out->data[out->len++] = c;
+  } else if(out == NULL) {
+    js_ctx->putchar(c);
+  } else {
+    ch = c;
+    write_data(js_ctx, &ch, 1);
+  }
+}
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_atom(const struct jsontree_context *js_ctx, const char *text)
 {
   if(text == NULL) {
-    js_ctx->putchar('0');
+    jsontree_putchar(js_ctx, '0');
   } else {
-    while(*text != '\0') {
-      js_ctx->putchar(*text++);
-    }
+    write_data(js_ctx, text, strlen(text));
   }
 }
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_string(const struct jsontree_context *js_ctx, const char *text)
 {
-  js_ctx->putchar('"');
+  const char *run;
+
+  jsontree_putchar(js_ctx, '"');
   if(text != NULL) {
     while(*text != '\0') {
+      for(run = text; *text != '\0' && *text != '"'; text++);
+      write_data(js_ctx, run, text - run);
       if(*text == '"') {
-        js_ctx->putchar('\\');
+        jsontree_putchar(js_ctx, '\\');
+        jsontree_putchar(js_ctx, *text++);
       }
-      js_ctx->putchar(*text++);
     }
   }
-  js_ctx->putchar('"');
+  jsontree_putchar(js_ctx, '"');
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -90,16 +141,14 @@ jsontree_write_uint(const struct jsontree_context *js_ctx, unsigned int value)
     value /= 10;
   } while(value > 0 && l >= 0);
 
-  while(++l < sizeof(buf)) {
-    js_ctx->putchar(buf[l]);
-  }
+  write_data(js_ctx, &buf[l + 1], sizeof(buf) - l - 1);
 }
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_int(const struct jsontree_context *js_ctx, int value)
 {
   if(value < 0) {
-    js_ctx->putchar('-');
+    jsontree_putchar(js_ctx, '-');
     value = -value;
   }
 
@@ -112,11 +161,36 @@ jsontree_setup(struct jsontree_context *js_ctx, struct jsontree_value *root,
 {
   js_ctx->values[0] = root;
   js_ctx->putchar = putchar;
+  js_ctx->out = NULL;
   js_ctx->path = 0;
   jsontree_reset(js_ctx);
 }
 /*---------------------------------------------------------------------------*/
 void
+jsontree_set_buffer(struct jsontree_context *js_ctx,
+                    struct jsontree_buffer *out, char *data, uint16_t size,
+                    void (* flush)(const char *data, int len))
+{
+  out->data = data;
+  out->size = size;
+  out->len = 0;
+  out->overflow = 0;
+  out->flush = flush;
+  js_ctx->out = out;
+}
+/*---------------------------------------------------------------------------*/
+void
+jsontree_flush(struct jsontree_context *js_ctx)
+{
+  struct jsontree_buffer *out = js_ctx->out;
+
+  if(out != NULL && out->flush != NULL && out->len > 0) {
+    out->flush(out->data, out->len);
+    out->len = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
 jsontree_reset(struct jsontree_context *js_ctx)
 {
   js_ctx->depth = 0;
@@ -153,46 +227,46 @@ jsontree_print_next(struct jsontree_context *js_ctx)
 
     index = js_ctx->index[js_ctx->depth];
     if(index == 0) {
-      js_ctx->putchar(v->type);
+      jsontree_putchar(js_ctx, v->type);
 #if JSONTREE_PRETTY
-      js_ctx->putchar('\n');
+      jsontree_putchar(js_ctx, '\n');
 #endif
     }
     if(index >= o->count) {
 #if JSONTREE_PRETTY
-      js_ctx->putchar('\n');
+      jsontree_putchar(js_ctx, '\n');
       indent = js_ctx->depth;
       while (indent--) {
-        js_ctx->putchar(' ');
-        js_ctx->putchar(' ');
+        jsontree_putchar(js_ctx, ' ');
+        jsontree_putchar(js_ctx, ' ');
       }
 #endif
-      js_ctx->putchar(v->type + 2);
+      jsontree_putchar(js_ctx, v->type + 2);
       /* Default operation: back up one level! */
       break;
     }
 
     if(index > 0) {
-      js_ctx->putchar(',');
+      jsontree_putchar(js_ctx, ',');
 #if JSONTREE_PRETTY
-      js_ctx->putchar('\n');
+      jsontree_putchar(js_ctx, '\n');
 #endif
     }
 
 #if JSONTREE_PRETTY
     indent = js_ctx->depth + 1;
     while (indent--) {
-      js_ctx->putchar(' ');
-      js_ctx->putchar(' ');
+      jsontree_putchar(js_ctx, ' ');
+      jsontree_putchar(js_ctx, ' ');
     }
 #endif
 
     if(v->type == JSON_TYPE_OBJECT) {
       jsontree_write_string(js_ctx,
                             ((struct jsontree_object *)o)->pairs[index].name);
-      js_ctx->putchar(':');
+      jsontree_putchar(js_ctx, ':');
 #if JSONTREE_PRETTY
-      js_ctx->putchar(' ');
+      jsontree_putchar(js_ctx, ' ');
 #endif
       ov = ((struct jsontree_object *)o)->pairs[index].value;
     } else {
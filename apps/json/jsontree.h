@@ -55,10 +55,20 @@
 #define JSONTREE_PRETTY 0
 #endif /* JSONTREE_CONF_PRETTY */
 
+/* An output buffer, see jsontree_set_buffer() */
+struct jsontree_buffer {
+  char *data;
+  uint16_t size;
+  uint16_t len;
+  uint8_t overflow;
+  void (* flush)(const char *data, int len);
+};
+
 struct jsontree_context {
   struct jsontree_value *values[JSONTREE_MAX_DEPTH];
   uint16_t index[JSONTREE_MAX_DEPTH];
   int (* putchar)(int);
+  struct jsontree_buffer *out;
   uint8_t depth;
   uint8_t path;
   int callback_state;
@@ -143,6 +153,32 @@ void jsontree_setup(struct jsontree_context *js_ctx,
                     struct jsontree_value *root, int (* putchar)(int));
 void jsontree_reset(struct jsontree_context *js_ctx);
 
+/**
+ * \brief      Write the output of a JSON tree to a buffer.
+ * \param js_ctx The context, set up with jsontree_setup()
+ * \param out  The buffer state
+ * \param data The buffer
+ * \param size The size of the buffer
+ * \param flush Called with the contents of the buffer when it is full,
+ *             or NULL
+ *
+ *             Instead of passing every character to the putchar
+ *             function, the output is copied to the buffer and handed
+ *             to the flush function one buffer at a time. Without a
+ *             flush function, the output stops when the buffer is full
+ *             and out->overflow is set. Call jsontree_flush() when
+ *             the tree has been printed. Callbacks must then write
+ *             their output with jsontree_putchar() or the
+ *             jsontree_write functions instead of js_ctx->putchar.
+ */
+void jsontree_set_buffer(struct jsontree_context *js_ctx,
+                         struct jsontree_buffer *out,
+                         char *data, uint16_t size,
+                         void (* flush)(const char *data, int len));
+void jsontree_flush(struct jsontree_context *js_ctx);
+
+void jsontree_putchar(const struct jsontree_context *js_ctx, int c);
+
 const char *jsontree_path_name(const struct jsontree_context *js_ctx,
                                int depth);
 
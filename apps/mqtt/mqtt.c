@@ -214,6 +214,10 @@ reset_defaults(struct mqtt_connection *conn)
 
   reset_packet(&conn->in_packet);
   conn->out_buffer_sent = 0;
+  conn->out_pending = PROCESS_EVENT_NONE;
+  conn->out_batch = 0;
+  conn->out_batch_len = 0;
+  memset(conn->inflight, 0, sizeof(conn->inflight));
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -224,6 +228,10 @@ abort_connection(struct mqtt_connection *conn)
 
   /* Reset outgoing packet */
   memset(&conn->out_packet, 0, sizeof(conn->out_packet));
+  conn->out_pending = PROCESS_EVENT_NONE;
+  conn->out_batch = 0;
+  conn->out_batch_len = 0;
+  memset(conn->inflight, 0, sizeof(conn->inflight));
 
   tcp_socket_close(&conn->socket);
   tcp_socket_unregister(&conn->socket);
@@ -272,8 +280,9 @@ send_out_buffer(struct mqtt_connection *conn)
   DBG("MQTT - (send_out_buffer) Space used in buffer: %i\n",
       conn->out_buffer_ptr - conn->out_buffer);
 
-  tcp_socket_send(&conn->socket, conn->out_buffer,
-                  conn->out_buffer_ptr - conn->out_buffer);
+  /* The out buffer is the socket's output buffer, so the data is in place */
+  tcp_socket_send_commit(&conn->socket,
+                         conn->out_buffer_ptr - conn->out_buffer);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -356,6 +365,62 @@ encode_remaining_length(uint8_t *remaining_length,
   DBG("MQTT - remaining_length_bytes %u\n", *remaining_length_bytes);
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t *
+write_publish(uint8_t *p, struct mqtt_out_packet *packet)
+{
+  *p++ = packet->fhdr;
+  memcpy(p, packet->remaining_length_enc, packet->remaining_length_enc_bytes);
+  p += packet->remaining_length_enc_bytes;
+  *p++ = packet->topic_length >> 8;
+  *p++ = packet->topic_length & 0x00FF;
+  memcpy(p, packet->topic, packet->topic_length);
+  p += packet->topic_length;
+  if(packet->qos > MQTT_QOS_LEVEL_0) {
+    *p++ = packet->mid >> 8;
+    *p++ = packet->mid & 0x00FF;
+  }
+  memcpy(p, packet->payload, packet->payload_size);
+  return p + packet->payload_size;
+}
+/*---------------------------------------------------------------------------*/
+static struct mqtt_inflight *
+inflight_alloc(struct mqtt_connection *conn)
+{
+  struct mqtt_inflight *f;
+  struct mqtt_inflight *oldest = NULL;
+  clock_time_t now = clock_time();
+
+  for(f = conn->inflight; f < &conn->inflight[MQTT_QOS1_WINDOW]; f++) {
+    if(f->mid == 0) {
+      return f;
+    }
+    if(oldest == NULL ||
+       (clock_time_t)(now - f->sent) > (clock_time_t)(now - oldest->sent)) {
+      oldest = f;
+    }
+  }
+
+  /* Like the one-at-a-time path, give up on a PUBACK after a while */
+  if((clock_time_t)(now - oldest->sent) >= RESPONSE_WAIT_TIMEOUT) {
+    DBG("MQTT - Timeout waiting for PUBACK for mid %u\n", oldest->mid);
+    return oldest;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct mqtt_inflight *
+inflight_find(struct mqtt_connection *conn, uint16_t mid)
+{
+  struct mqtt_inflight *f;
+
+  for(f = conn->inflight; f < &conn->inflight[MQTT_QOS1_WINDOW]; f++) {
+    if(f->mid == mid) {
+      return f;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 static void
 keep_alive_callback(void *ptr)
 {
@@ -417,16 +482,16 @@ PT_THREAD(connect_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTE(conn, conn->connect_vhdr_flags);
   PT_MQTT_WRITE_BYTE(conn, (conn->keep_alive >> 8));
   PT_MQTT_WRITE_BYTE(conn, (conn->keep_alive & 0x00FF));
-  PT_MQTT_WRITE_BYTE(conn, conn->client_id.length << 8);
+  PT_MQTT_WRITE_BYTE(conn, conn->client_id.length >> 8);
   PT_MQTT_WRITE_BYTE(conn, conn->client_id.length & 0x00FF);
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->client_id.string,
                       conn->client_id.length);
   if(conn->connect_vhdr_flags & MQTT_VHDR_WILL_FLAG) {
-    PT_MQTT_WRITE_BYTE(conn, conn->will.topic.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->will.topic.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->will.topic.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->will.topic.string,
                         conn->will.topic.length);
-    PT_MQTT_WRITE_BYTE(conn, conn->will.message.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->will.message.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->will.message.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->will.message.string,
                         conn->will.message.length);
@@ -437,14 +502,14 @@ PT_THREAD(connect_pt(struct pt *pt, struct mqtt_connection *conn))
         conn->will.message.length);
   }
   if(conn->connect_vhdr_flags & MQTT_VHDR_USERNAME_FLAG) {
-    PT_MQTT_WRITE_BYTE(conn, conn->credentials.username.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->credentials.username.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->credentials.username.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn,
                         (uint8_t *)conn->credentials.username.string,
                         conn->credentials.username.length);
   }
   if(conn->connect_vhdr_flags & MQTT_VHDR_PASSWORD_FLAG) {
-    PT_MQTT_WRITE_BYTE(conn, conn->credentials.password.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->credentials.password.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->credentials.password.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn,
                         (uint8_t *)conn->credentials.password.string,
@@ -535,7 +600,7 @@ PT_THREAD(subscribe_pt(struct pt *pt, struct mqtt_connection *conn))
                       conn->out_packet.remaining_length_enc,
                       conn->out_packet.remaining_length_enc_bytes);
   /* Write Variable Header */
-  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   /* Write Payload */
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.topic_length >> 8));
@@ -597,7 +662,7 @@ PT_THREAD(unsubscribe_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->out_packet.remaining_length_enc,
                       conn->out_packet.remaining_length_enc_bytes);
   /* Write Variable Header */
-  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   /* Write Payload */
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.topic_length >> 8));
@@ -670,7 +735,7 @@ PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->out_packet.topic,
                       conn->out_packet.topic_length);
   if(conn->out_packet.qos > MQTT_QOS_LEVEL_0) {
-    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
     PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   }
   /* Write Payload */
@@ -716,33 +781,40 @@ PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_END(pt);
 }
 /*---------------------------------------------------------------------------*/
-static
-PT_THREAD(pingreq_pt(struct pt *pt, struct mqtt_connection *conn))
+static void
+send_pingreq(struct mqtt_connection *conn)
 {
-  PT_BEGIN(pt);
+  uint8_t *p;
+
+  /*
+   * A PINGREQ is written in place behind any queued publishes, like the
+   * small publishes in mqtt_publish(), so that it does not have to wait for
+   * the output buffer to drain. If there is no room, the queued data keeps
+   * the connection alive instead: the keep alive timer is restarted when it
+   * has been sent.
+   */
+  if(MQTT_FHDR_SIZE + 1 > tcp_socket_max_sendlen(&conn->socket) -
+     conn->out_batch_len) {
+    DBG("MQTT - No room for PINGREQ, output buffer full\n");
+    return;
+  }
 
   DBG("MQTT - Sending PINGREQ\n");
 
-  /* Write Fixed Header */
-  PT_MQTT_WRITE_BYTE(conn, MQTT_FHDR_MSG_TYPE_PINGREQ);
-  PT_MQTT_WRITE_BYTE(conn, 0);
+  p = &conn->out_buffer[tcp_socket_queuelen(&conn->socket) +
+                        conn->out_batch_len];
+  p[0] = MQTT_FHDR_MSG_TYPE_PINGREQ;
+  p[1] = 0;
 
-  send_out_buffer(conn);
+  conn->out_buffer_sent = 0;
+  if(conn->out_batch) {
+    conn->out_batch_len += MQTT_FHDR_SIZE + 1;
+  } else {
+    tcp_socket_send_commit(&conn->socket, MQTT_FHDR_SIZE + 1);
+  }
 
-  /* Start timeout for reply. */
+  /* Cleared by handle_pingresp(), checked by keep_alive_callback() */
   conn->waiting_for_pingresp = 1;
-
-  /* Wait for PINGRESP or timeout */
-  reset_packet(&conn->in_packet);
-  timer_set(&conn->t, RESPONSE_WAIT_TIMEOUT);
-
-  PT_WAIT_UNTIL(pt, conn->in_packet.packet_received || timer_expired(&conn->t));
-
-  reset_packet(&conn->in_packet);
-
-  conn->waiting_for_pingresp = 0;
-
-  PT_END(pt);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -774,6 +846,8 @@ static void
 handle_pingresp(struct mqtt_connection *conn)
 {
   DBG("MQTT - Got RINGRESP\n");
+
+  conn->waiting_for_pingresp = 0;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -825,12 +899,24 @@ handle_unsuback(struct mqtt_connection *conn)
 static void
 handle_puback(struct mqtt_connection *conn)
 {
+  struct mqtt_inflight *f;
+
   DBG("MQTT - Got PUBACK\n");
 
-  conn->out_packet.qos_state = MQTT_QOS_STATE_GOT_ACK;
   conn->in_packet.mid = (conn->in_packet.payload[0] << 8) |
     (conn->in_packet.payload[1]);
 
+  f = NULL;
+  if(conn->in_packet.mid != 0) {
+    f = inflight_find(conn, conn->in_packet.mid);
+  }
+  if(f != NULL) {
+    f->mid = 0;
+  } else {
+    /* Not sent through the in-flight window, so it acks publish_pt */
+    conn->out_packet.qos_state = MQTT_QOS_STATE_GOT_ACK;
+  }
+
   call_event(conn, MQTT_EVENT_PUBACK, &conn->in_packet.mid);
 }
 /*---------------------------------------------------------------------------*/
@@ -1138,6 +1224,11 @@ tcp_event(struct tcp_socket *s, void *ptr, tcp_socket_event_t event)
     if(conn->socket.output_data_len == 0) {
       conn->out_buffer_sent = 1;
       conn->out_buffer_ptr = conn->out_buffer;
+
+      if(conn->out_pending != PROCESS_EVENT_NONE) {
+        process_post(&mqtt_process, conn->out_pending, conn);
+        conn->out_pending = PROCESS_EVENT_NONE;
+      }
     }
 
     ctimer_restart(&conn->keep_alive_timer);
@@ -1200,7 +1291,8 @@ PROCESS_THREAD(mqtt_process, ev, data)
           abort_connection(conn);
           call_event(conn, MQTT_EVENT_DISCONNECTED, &ev);
         } else {
-          process_post(&mqtt_process, mqtt_do_disconnect_mqtt_event, conn);
+          /* Sent from tcp_event() when the output buffer has drained */
+          conn->out_pending = mqtt_do_disconnect_mqtt_event;
         }
       }
     }
@@ -1208,25 +1300,27 @@ PROCESS_THREAD(mqtt_process, ev, data)
       conn = data;
       DBG("MQTT - Got mqtt_do_pingreq_event!\n");
 
-      if(conn->out_buffer_sent == 1 &&
-         conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
-        PT_INIT(&conn->out_proto_thread);
-        while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
-              pingreq_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
-          PT_MQTT_WAIT_SEND();
-        }
+      if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+        send_pingreq(conn);
       }
     }
     if(ev == mqtt_do_subscribe_event) {
       conn = data;
       DBG("MQTT - Got mqtt_do_subscribe_mqtt_event!\n");
 
-      if(conn->out_buffer_sent == 1 &&
-         conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
-        PT_INIT(&conn->out_proto_thread);
-        while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
-              subscribe_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
-          PT_MQTT_WAIT_SEND();
+      if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+        if(conn->out_buffer_sent == 1) {
+          PT_INIT(&conn->out_proto_thread);
+          while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
+                subscribe_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
+            PT_MQTT_WAIT_SEND();
+          }
+        } else {
+          /*
+           * Published messages are still queued in the output buffer. The
+           * event is posted again from tcp_event() when it has drained.
+           */
+          conn->out_pending = mqtt_do_subscribe_event;
         }
       }
     }
@@ -1234,12 +1328,19 @@ PROCESS_THREAD(mqtt_process, ev, data)
       conn = data;
       DBG("MQTT - Got mqtt_do_unsubscribe_mqtt_event!\n");
 
-      if(conn->out_buffer_sent == 1 &&
-         conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
-        PT_INIT(&conn->out_proto_thread);
-        while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
-              unsubscribe_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
-          PT_MQTT_WAIT_SEND();
+      if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+        if(conn->out_buffer_sent == 1) {
+          PT_INIT(&conn->out_proto_thread);
+          while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
+                unsubscribe_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
+            PT_MQTT_WAIT_SEND();
+          }
+        } else {
+          /*
+           * Published messages are still queued in the output buffer. The
+           * event is posted again from tcp_event() when it has drained.
+           */
+          conn->out_pending = mqtt_do_unsubscribe_event;
         }
       }
     }
@@ -1247,12 +1348,19 @@ PROCESS_THREAD(mqtt_process, ev, data)
       conn = data;
       DBG("MQTT - Got mqtt_do_publish_mqtt_event!\n");
 
-      if(conn->out_buffer_sent == 1 &&
-         conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
-        PT_INIT(&conn->out_proto_thread);
-        while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
-              publish_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
-          PT_MQTT_WAIT_SEND();
+      if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+        if(conn->out_buffer_sent == 1) {
+          PT_INIT(&conn->out_proto_thread);
+          while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
+                publish_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
+            PT_MQTT_WAIT_SEND();
+          }
+        } else {
+          /*
+           * Published messages are still queued in the output buffer. The
+           * event is posted again from tcp_event() when it has drained.
+           */
+          conn->out_pending = mqtt_do_publish_event;
         }
       }
     }
@@ -1424,34 +1532,131 @@ mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
              uint8_t *payload, uint32_t payload_size,
              mqtt_qos_level_t qos_level, mqtt_retain_t retain)
 {
+  struct mqtt_out_packet packet;
+  struct mqtt_inflight *f;
+  uint32_t packet_len;
+
   if(conn->state != MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
     return MQTT_STATUS_NOT_CONNECTED_ERROR;
   }
 
   DBG("MQTT - Call to mqtt_publish...\n");
 
-  /* Currently don't have a queue, so only one item at a time */
+  /* A subscribe, unsubscribe or large publish is being written out */
   if(conn->out_queue_full) {
     DBG("MQTT - Not accepted!\n");
     return MQTT_STATUS_OUT_QUEUE_FULL;
   }
+
+  packet.retain = retain;
+  packet.topic = topic;
+  packet.topic_length = strlen(topic);
+  packet.payload = payload;
+  packet.payload_size = payload_size;
+  packet.qos = qos_level;
+  packet.fhdr = MQTT_FHDR_MSG_TYPE_PUBLISH | qos_level << 1;
+  if(retain == MQTT_RETAIN_ON) {
+    packet.fhdr |= MQTT_FHDR_RETAIN_FLAG;
+  }
+  packet.remaining_length = MQTT_STRING_LEN_SIZE + packet.topic_length +
+    payload_size;
+  if(qos_level > MQTT_QOS_LEVEL_0) {
+    packet.remaining_length += MQTT_MID_SIZE;
+  }
+  encode_remaining_length(packet.remaining_length_enc,
+                          &packet.remaining_length_enc_bytes,
+                          packet.remaining_length);
+  if(packet.remaining_length_enc_bytes > 4) {
+    return MQTT_STATUS_INVALID_ARGS_ERROR;
+  }
+  packet_len = MQTT_FHDR_SIZE + packet.remaining_length_enc_bytes +
+    packet.remaining_length;
+
+  if(packet_len <= MQTT_TCP_OUTPUT_BUFF_SIZE &&
+     qos_level < MQTT_QOS_LEVEL_2) {
+    /*
+     * Write the message straight into the free part of the socket's output
+     * buffer, behind anything that is already queued there.
+     */
+    if(packet_len > tcp_socket_max_sendlen(&conn->socket) -
+       conn->out_batch_len) {
+      DBG("MQTT - Not accepted, output buffer full\n");
+      return MQTT_STATUS_OUT_QUEUE_FULL;
+    }
+
+    f = NULL;
+    if(qos_level == MQTT_QOS_LEVEL_1) {
+      f = inflight_alloc(conn);
+      if(f == NULL) {
+        DBG("MQTT - Not accepted, QoS 1 window full\n");
+        return MQTT_STATUS_OUT_QUEUE_FULL;
+      }
+    }
+
+    packet.mid = INCREMENT_MID(conn);
+    write_publish(&conn->out_buffer[tcp_socket_queuelen(&conn->socket) +
+                                    conn->out_batch_len], &packet);
+    if(f != NULL) {
+      f->mid = packet.mid;
+      f->sent = clock_time();
+    }
+    if(mid != NULL) {
+      *mid = packet.mid;
+    }
+
+    conn->out_buffer_sent = 0;
+    if(conn->out_batch) {
+      conn->out_batch_len += packet_len;
+    } else {
+      tcp_socket_send_commit(&conn->socket, packet_len);
+    }
+    DBG("MQTT - Accepted!\n");
+    return MQTT_STATUS_OK;
+  }
+
+  /*
+   * Too large for the output buffer, or QoS 2: let publish_pt send it in
+   * pieces, one message at a time.
+   */
+  if(conn->out_batch) {
+    return MQTT_STATUS_OUT_QUEUE_FULL;
+  }
   conn->out_queue_full = 1;
   DBG("MQTT - Accepted!\n");
 
   conn->out_packet.mid = INCREMENT_MID(conn);
   conn->out_packet.retain = retain;
   conn->out_packet.topic = topic;
-  conn->out_packet.topic_length = strlen(topic);
+  conn->out_packet.topic_length = packet.topic_length;
   conn->out_packet.payload = payload;
   conn->out_packet.payload_size = payload_size;
   conn->out_packet.qos = qos_level;
   conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+  if(mid != NULL) {
+    *mid = conn->out_packet.mid;
+  }
 
   process_post(&mqtt_process, mqtt_do_publish_event, conn);
   return MQTT_STATUS_OK;
 }
 /*----------------------------------------------------------------------------*/
 void
+mqtt_batch_begin(struct mqtt_connection *conn)
+{
+  conn->out_batch = 1;
+}
+/*----------------------------------------------------------------------------*/
+void
+mqtt_batch_end(struct mqtt_connection *conn)
+{
+  conn->out_batch = 0;
+  if(conn->out_batch_len > 0) {
+    tcp_socket_send_commit(&conn->socket, conn->out_batch_len);
+    conn->out_batch_len = 0;
+  }
+}
+/*----------------------------------------------------------------------------*/
+void
 mqtt_set_username_password(struct mqtt_connection *conn, char *username,
                            char *password)
 {
@@ -117,6 +117,16 @@
 #define MQTT_PROTOCOL_VERSION 3
 #define MQTT_PROTOCOL_NAME "MQIsdp"
 #define MQTT_TOPIC_MAX_LENGTH 128
+
+/*
+ * Number of QoS 1 PUBLISH messages that may be waiting for their PUBACK at
+ * the same time. Each one costs a mid and a timestamp per connection.
+ */
+#ifdef MQTT_CONF_QOS1_WINDOW
+#define MQTT_QOS1_WINDOW MQTT_CONF_QOS1_WINDOW
+#else
+#define MQTT_QOS1_WINDOW 1
+#endif
 /*---------------------------------------------------------------------------*/
 /*
  * Debug configuration, this is similar but not exactly like the Debugging
@@ -283,6 +293,11 @@ struct mqtt_out_packet {
   mqtt_qos_state_t qos_state;
   mqtt_retain_t retain;
 };
+/* A QoS 1 PUBLISH message that has been sent but not yet acknowledged. */
+struct mqtt_inflight {
+  uint16_t mid;      /* 0 if the slot is free */
+  clock_time_t sent;
+};
 /*---------------------------------------------------------------------------*/
 /**
  * \brief           MQTT event callback function
@@ -343,10 +358,15 @@ struct mqtt_connection {
   uint8_t *out_buffer_ptr;
   uint8_t out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE];
   uint8_t out_buffer_sent;
+  /* Event to post to the MQTT process once the output buffer has drained */
+  process_event_t out_pending;
   struct mqtt_out_packet out_packet;
   struct pt out_proto_thread;
   uint32_t out_write_pos;
   uint16_t max_segment_size;
+  uint8_t out_batch;
+  uint16_t out_batch_len;
+  struct mqtt_inflight inflight[MQTT_QOS1_WINDOW];
 
   /* Incoming data related */
   uint8_t in_buffer[MQTT_TCP_INPUT_BUFF_SIZE];
@@ -450,6 +470,15 @@ mqtt_status_t mqtt_unsubscribe(struct mqtt_connection *conn,
  * \return MQTT_STATUS_OK or some error status
  *
  * This function publishes to a topic on a MQTT broker.
+ *
+ * A message that fits in the free space of the TCP output buffer is written
+ * there directly and the function returns without waiting for the message to
+ * be sent. Up to MQTT_QOS1_WINDOW QoS 1 messages may be waiting for a PUBACK
+ * at the same time; the MQTT_EVENT_PUBACK event carries the mid of the
+ * message that was acknowledged. MQTT_STATUS_OUT_QUEUE_FULL is returned when
+ * there is no room for the message right now.
+ *
+ * Messages larger than the output buffer are sent one at a time, as before.
  */
 mqtt_status_t mqtt_publish(struct mqtt_connection *conn,
                            uint16_t *mid,
@@ -459,6 +488,29 @@ mqtt_status_t mqtt_publish(struct mqtt_connection *conn,
                            mqtt_qos_level_t qos_level,
                            mqtt_retain_t retain);
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief Start a batch of PUBLISH messages.
+ * \param conn A pointer to the MQTT connection.
+ *
+ * Messages published with mqtt_publish() after this call are written to the
+ * TCP output buffer but not handed to the TCP stack until mqtt_batch_end() is
+ * called, so that a burst of small messages goes out in as few TCP segments
+ * as possible. Only messages that fit in the output buffer are accepted
+ * during a batch.
+ *
+ * The whole batch must be published without giving up control to other
+ * processes between mqtt_batch_begin() and mqtt_batch_end().
+ */
+void mqtt_batch_begin(struct mqtt_connection *conn);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief End a batch of PUBLISH messages.
+ * \param conn A pointer to the MQTT connection.
+ *
+ * This function sends all messages published since mqtt_batch_begin().
+ */
+void mqtt_batch_end(struct mqtt_connection *conn);
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Set the user name and password for a MQTT client.
  * \param conn A pointer to the MQTT connection.
@@ -67,6 +67,8 @@ struct powertrace_sniff_stats {
 MEMB(stats_memb, struct powertrace_sniff_stats, MAX_NUM_STATS);
 LIST(stats_list);
 
+static powertrace_write_t stream_write;
+
 PROCESS(powertrace_process, "Periodic power output");
 /*---------------------------------------------------------------------------*/
 void
@@ -191,6 +193,85 @@ powertrace_print(char *str)
   seqno++;
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t *
+put32(uint8_t *ptr, unsigned long value)
+{
+  ptr[0] = value & 0xff;
+  ptr[1] = (value >> 8) & 0xff;
+  ptr[2] = (value >> 16) & 0xff;
+  ptr[3] = (value >> 24) & 0xff;
+  return ptr + 4;
+}
+/*---------------------------------------------------------------------------*/
+void
+powertrace_stream(powertrace_write_t write)
+{
+  static unsigned long last[6];
+  static uint16_t seqno;
+#if ENERGEST_CONF_MAC_STATES
+  static unsigned long last_mac[ENERGEST_MAC_MAX];
+  static unsigned long last_channel[ENERGEST_MAC_CHANNELS];
+  unsigned long t;
+  uint8_t *count;
+#endif /* ENERGEST_CONF_MAC_STATES */
+  uint8_t buf[POWERTRACE_RECORD_MAX];
+  uint8_t *ptr;
+  unsigned long now[6];
+  int i;
+
+  energest_flush();
+
+  now[0] = energest_type_time(ENERGEST_TYPE_CPU);
+  now[1] = energest_type_time(ENERGEST_TYPE_LPM);
+  now[2] = energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  now[3] = energest_type_time(ENERGEST_TYPE_LISTEN);
+  now[4] = compower_idle_activity.transmit;
+  now[5] = compower_idle_activity.listen;
+
+  ptr = buf;
+  *ptr++ = 'P';
+  ptr++; /* Record length, filled in below */
+  *ptr++ = seqno & 0xff;
+  *ptr++ = seqno >> 8;
+  ptr = put32(ptr, clock_time());
+  for(i = 0; i < 6; i++) {
+    ptr = put32(ptr, now[i] - last[i]);
+    last[i] = now[i];
+  }
+
+#if ENERGEST_CONF_MAC_STATES
+  *ptr++ = ENERGEST_MAC_MAX;
+  for(i = 0; i < ENERGEST_MAC_MAX; i++) {
+    t = energest_mac_time(i);
+    ptr = put32(ptr, t - last_mac[i]);
+    last_mac[i] = t;
+  }
+
+  /* Only the channels that have been used since the last record */
+  count = ptr++;
+  *count = 0;
+  for(i = 0; i < ENERGEST_MAC_CHANNELS; i++) {
+    t = energest_mac_channel_time(ENERGEST_MAC_CHANNEL_FIRST + i);
+    if(t != last_channel[i]) {
+      *ptr++ = ENERGEST_MAC_CHANNEL_FIRST + i;
+      ptr = put32(ptr, t - last_channel[i]);
+      last_channel[i] = t;
+      (*count)++;
+    }
+  }
+#endif /* ENERGEST_CONF_MAC_STATES */
+
+  buf[1] = ptr - buf;
+  if(write != NULL) {
+    write(buf, ptr - buf);
+  } else {
+    for(i = 0; i < ptr - buf; i++) {
+      putchar(buf[i]);
+    }
+  }
+  seqno++;
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(powertrace_process, ev, data)
 {
   static struct etimer periodic;
@@ -207,7 +288,11 @@ PROCESS_THREAD(powertrace_process, ev, data)
   while(1) {
     PROCESS_WAIT_UNTIL(etimer_expired(&periodic));
     etimer_reset(&periodic);
-    powertrace_print("");
+    if(stream_write != NULL) {
+      powertrace_stream(stream_write);
+    } else {
+      powertrace_print("");
+    }
   }
 
   PROCESS_END();
@@ -216,6 +301,14 @@ PROCESS_THREAD(powertrace_process, ev, data)
 void
 powertrace_start(clock_time_t period)
 {
+  stream_write = NULL;
+  process_start(&powertrace_process, (void *)&period);
+}
+/*---------------------------------------------------------------------------*/
+void
+powertrace_stream_start(clock_time_t period, powertrace_write_t write)
+{
+  stream_write = write;
   process_start(&powertrace_process, (void *)&period);
 }
 /*---------------------------------------------------------------------------*/
@@ -41,6 +41,7 @@
 #define POWERTRACE_H
 
 #include "sys/clock.h"
+#include "sys/energest.h"
 
 void powertrace_start(clock_time_t perioc);
 void powertrace_stop(void);
@@ -54,4 +55,26 @@ void powertrace_sniff(powertrace_onoff_t onoff);
 
 void powertrace_print(char *str);
 
+/**
+ * A function that powertrace_stream() hands each binary record to,
+ * for example a serial line or a socket writer.
+ */
+typedef void (*powertrace_write_t)(const uint8_t *data, int len);
+
+/*
+ * Binary records are little-endian: the byte 'P', the length of the
+ * whole record, a 16-bit sequence number, the 32-bit clock_time(),
+ * and the CPU, LPM, transmit, listen, idle transmit and idle listen
+ * times since the previous record as 32-bit values. With
+ * ENERGEST_CONF_MAC_STATES these are followed by the number of MAC
+ * states and the time spent in each, and then by the number of
+ * channels with radio activity and a channel number and 32-bit time
+ * for each of them. Times are in rtimer ticks.
+ */
+#define POWERTRACE_RECORD_MAX (10 + 6 * 4 + 2 + ENERGEST_MAC_MAX * 4 + \
+                               ENERGEST_MAC_CHANNELS * 5)
+
+void powertrace_stream(powertrace_write_t write);
+void powertrace_stream_start(clock_time_t period, powertrace_write_t write);
+
 #endif /* POWERTRACE_H */
@@ -58,6 +58,112 @@ PROCESS(rest_engine_process, "REST Engine");
 /*---------------------------------------------------------------------------*/
 LIST(restful_services);
 LIST(restful_periodic_services);
+#if REST_ENGINE_HASH_BUCKETS
+static resource_t *resource_buckets[REST_ENGINE_HASH_BUCKETS];
+static uint16_t activation_counter;
+#endif /* REST_ENGINE_HASH_BUCKETS */
+/*---------------------------------------------------------------------------*/
+#if REST_ENGINE_HASH_BUCKETS
+/* 16-bit FNV-1a; the running hash at a '/' is the hash of the parent path */
+#define URL_HASH_INIT 0x9dc5
+#define URL_HASH_ADD(hash, c) (((hash) ^ (uint8_t)(c)) * 0x0193)
+/*---------------------------------------------------------------------------*/
+static void
+hash_remove(resource_t *resource)
+{
+  resource_t **r;
+
+  for(r = &resource_buckets[resource->url_hash % REST_ENGINE_HASH_BUCKETS];
+      *r != NULL; r = &(*r)->hash_next) {
+    if(*r == resource) {
+      *r = resource->hash_next;
+      break;
+    }
+  }
+  resource->hash_next = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_add(resource_t *resource)
+{
+  const char *c;
+  uint16_t hash;
+  resource_t **bucket;
+
+  hash = URL_HASH_INIT;
+  for(c = resource->url; *c != '\0'; c++) {
+    hash = URL_HASH_ADD(hash, *c);
+  }
+  resource->url_hash = hash;
+  resource->url_len = c - resource->url;
+  resource->order = activation_counter++;
+
+  bucket = &resource_buckets[hash % REST_ENGINE_HASH_BUCKETS];
+  resource->hash_next = *bucket;
+  *bucket = resource;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Finds the resource for a request path: either the resource with that
+ * exact path, or a HAS_SUB_RESOURCES resource whose path is followed by
+ * a '/' in the request path. As with a linear scan of restful_services,
+ * the earliest activated resource wins when several match.
+ */
+static resource_t *
+hash_lookup(const char *url, int url_len)
+{
+  resource_t *best;
+  resource_t *r;
+  uint16_t hash;
+  int len;
+
+  best = NULL;
+  hash = URL_HASH_INIT;
+  for(len = 0; len <= url_len; len++) {
+    if(len == url_len || url[len] == '/') {
+      for(r = resource_buckets[hash % REST_ENGINE_HASH_BUCKETS];
+          r != NULL; r = r->hash_next) {
+        if(r->url_hash == hash && r->url_len == len
+           && (len == url_len || (r->flags & HAS_SUB_RESOURCES))
+           && (best == NULL || r->order < best->order)
+           && strncmp(r->url, url, len) == 0) {
+          best = r;
+        }
+      }
+    }
+    if(len < url_len) {
+      hash = URL_HASH_ADD(hash, url[len]);
+    }
+  }
+  return best;
+}
+#endif /* REST_ENGINE_HASH_BUCKETS */
+/*---------------------------------------------------------------------------*/
+static resource_t *
+find_resource(const char *url, int url_len)
+{
+#if REST_ENGINE_HASH_BUCKETS
+  return hash_lookup(url, url_len);
+#else /* REST_ENGINE_HASH_BUCKETS */
+  resource_t *resource;
+  int res_url_len;
+
+  for(resource = (resource_t *)list_head(restful_services);
+      resource; resource = resource->next) {
+
+    /* if the web service handles that kind of requests and urls matches */
+    res_url_len = strlen(resource->url);
+    if((url_len == res_url_len
+        || (url_len > res_url_len
+            && (resource->flags & HAS_SUB_RESOURCES)
+            && url[res_url_len] == '/'))
+       && strncmp(resource->url, url, res_url_len) == 0) {
+      return resource;
+    }
+  }
+  return NULL;
+#endif /* REST_ENGINE_HASH_BUCKETS */
+}
 /*---------------------------------------------------------------------------*/
 /*- REST Engine API ---------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -104,6 +210,11 @@ rest_activate_resource(resource_t *resource, char *path)
 {
   resource->url = path;
   list_add(restful_services, resource);
+#if REST_ENGINE_HASH_BUCKETS
+  /* re-activation moves the resource to the end, as list_add() does */
+  hash_remove(resource);
+  hash_add(resource);
+#endif /* REST_ENGINE_HASH_BUCKETS */
 
   PRINTF("Activating: %s\n", resource->url);
 
@@ -141,44 +252,34 @@ rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
 
   resource_t *resource = NULL;
   const char *url = NULL;
-  int url_len, res_url_len;
+  int url_len;
 
   url_len = REST.get_url(request, &url);
-  for(resource = (resource_t *)list_head(restful_services);
-      resource; resource = resource->next) {
+  resource = find_resource(url, url_len);
+  if(resource != NULL) {
+    found = 1;
+    rest_resource_flags_t method = REST.get_method_type(request);
 
-    /* if the web service handles that kind of requests and urls matches */
-    res_url_len = strlen(resource->url);
-    if((url_len == res_url_len
-        || (url_len > res_url_len
-            && (resource->flags & HAS_SUB_RESOURCES)
-            && url[res_url_len] == '/'))
-       && strncmp(resource->url, url, res_url_len) == 0) {
-      found = 1;
-      rest_resource_flags_t method = REST.get_method_type(request);
-
-      PRINTF("/%s, method %u, resource->flags %u\n", resource->url,
-             (uint16_t)method, resource->flags);
-
-      if((method & METHOD_GET) && resource->get_handler != NULL) {
-        /* call handler function */
-        resource->get_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_POST) && resource->post_handler != NULL) {
-        /* call handler function */
-        resource->post_handler(request, response, buffer, buffer_size,
+    PRINTF("/%s, method %u, resource->flags %u\n", resource->url,
+           (uint16_t)method, resource->flags);
+
+    if((method & METHOD_GET) && resource->get_handler != NULL) {
+      /* call handler function */
+      resource->get_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_POST) && resource->post_handler != NULL) {
+      /* call handler function */
+      resource->post_handler(request, response, buffer, buffer_size,
+                             offset);
+    } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
+      /* call handler function */
+      resource->put_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
+      /* call handler function */
+      resource->delete_handler(request, response, buffer, buffer_size,
                                offset);
-      } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
-        /* call handler function */
-        resource->put_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
-        /* call handler function */
-        resource->delete_handler(request, response, buffer, buffer_size,
-                                 offset);
-      } else {
-        allowed = 0;
-        REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
-      }
-      break;
+    } else {
+      allowed = 0;
+      REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
     }
   }
   if(!found) {
@@ -62,6 +62,19 @@
 #define REST_MAX_CHUNK_SIZE     64
 #endif
 
+/*
+ * Number of hash buckets used to dispatch requests to resources. Each
+ * activated resource is indexed by a hash of its URI path, so that a
+ * request only compares the paths that share a bucket with the request
+ * path or one of its parent paths. Set to 0 to match requests against
+ * every resource in activation order instead.
+ */
+#ifdef REST_ENGINE_CONF_HASH_BUCKETS
+#define REST_ENGINE_HASH_BUCKETS REST_ENGINE_CONF_HASH_BUCKETS
+#else
+#define REST_ENGINE_HASH_BUCKETS 16
+#endif
+
 struct resource_s;
 struct periodic_resource_s;
 
@@ -95,6 +108,13 @@ struct resource_s {
     restful_trigger_handler trigger;
     restful_trigger_handler resume;
   };
+#if REST_ENGINE_HASH_BUCKETS
+  /* set by rest_activate_resource() */
+  struct resource_s *hash_next;   /* next resource in the same bucket */
+  uint16_t url_hash;
+  uint16_t url_len;
+  uint16_t order;                 /* activation order, for precedence */
+#endif
 };
 typedef struct resource_s resource_t;
 
@@ -55,16 +55,30 @@ int snprintf(char *str, size_t size, const char *format, ...);
 
 #define CONTINUE_EVENT 128
 
+/* Round-trip times are kept in a log-linear histogram of
+   milliseconds: one bucket for each of 0-3 ms, then four buckets for
+   each power of two up to 65535 ms. */
+#define RTT_BUCKETS 60
+
 struct power {
   unsigned long lpm, cpu, rx, tx;
 };
 
+/* Packets dropped below the application, taken from rimestats:
+   incoming packets the radio rejected, outgoing packets the MAC
+   layer gave up on, and Rime reliable transmissions that timed out.
+   The counters stay at zero unless RIMESTATS_CONF_ENABLED is set. */
+struct drops {
+  uint16_t radio, mac, rime;
+};
+
 struct stats {
   uint16_t sent, received, timedout;
   unsigned long total_tx_latency;
   unsigned long total_rx_latency;
   clock_time_t start, end;
   struct power power0, power;
+  struct drops drops;
 };
 
 
@@ -78,6 +92,7 @@ enum {
 struct datapath_msg {
   linkaddr_t receiver;
   rtimer_clock_t tx, rx;
+  rtimer_clock_t echo; /* Sender's local time, returned in the reply */
   uint8_t datapath_command;
   uint8_t received;
 };
@@ -104,6 +119,10 @@ static uint8_t is_sender;
 static int left_to_send;
 
 static struct stats stats;
+static struct drops drops0;
+
+static uint16_t rtt_histogram[RTT_BUCKETS];
+static uint16_t rtt_count;
 
 enum {
   TYPE_NONE             = 0,
@@ -115,6 +134,18 @@ enum {
 
 static uint8_t current_type;
 
+static const char *const type_names[] = {
+  "none", "broadcast", "unicast", "pingpong", "stream"
+};
+
+/* The traffic profile: payload length, packets per second (0 sends
+   as fast as possible) and the number of packets sent back-to-back
+   before waiting for the next period. */
+static uint16_t datalen;
+static uint16_t rate;
+static uint16_t burst;
+static uint8_t print_csv;
+
 /*---------------------------------------------------------------------------*/
 PROCESS(shell_netperf_process, "netperf");
 SHELL_COMMAND(netperf_command,
@@ -140,11 +171,104 @@ memcpy_misaligned(void *dest, const void *source, int len)
   }
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t
+rtt_bucket(uint16_t ms)
+{
+  uint8_t shift;
+
+  if(ms < 4) {
+    return ms;
+  }
+  for(shift = 0; (ms >> (shift + 3)) != 0; ++shift);
+  return 4 + shift * 4 + ((ms >> shift) & 3);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+rtt_bucket_max(uint8_t bucket)
+{
+  uint8_t shift;
+
+  if(bucket < 4) {
+    return bucket;
+  }
+  shift = (bucket - 4) / 4;
+  return ((4U + (bucket & 3)) << shift) + (1U << shift) - 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rtt_add(rtimer_clock_t ticks)
+{
+  unsigned long ms;
+
+  ms = (1000UL * ticks) / RTIMER_ARCH_SECOND;
+  if(ms > 0xffff) {
+    ms = 0xffff;
+  }
+  rtt_histogram[rtt_bucket(ms)]++;
+  rtt_count++;
+}
+/*---------------------------------------------------------------------------*/
+/* Return the p:th percentile round-trip time in milliseconds. The
+   value is the upper bound of the bucket holding the percentile. */
+static uint16_t
+rtt_percentile(uint8_t p)
+{
+  unsigned long target, count;
+  uint8_t i;
+
+  target = ((unsigned long)rtt_count * p + 99) / 100;
+  count = 0;
+  for(i = 0; i < RTT_BUCKETS - 1; ++i) {
+    count += rtt_histogram[i];
+    if(count >= target) {
+      break;
+    }
+  }
+  return rtt_bucket_max(i);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_csv_header(void)
+{
+  printf("netperf,type,side,len,rate,burst,sent,received,timedout,time_ms,"
+         "rtt_p50_ms,rtt_p95_ms,rtt_p99_ms,drop_radio,drop_mac,drop_rime\n");
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_csv_row(struct stats *s, uint8_t remote)
+{
+  printf("netperf,%s,%s,%u,%u,%u,%u,%u,%u,%lu,",
+         type_names[current_type], remote ? "remote" : "local",
+         datalen, rate, burst,
+         s->sent, s->received, s->timedout,
+         (1000UL * (clock_time_t)(s->end - s->start)) / CLOCK_SECOND);
+  /* Round-trip times are only measured by the sender */
+  if(!remote && rtt_count > 0) {
+    printf("%u,%u,%u,", rtt_percentile(50), rtt_percentile(95),
+           rtt_percentile(99));
+  } else {
+    printf(",,,");
+  }
+  printf("%u,%u,%u\n", s->drops.radio, s->drops.mac, s->drops.rime);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_drops(struct drops *d)
+{
+  printf("  Dropped below application: radio %u mac %u rime %u\n",
+         d->radio, d->mac, d->rime);
+}
+/*---------------------------------------------------------------------------*/
 static void
 print_remote_stats(struct stats *s)
 {
   unsigned long total_time;
-  
+
+  if(print_csv) {
+    print_csv_row(s, 1);
+    return;
+  }
+
   printf("%d 1 %d %d %d %lu %lu %lu %lu %lu %lu %lu # for automatic processing\n",
 	 current_type,
 	 s->sent, s->received, s->timedout,
@@ -157,21 +281,29 @@ print_remote_stats(struct stats *s)
 
   printf("Remote node statistics:\n");
   total_time = s->power.cpu + s->power.lpm - s->power0.cpu - s->power0.lpm;
-  printf("  Remote radio duty cycle:   rx %lu.%02lu%% tx %lu.%02lu%%\n",
-	 (100 * (s->power.rx - s->power0.rx))/total_time,
-	 ((10000 * (s->power.rx - s->power0.rx))/total_time) % 100,
-	 (100 * (s->power.tx - s->power0.tx))/total_time,
-	 ((10000 * (s->power.tx - s->power0.tx))/total_time) % 100);
+  if(total_time > 0) {
+    printf("  Remote radio duty cycle:   rx %lu.%02lu%% tx %lu.%02lu%%\n",
+	   (100 * (s->power.rx - s->power0.rx))/total_time,
+	   ((10000 * (s->power.rx - s->power0.rx))/total_time) % 100,
+	   (100 * (s->power.tx - s->power0.tx))/total_time,
+	   ((10000 * (s->power.tx - s->power0.tx))/total_time) % 100);
+  }
 
   printf("  Packets:                   sent %d received %d\n",
 	 s->sent, s->received);
+  print_drops(&s->drops);
 }
 /*---------------------------------------------------------------------------*/
 static void
 print_local_stats(struct stats *s)
 {
   unsigned long total_time;
-  
+
+  if(print_csv) {
+    print_csv_row(s, 0);
+    return;
+  }
+
   printf("%d 0 %d %d %d %lu %lu %lu %lu %lu %lu %lu # for automatic processing\n",
 	 current_type, 
 	 s->sent, s->received, s->timedout,
@@ -183,32 +315,45 @@ print_local_stats(struct stats *s)
 	 s->power.tx - s->power0.tx);
 
   printf("Local node statistics:\n");
- 
-  printf("  Total transfer time:       %lu.%02lu seconds, %lu.%02lu packets/second\n",
-	 (s->end - s->start) / CLOCK_SECOND,
-	 ((10 * (s->end - s->start)) / CLOCK_SECOND) % 10,
-	 ((1UL * CLOCK_SECOND * s->sent) / (s->end - s->start)),
-	 (((100UL * CLOCK_SECOND * s->sent) / (s->end - s->start)) % 100));
- 
-  printf("  Average round-trip-time:   %lu ms (%lu + %lu)\n",
-	 (1000 * (s->total_rx_latency + s->total_tx_latency) / s->received) /
-	 RTIMER_ARCH_SECOND,
-	 (1000 * (s->total_tx_latency) / s->received) /
-	 RTIMER_ARCH_SECOND,
-	 (1000 * (s->total_rx_latency) / s->received) /
-	 RTIMER_ARCH_SECOND);
-  
+
+  if(s->end != s->start) {
+    printf("  Total transfer time:       %lu.%02lu seconds, %lu.%02lu packets/second\n",
+	   (s->end - s->start) / CLOCK_SECOND,
+	   ((10 * (s->end - s->start)) / CLOCK_SECOND) % 10,
+	   ((1UL * CLOCK_SECOND * s->sent) / (s->end - s->start)),
+	   (((100UL * CLOCK_SECOND * s->sent) / (s->end - s->start)) % 100));
+  }
+
+  if(s->received > 0) {
+    printf("  Average round-trip-time:   %lu ms (%lu + %lu)\n",
+	   (1000 * (s->total_rx_latency + s->total_tx_latency) / s->received) /
+	   RTIMER_ARCH_SECOND,
+	   (1000 * (s->total_tx_latency) / s->received) /
+	   RTIMER_ARCH_SECOND,
+	   (1000 * (s->total_rx_latency) / s->received) /
+	   RTIMER_ARCH_SECOND);
+  }
+  if(rtt_count > 0) {
+    printf("  Round-trip-time:           p50 %u ms p95 %u ms p99 %u ms\n",
+	   rtt_percentile(50), rtt_percentile(95), rtt_percentile(99));
+  }
+
   total_time = s->power.cpu + s->power.lpm - s->power0.cpu - s->power0.lpm;
-  printf("  Radio duty cycle:          rx %lu.%02lu%% tx %lu.%02lu%%\n",
-	 (100 * (s->power.rx - s->power0.rx))/total_time,
-	 ((10000 * (s->power.rx - s->power0.rx))/total_time) % 100,
-	 (100 * (s->power.tx - s->power0.tx))/total_time,
-	 ((10000 * (s->power.tx - s->power0.tx))/total_time) % 100);
+  if(total_time > 0) {
+    printf("  Radio duty cycle:          rx %lu.%02lu%% tx %lu.%02lu%%\n",
+	   (100 * (s->power.rx - s->power0.rx))/total_time,
+	   ((10000 * (s->power.rx - s->power0.rx))/total_time) % 100,
+	   (100 * (s->power.tx - s->power0.tx))/total_time,
+	   ((10000 * (s->power.tx - s->power0.tx))/total_time) % 100);
+  }
 
-  printf("  Packets received:          %d.%lu%%, %d of %d\n",
-	 100 * s->received / s->sent,
-	 (10000L * s->received / s->sent) % 10,
-	 s->received, s->sent);
+  if(s->sent > 0) {
+    printf("  Packets received:          %d.%lu%%, %d of %d\n",
+	   100 * s->received / s->sent,
+	   (10000L * s->received / s->sent) % 10,
+	   s->received, s->sent);
+  }
+  print_drops(&s->drops);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -222,11 +367,24 @@ sample_power_profile(struct power *p)
 }
 /*---------------------------------------------------------------------------*/
 static void
+sample_drops(struct drops *d)
+{
+  d->radio = RIMESTATS_GET(badcrc) + RIMESTATS_GET(badsynch) +
+    RIMESTATS_GET(toolong) + RIMESTATS_GET(tooshort);
+  d->mac = RIMESTATS_GET(contentiondrop) + RIMESTATS_GET(sendingdrop) +
+    RIMESTATS_GET(noacktx);
+  d->rime = RIMESTATS_GET(timedout);
+}
+/*---------------------------------------------------------------------------*/
+static void
 clear_stats(void)
 {
   memset(&stats, 0, sizeof(stats));
+  memset(rtt_histogram, 0, sizeof(rtt_histogram));
+  rtt_count = 0;
   stats.start = clock_time();
   sample_power_profile(&stats.power0);
+  sample_drops(&drops0);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -241,8 +399,14 @@ setup_sending(linkaddr_t *to, int num)
 static void
 finalize_stats(struct stats *s)
 {
-  stats.end = clock_time();
-  sample_power_profile(&stats.power);
+  struct drops d;
+
+  s->end = clock_time();
+  sample_power_profile(&s->power);
+  sample_drops(&d);
+  s->drops.radio = d.radio - drops0.radio;
+  s->drops.mac = d.mac - drops0.mac;
+  s->drops.rime = d.rime - drops0.rime;
 }
 /*---------------------------------------------------------------------------*/
 static unsigned long filesize, bytecount, packetsize;
@@ -282,7 +446,7 @@ construct_next_packet(void)
   struct datapath_msg *msg;
   packetbuf_clear();
   if(left_to_send > 0) {
-    packetbuf_set_datalen(DATALEN);
+    packetbuf_set_datalen(datalen);
     msg = packetbuf_dataptr();
     msg->datapath_command = DATAPATH_COMMAND_NONE;
     msg->received = 0;
@@ -291,6 +455,7 @@ construct_next_packet(void)
 #else /* TIMESYNCH_CONF_ENABLED */
     msg->tx = msg->rx = 0;
 #endif /* TIMESYNCH_CONF_ENABLED */
+    msg->echo = RTIMER_NOW();
     linkaddr_copy(&msg->receiver, &receiver);
     left_to_send--;
     return 1;
@@ -341,6 +506,9 @@ process_incoming_packet(void)
   stats.received++;
   stats.total_tx_latency += msg_copy.rx - msg_copy.tx;
   stats.total_rx_latency += now - msg_copy.rx;
+  if(is_sender && msg_copy.datapath_command == DATAPATH_COMMAND_ECHO_REPLY) {
+    rtt_add((rtimer_clock_t)(RTIMER_NOW() - msg_copy.echo));
+  }
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -488,11 +656,43 @@ recv_unicast(struct unicast_conn *c, const linkaddr_t *from)
 const static struct unicast_callbacks unicast_callbacks =
   { recv_unicast };
 /*---------------------------------------------------------------------------*/
+static int
+send_next_packet(void)
+{
+  switch(current_type) {
+  case TYPE_BROADCAST:
+    if(construct_next_packet()) {
+      broadcast_send(&broadcast);
+      return 1;
+    }
+    break;
+  case TYPE_UNICAST:
+    if(construct_next_packet()) {
+      unicast_send(&unicast, &receiver);
+      return 1;
+    }
+    break;
+  case TYPE_UNICAST_PINGPONG:
+    if(construct_next_echo()) {
+      unicast_send(&unicast, &receiver);
+      return 1;
+    }
+    break;
+  case TYPE_UNICAST_STREAM:
+    if(construct_next_stream_echo()) {
+      unicast_send(&unicast, &receiver);
+      return 1;
+    }
+    break;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 static void
 print_usage(void)
 {
   shell_output_str(&netperf_command,
-		   "netperf [-b|u|p|s] <receiver> <num packets>: perform network measurements to receiver", "");
+		   "netperf [-b|u|p|s|c] [-l <len>] [-r <rate>] [-n <burst>] <receiver> <num packets>: perform network measurements to receiver", "");
   shell_output_str(&netperf_command,
 		   "        -b measure broadcast performance", "");
   shell_output_str(&netperf_command,
@@ -501,6 +701,22 @@ print_usage(void)
 		   "        -p measure ping-pong unicast performance", "");
   shell_output_str(&netperf_command,
 		   "        -s measure ping-pong stream unicast performance", "");
+  shell_output_str(&netperf_command,
+		   "        -c print the results as CSV", "");
+  shell_output_str(&netperf_command,
+		   "        -l payload length in bytes", "");
+  shell_output_str(&netperf_command,
+		   "        -r packets per second (default: as fast as possible)", "");
+  shell_output_str(&netperf_command,
+		   "        -n packets sent back-to-back per period (default: 1)", "");
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_progress(char *str1, const char *str2)
+{
+  if(!print_csv) {
+    shell_output_str(&netperf_command, str1, str2);
+  }
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -516,39 +732,83 @@ shell_netperf_init(void)
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(shell_netperf_process, ev, data)
 {
-  static struct etimer e;
+  static struct etimer e, period;
   static linkaddr_t receiver;
   const char *nextptr;
   const char *args;
   static char recvstr[40];
   static int i, num_packets;
-  static uint8_t do_broadcast, do_unicast, do_pingpong, do_stream_pingpong;
+  static uint8_t types;
+  static char *const headings[] = {
+    NULL,
+    "-------- Broadcast --------",
+    "-------- Unicast one-way --------",
+    "-------- Unicast ping-pong--------",
+    "-------- Unicast stream ping-pong--------"
+  };
+  static char *const measuring[] = {
+    NULL,
+    "Measuring broadcast performance to ",
+    "Measuring unicast performance to ",
+    "Measuring two-way unicast performance to ",
+    "Measuring two-way unicast stream performance to "
+  };
+  char option;
+  unsigned long value;
 
   PROCESS_BEGIN();
 
   current_type = TYPE_NONE;
-  
-  do_broadcast = do_unicast = do_pingpong =
-    do_stream_pingpong = 0;
-  
+
+  types = 0;
+  datalen = DATALEN;
+  rate = 0;
+  burst = 1;
+  print_csv = 0;
+
   args = data;
 
-  /* Parse the -bups options */
+  /* Parse the -bupsc options and the -l, -r and -n values */
   while(*args == '-') {
     ++args;
     while(*args != ' ' &&
 	  *args != 0) {
       if(*args == 'b') {
-	do_broadcast = 1;
+	types |= 1 << TYPE_BROADCAST;
       }
       if(*args == 'u') {
-	do_unicast = 1;
+	types |= 1 << TYPE_UNICAST;
       }
       if(*args == 'p') {
-	do_pingpong = 1;
+	types |= 1 << TYPE_UNICAST_PINGPONG;
       }
       if(*args == 's') {
-	do_stream_pingpong = 1;
+	types |= 1 << TYPE_UNICAST_STREAM;
+      }
+      if(*args == 'c') {
+	print_csv = 1;
+      }
+      if(*args == 'l' || *args == 'r' || *args == 'n') {
+	option = *args;
+	value = shell_strtolong(args + 1, &nextptr);
+	if(nextptr == args + 1) {
+	  print_usage();
+	  PROCESS_EXIT();
+	}
+	if(option == 'l') {
+	  if(value < sizeof(struct datapath_msg)) {
+	    value = sizeof(struct datapath_msg);
+	  } else if(value > PACKETBUF_SIZE) {
+	    value = PACKETBUF_SIZE;
+	  }
+	  datalen = value;
+	} else if(option == 'r') {
+	  rate = value;
+	} else if(value > 0) {
+	  burst = value;
+	}
+	args = nextptr;
+	break;
       }
       ++args;
     }
@@ -559,7 +819,7 @@ PROCESS_THREAD(shell_netperf_process, ev, data)
 
   /* Parse the receiver address */
   receiver.u8[0] = shell_strtolong(args, &nextptr);
-  if(nextptr == data || *nextptr != '.') {
+  if(nextptr == args || *nextptr != '.') {
     print_usage();
     PROCESS_EXIT();
   }
@@ -577,151 +837,69 @@ PROCESS_THREAD(shell_netperf_process, ev, data)
     ++args;
   }
   num_packets = shell_strtolong(args, &nextptr);  
-  if(nextptr == data || num_packets == 0) {
+  if(nextptr == args || num_packets == 0) {
     print_usage();
     PROCESS_EXIT();
   }
 
-  /* Send broadcast packets, if requested */
-  if(do_broadcast) {
-    current_type = TYPE_BROADCAST;
-    shell_output_str(&netperf_command, "-------- Broadcast --------", "");
-    
-    shell_output_str(&netperf_command, "Contacting ", recvstr);
-    while(!send_ctrl_command(&receiver, CTRL_COMMAND_CLEAR)) {
-      PROCESS_PAUSE();
-    }
-    PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    shell_output_str(&netperf_command, "Measuring broadcast performance to ", recvstr);
-    
-    setup_sending(&receiver, num_packets);
-    for(i = 0; i < num_packets; ++i) {
-      if(construct_next_packet()) {
-	broadcast_send(&broadcast);
-	stats.sent++;
-      }
-      PROCESS_PAUSE();
-    }
-    
-    shell_output_str(&netperf_command, "Requesting statistics from ", recvstr);
-    while(!send_ctrl_command(&receiver, CTRL_COMMAND_STATS)) {
-      PROCESS_PAUSE();
-    }
-    PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    /* Wait for reply */
-    PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    finalize_stats(&stats);
-    print_local_stats(&stats);
+  if(print_csv) {
+    print_csv_header();
   }
 
-  if(do_unicast) {
-    current_type = TYPE_UNICAST;
-    shell_output_str(&netperf_command, "-------- Unicast one-way --------", "");
-    
-    shell_output_str(&netperf_command, "Contacting ", recvstr);
-    while(!send_ctrl_command(&receiver, CTRL_COMMAND_CLEAR)) {
-      PROCESS_PAUSE();
-    }
-    PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    shell_output_str(&netperf_command, "Measuring unicast performance to ", recvstr);
-    
-    setup_sending(&receiver, num_packets);
-    
-    for(i = 0; i < num_packets; ++i) {
-      if(construct_next_packet()) {
-	unicast_send(&unicast, &receiver);
-	stats.sent++;
-      }
-      PROCESS_PAUSE();
-    }
-    
-    shell_output_str(&netperf_command, "Requesting statistics from ", recvstr);
-    while(!send_ctrl_command(&receiver, CTRL_COMMAND_STATS)) {
-      PROCESS_PAUSE();
+  for(current_type = TYPE_BROADCAST; current_type <= TYPE_UNICAST_STREAM;
+      current_type++) {
+    if((types & (1 << current_type)) == 0) {
+      continue;
     }
-    PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    /* Wait for reply */
-    PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    finalize_stats(&stats);
-    print_local_stats(&stats);
-  }
-  if(do_pingpong) {
-    current_type = TYPE_UNICAST_PINGPONG;
-    shell_output_str(&netperf_command, "-------- Unicast ping-pong--------", "");
-    
-    shell_output_str(&netperf_command, "Contacting ", recvstr);
+    print_progress(headings[current_type], "");
+
+    print_progress("Contacting ", recvstr);
     while(!send_ctrl_command(&receiver, CTRL_COMMAND_CLEAR)) {
       PROCESS_PAUSE();
     }
     PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    shell_output_str(&netperf_command, "Measuring two-way unicast performance to ", recvstr);
-    
+
+    print_progress(measuring[current_type], recvstr);
+
     setup_sending(&receiver, num_packets);
-    
-    for(i = 0; i < num_packets; ++i) {
-      if(construct_next_echo()) {
-        
-	unicast_send(&unicast, &receiver);
-	stats.sent++;
-      }
-      etimer_set(&e, CLOCK_SECOND);
-      PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT || etimer_expired(&e));
-    }
-    
-    shell_output_str(&netperf_command, "Requesting statistics from ", recvstr);
-    while(!send_ctrl_command(&receiver, CTRL_COMMAND_STATS)) {
-      PROCESS_PAUSE();
-    }
-    PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    /* Wait for reply */
-    PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    finalize_stats(&stats);
-    print_local_stats(&stats);
-  }
-  if(do_stream_pingpong) {
-    current_type = TYPE_UNICAST_STREAM;
-    shell_output_str(&netperf_command, "-------- Unicast stream ping-pong--------", "");
-    
-    shell_output_str(&netperf_command, "Contacting ", recvstr);
-    while(!send_ctrl_command(&receiver, CTRL_COMMAND_CLEAR)) {
-      PROCESS_PAUSE();
+
+    /* Each period sends a burst of packets. The period timer is reset
+       rather than restarted so that slow round-trips do not lower the
+       average rate. */
+    if(rate > 0) {
+      value = ((unsigned long)burst * CLOCK_SECOND) / rate;
+      etimer_set(&period, value > 0 ? value : 1);
     }
-    PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
-    shell_output_str(&netperf_command, "Measuring two-way unicast stream performance to ", recvstr);
-    
-    setup_sending(&receiver, num_packets);
-    
+
     for(i = 0; i < num_packets; ++i) {
-      if(construct_next_stream_echo()) {
-	unicast_send(&unicast, &receiver);
+      if(send_next_packet()) {
 	stats.sent++;
       }
-      etimer_set(&e, CLOCK_SECOND);
-      PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT || etimer_expired(&e));
+      if(current_type == TYPE_UNICAST_PINGPONG ||
+	 current_type == TYPE_UNICAST_STREAM) {
+	etimer_set(&e, CLOCK_SECOND);
+	PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT || etimer_expired(&e));
+      } else {
+	PROCESS_PAUSE();
+      }
+      if(rate > 0 && (i + 1) % burst == 0) {
+	PROCESS_WAIT_UNTIL(etimer_expired(&period));
+	etimer_reset(&period);
+      }
     }
-    
-    shell_output_str(&netperf_command, "Requesting statistics from ", recvstr);
+    etimer_stop(&period);
+
+    print_progress("Requesting statistics from ", recvstr);
     while(!send_ctrl_command(&receiver, CTRL_COMMAND_STATS)) {
       PROCESS_PAUSE();
     }
     PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
+
     /* Wait for reply */
     PROCESS_YIELD_UNTIL(ev == CONTINUE_EVENT);
-    
+
     finalize_stats(&stats);
     print_local_stats(&stats);
-    
   }
 
   shell_output_str(&netperf_command, "Done", "");
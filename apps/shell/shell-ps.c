@@ -49,6 +49,13 @@ SHELL_COMMAND(ps_command,
 	      "ps",
 	      "ps: list all running processes",
 	      &shell_ps_process);
+#if PROCESS_CONF_PROFILE
+PROCESS(shell_top_process, "top");
+SHELL_COMMAND(top_command,
+	      "top",
+	      "top [-br]: show process run times (-b binary, -r reset)",
+	      &shell_top_process);
+#endif /* PROCESS_CONF_PROFILE */
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(shell_ps_process, ev, data)
 {
@@ -65,9 +72,69 @@ PROCESS_THREAD(shell_ps_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_PROFILE
+PROCESS_THREAD(shell_top_process, ev, data)
+{
+  struct process *p;
+  const char *args;
+  char buf[80];
+  static uint8_t dump[256];
+  uint8_t binary, reset;
+  int len;
+
+  PROCESS_BEGIN();
+
+  binary = reset = 0;
+  args = data;
+  while(*args == '-') {
+    ++args;
+    while(*args != ' ' && *args != 0) {
+      if(*args == 'b') {
+	binary = 1;
+      }
+      if(*args == 'r') {
+	reset = 1;
+      }
+      ++args;
+    }
+    while(*args == ' ') {
+      args++;
+    }
+  }
+
+  if(binary) {
+    len = process_profile_dump(dump, sizeof(dump));
+    shell_output(&top_command, dump, len, "", 0);
+  } else {
+    snprintf(buf, sizeof(buf), "calls time max events wait max (%lu ticks/s)",
+	     (unsigned long)RTIMER_SECOND);
+    shell_output_str(&top_command, buf, "");
+    for(p = PROCESS_LIST(); p != NULL; p = p->next) {
+      snprintf(buf, sizeof(buf), "%lu %lu %lu %lu %lu %lu ",
+	       (unsigned long)p->profile.calls,
+	       (unsigned long)p->profile.time,
+	       (unsigned long)p->profile.max_time,
+	       (unsigned long)p->profile.events,
+	       (unsigned long)p->profile.wait,
+	       (unsigned long)p->profile.max_wait);
+      shell_output_str(&top_command, buf, PROCESS_NAME_STRING(p));
+    }
+  }
+
+  if(reset) {
+    process_profile_reset();
+  }
+
+  PROCESS_END();
+}
+#endif /* PROCESS_CONF_PROFILE */
+/*---------------------------------------------------------------------------*/
 void
 shell_ps_init(void)
 {
   shell_register_command(&ps_command);
+#if PROCESS_CONF_PROFILE
+  shell_register_command(&top_command);
+#endif /* PROCESS_CONF_PROFILE */
 }
 /*---------------------------------------------------------------------------*/
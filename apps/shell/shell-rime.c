@@ -106,6 +106,11 @@ SHELL_COMMAND(routes_command,
 	      "routes",
 	      "routes: dump route list in binary format",
 	      &shell_routes_process);
+PROCESS(shell_routestats_process, "routestats");
+SHELL_COMMAND(routestats_command,
+	      "routestats",
+	      "routestats: print route table statistics",
+	      &shell_routestats_process);
 PROCESS(shell_packetize_process, "packetize");
 SHELL_COMMAND(packetize_command,
 	      "packetize",
@@ -210,6 +215,22 @@ PROCESS_THREAD(shell_routes_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_routestats_process, ev, data)
+{
+  char buf[80];
+  const struct route_stats *s;
+
+  PROCESS_BEGIN();
+
+  s = route_get_stats();
+  snprintf(buf, sizeof(buf),
+           "routes %d hits %lu misses %lu evictions %lu expired %lu",
+           route_num(), s->hits, s->misses, s->evictions, s->expirations);
+  shell_output_str(&routestats_command, buf, "");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
 #if WITH_TREEDEPTH
 PROCESS_THREAD(shell_treedepth_process, ev, data)
 {
@@ -349,6 +370,7 @@ shell_rime_init(void)
   shell_register_command(&mac_command);
   shell_register_command(&packetize_command);
   shell_register_command(&routes_command);
+  shell_register_command(&routestats_command);
   shell_register_command(&send_command);
 
 #if WITH_TREEDEPTH
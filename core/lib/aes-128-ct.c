@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2017, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Constant-time AES-128 encryption.
+ *
+ *         The S-box is not a table lookup but computed on a
+ *         bitsliced state: the 16 state bytes are transposed into
+ *         eight 16-bit bit planes, the GF(2^8) inverse is computed
+ *         as x^254 with AND/XOR-only multiplications (squarings are
+ *         linear and need no ANDs), and the affine transform is
+ *         applied plane-wise. Neither the timing nor the memory
+ *         access pattern of encrypt() depends on the key or the
+ *         data, at the price of being considerably slower than the
+ *         table-driven implementations.
+ *
+ *         Select it with
+ *         \code #define AES_128_CONF aes_128_ct_driver \endcode
+ */
+
+#include "lib/aes-128.h"
+#include <string.h>
+
+static uint8_t round_keys[11][AES_128_KEY_LENGTH];
+
+/*---------------------------------------------------------------------------*/
+/* multiplies by 2 in GF(2^8) without branching */
+static uint8_t
+galois_mul2(uint8_t value)
+{
+  return (value << 1) ^ ((-(value >> 7)) & 0x1b);
+}
+/*---------------------------------------------------------------------------*/
+/* r = a * b on bitsliced operands, modulo x^8 + x^4 + x^3 + x + 1 */
+static void
+gf_mul(uint16_t *r, const uint16_t *a, const uint16_t *b)
+{
+  uint16_t p[15];
+  uint8_t i;
+  uint8_t j;
+
+  memset(p, 0, sizeof(p));
+  for(i = 0; i < 8; i++) {
+    for(j = 0; j < 8; j++) {
+      p[i + j] ^= a[i] & b[j];
+    }
+  }
+  for(i = 14; i >= 8; i--) {
+    p[i - 4] ^= p[i];
+    p[i - 5] ^= p[i];
+    p[i - 7] ^= p[i];
+    p[i - 8] ^= p[i];
+  }
+  memcpy(r, p, 8 * sizeof(uint16_t));
+}
+/*---------------------------------------------------------------------------*/
+/* r = a^2; squaring is linear in GF(2^8), so it needs no ANDs */
+static void
+gf_sq(uint16_t *r, const uint16_t *a)
+{
+  uint16_t p[15];
+  uint8_t i;
+
+  memset(p, 0, sizeof(p));
+  for(i = 0; i < 8; i++) {
+    p[2 * i] = a[i];
+  }
+  for(i = 14; i >= 8; i--) {
+    p[i - 4] ^= p[i];
+    p[i - 5] ^= p[i];
+    p[i - 7] ^= p[i];
+    p[i - 8] ^= p[i];
+  }
+  memcpy(r, p, 8 * sizeof(uint16_t));
+}
+/*---------------------------------------------------------------------------*/
+/* applies the S-box to len <= 16 bytes */
+static void
+sub_bytes(uint8_t *s, uint8_t len)
+{
+  uint16_t x[8], x2[8], x3[8], x12[8], x15[8], t[8];
+  uint8_t i;
+  uint8_t j;
+
+  /* transpose: bit j of plane i is bit i of byte j */
+  memset(x, 0, sizeof(x));
+  for(j = 0; j < len; j++) {
+    for(i = 0; i < 8; i++) {
+      x[i] |= (uint16_t)((s[j] >> i) & 1) << j;
+    }
+  }
+
+  /* inverse as x^254; zero maps to zero as required */
+  gf_sq(x2, x);
+  gf_mul(x3, x2, x);
+  gf_sq(t, x3);              /* x^6 */
+  gf_sq(x12, t);
+  gf_mul(x15, x12, x3);
+  gf_sq(t, x15);             /* x^30 */
+  gf_sq(t, t);               /* x^60 */
+  gf_sq(t, t);               /* x^120 */
+  gf_sq(t, t);               /* x^240 */
+  gf_mul(t, t, x12);         /* x^252 */
+  gf_mul(t, t, x2);          /* x^254 */
+
+  /* affine transform with the constant 0x63 */
+  for(i = 0; i < 8; i++) {
+    x[i] = t[i] ^ t[(i + 4) & 7] ^ t[(i + 5) & 7]
+        ^ t[(i + 6) & 7] ^ t[(i + 7) & 7];
+    if((0x63 >> i) & 1) {
+      x[i] = ~x[i];
+    }
+  }
+
+  for(j = 0; j < len; j++) {
+    s[j] = 0;
+    for(i = 0; i < 8; i++) {
+      s[j] |= ((x[i] >> j) & 1) << i;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  uint8_t i;
+  uint8_t j;
+  uint8_t rcon;
+  uint8_t w[4];
+
+  rcon = 0x01;
+  memcpy(round_keys[0], key, AES_128_KEY_LENGTH);
+  for(i = 1; i <= 10; i++) {
+    w[0] = round_keys[i - 1][13];
+    w[1] = round_keys[i - 1][14];
+    w[2] = round_keys[i - 1][15];
+    w[3] = round_keys[i - 1][12];
+    sub_bytes(w, sizeof(w));
+    w[0] ^= rcon;
+    for(j = 0; j < 4; j++) {
+      round_keys[i][j] = round_keys[i - 1][j] ^ w[j];
+    }
+    for(j = 4; j < AES_128_BLOCK_SIZE; j++) {
+      round_keys[i][j] = round_keys[i - 1][j] ^ round_keys[i][j - 4];
+    }
+    rcon = galois_mul2(rcon);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt(uint8_t *state)
+{
+  uint8_t buf1, buf2, buf3, buf4, round, i;
+
+  /* round 0 */
+  /* AddRoundKey */
+  for(i = 0; i < AES_128_BLOCK_SIZE; i++) {
+    state[i] = state[i] ^ round_keys[0][i];
+  }
+
+  for(round = 1; round <= 10; round++) {
+    /* ByteSub */
+    sub_bytes(state, AES_128_BLOCK_SIZE);
+
+    /* ShiftRow */
+    buf1 = state[1];
+    state[1] = state[5];
+    state[5] = state[9];
+    state[9] = state[13];
+    state[13] = buf1;
+
+    buf1 = state[2];
+    buf2 = state[6];
+    state[2] = state[10];
+    state[6] = state[14];
+    state[10] = buf1;
+    state[14] = buf2;
+
+    buf1 = state[15];
+    state[15] = state[11];
+    state[11] = state[7];
+    state[7] = state[3];
+    state[3] = buf1;
+
+    /* last round skips MixColumn */
+    if(round < 10) {
+      /* MixColumn */
+      for(i = 0; i < 4; i++) {
+        buf4 = (i << 2);
+        buf1 = state[buf4] ^ state[buf4 + 1] ^ state[buf4 + 2] ^ state[buf4 + 3];
+        buf2 = state[buf4];
+        buf3 = galois_mul2(state[buf4] ^ state[buf4 + 1]);
+        state[buf4] = state[buf4] ^ buf3 ^ buf1;
+
+        buf3 = galois_mul2(state[buf4 + 1] ^ state[buf4 + 2]);
+        state[buf4 + 1] = state[buf4 + 1] ^ buf3 ^ buf1;
+
+        buf3 = galois_mul2(state[buf4 + 2] ^ state[buf4 + 3]);
+        state[buf4 + 2] = state[buf4 + 2] ^ buf3 ^ buf1;
+
+        buf3 = galois_mul2(state[buf4 + 3] ^ buf2);
+        state[buf4 + 3] = state[buf4 + 3] ^ buf3 ^ buf1;
+      }
+    }
+
+    /* AddRoundKey */
+    for(i = 0; i < AES_128_BLOCK_SIZE; i++) {
+      state[i] = state[i] ^ round_keys[round][i];
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct aes_128_driver aes_128_ct_driver = {
+  set_key,
+  encrypt
+};
+/*---------------------------------------------------------------------------*/
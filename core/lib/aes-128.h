@@ -74,4 +74,14 @@ void aes_128_set_padded_key(uint8_t *key, uint8_t key_len);
 
 extern const struct aes_128_driver AES_128;
 
+/**
+ * Software drivers that can be selected with AES_128_CONF instead of
+ * the default byte-oriented aes_128_driver. aes_128_ttable_driver
+ * uses 32-bit lookup tables and is the fastest one on 32-bit CPUs.
+ * aes_128_ct_driver computes the S-box on a bitsliced state and runs
+ * in constant time.
+ */
+extern const struct aes_128_driver aes_128_ttable_driver;
+extern const struct aes_128_driver aes_128_ct_driver;
+
 #endif /* AES_128_H_ */
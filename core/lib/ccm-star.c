@@ -59,33 +59,14 @@ set_iv(uint8_t *iv,
   iv[15] = counter;
 }
 /*---------------------------------------------------------------------------*/
-/* XORs the block m[pos] ... m[pos + 15] with K_{counter} */
+/* Computes the CBC-MAC over B_0 and the additional authenticated data */
 static void
-ctr_step(const uint8_t *nonce,
-    uint8_t pos,
-    uint8_t *m_and_result,
+mic_header(const uint8_t *nonce,
     uint8_t m_len,
-    uint8_t counter)
-{
-  uint8_t a[AES_128_BLOCK_SIZE];
-  uint8_t i;
-  
-  set_iv(a, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter);
-  AES_128.encrypt(a);
-  
-  for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-    m_and_result[pos + i] ^= a[i];
-  }
-}
-/*---------------------------------------------------------------------------*/
-static void
-mic(const uint8_t *nonce,
-    const uint8_t *m, uint8_t m_len,
     const uint8_t *a, uint8_t a_len,
-    uint8_t *result,
-    uint8_t mic_len)
+    uint8_t mic_len,
+    uint8_t *x)
 {
-  uint8_t x[AES_128_BLOCK_SIZE];
   uint8_t pos;
   uint8_t i;
   
@@ -109,35 +90,6 @@ mic(const uint8_t *nonce,
       AES_128.encrypt(x);
     }
   }
-  
-  if(m_len) {
-    pos = 0;
-    while(pos < m_len) {
-      for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= m[pos + i];
-      }
-      pos += AES_128_BLOCK_SIZE;
-      AES_128.encrypt(x);
-    }
-  }
-  
-  ctr_step(nonce, 0, x, AES_128_BLOCK_SIZE, 0);
-  
-  memcpy(result, x, mic_len);
-}
-/*---------------------------------------------------------------------------*/
-static void
-ctr(const uint8_t *nonce, uint8_t *m, uint8_t m_len)
-{
-  uint8_t pos;
-  uint8_t counter;
-  
-  pos = 0;
-  counter = 1;
-  while(pos < m_len) {
-    ctr_step(nonce, pos, m, m_len, counter++);
-    pos += AES_128_BLOCK_SIZE;
-  }
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -146,6 +98,12 @@ set_key(const uint8_t *key)
   AES_128.set_key(key);
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Authenticates and en-/decrypts in a single pass over m: each block
+ * is fed to the CBC-MAC and XORed with its key stream block before
+ * moving on to the next one. The counter block is set up once and
+ * only its counter byte is updated per block.
+ */
 static void
 aead(const uint8_t* nonce,
     uint8_t* m, uint8_t m_len,
@@ -153,20 +111,45 @@ aead(const uint8_t* nonce,
     uint8_t *result, uint8_t mic_len,
     int forward)
 {
-  if(!forward) {
-    /* decrypt */
-    ctr(nonce, m, m_len);
-  }
+  uint8_t x[AES_128_BLOCK_SIZE];
+  uint8_t ctr_block[AES_128_BLOCK_SIZE];
+  uint8_t s[AES_128_BLOCK_SIZE];
+  uint8_t pos;
+  uint8_t len;
+  uint8_t i;
+  
+  mic_header(nonce, m_len, a, a_len, mic_len, x);
   
-  mic(nonce,
-    m, m_len,
-    a, a_len,
-    result,
-    mic_len);
+  set_iv(ctr_block, CCM_STAR_ENCRYPTION_FLAGS, nonce, 0);
+  for(pos = 0; pos < m_len; pos += len) {
+    len = m_len - pos;
+    if(len > AES_128_BLOCK_SIZE) {
+      len = AES_128_BLOCK_SIZE;
+    }
+    
+    ctr_block[15]++;
+    memcpy(s, ctr_block, AES_128_BLOCK_SIZE);
+    AES_128.encrypt(s);
+    
+    if(forward) {
+      for(i = 0; i < len; i++) {
+        x[i] ^= m[pos + i];
+        m[pos + i] ^= s[i];
+      }
+    } else {
+      for(i = 0; i < len; i++) {
+        m[pos + i] ^= s[i];
+        x[i] ^= m[pos + i];
+      }
+    }
+    AES_128.encrypt(x);
+  }
   
-  if(forward) {
-    /* encrypt */
-    ctr(nonce, m, m_len);
+  /* encrypt the MIC with K_0 */
+  ctr_block[15] = 0;
+  AES_128.encrypt(ctr_block);
+  for(i = 0; i < mic_len; i++) {
+    result[i] = x[i] ^ ctr_block[i];
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -55,6 +55,42 @@
 #ifndef CRC16_H_
 #define CRC16_H_
 
+#include "contiki-conf.h"
+#include <stdint.h>
+
+/**
+ * \name CRC16 block implementations
+ *
+ *             The implementation used by crc16_data() and
+ *             crc16_update() is selected at compile time with
+ *             CRC16_CONF_IMPL. The bitwise implementation needs no
+ *             tables and is the default. The table-driven
+ *             implementation uses a 512 byte constant table, and the
+ *             slice-by-4 implementation uses 2 kilobytes of tables to
+ *             process four bytes per iteration. The latter two are
+ *             intended for platforms with plenty of ROM, such as
+ *             native gateways and the cc2538.
+ * @{
+ */
+#define CRC16_IMPL_BITWISE 0
+#define CRC16_IMPL_TABLE   1
+#define CRC16_IMPL_SLICE4  2
+
+#ifdef CRC16_CONF_IMPL
+#define CRC16_IMPL CRC16_CONF_IMPL
+#else /* CRC16_CONF_IMPL */
+#define CRC16_IMPL CRC16_IMPL_BITWISE
+#endif /* CRC16_CONF_IMPL */
+/** @} */
+
+/**
+ * \brief A streaming CRC16 context, used with crc16_init(),
+ *        crc16_update() and crc16_final().
+ */
+struct crc16_ctx {
+  unsigned short crc;
+};
+
 /**
  * \brief      Update an accumulated CRC16 checksum with one byte.
  * \param b    The byte to be added to the checksum
@@ -80,16 +116,41 @@ unsigned short crc16_add(unsigned char b, unsigned short crc);
  * \param acc  The accumulated CRC that is to be updated (or zero).
  * \return     The CRC16 checksum.
  *
- *             This function calculates the CRC16 checksum of a data area.
- *
- *             \note The algorithm used in this implementation is
- *             tailored for a running checksum and does not perform as
- *             well as a table-driven algorithm when checksumming an
- *             entire data block.
+ *             This function calculates the CRC16 checksum of a data
+ *             area, using the implementation selected with
+ *             CRC16_CONF_IMPL.
  */
 unsigned short crc16_data(const unsigned char *data, int datalen,
 			  unsigned short acc);
 
+/**
+ * \brief      Initialize a streaming CRC16 context
+ * \param ctx  The context
+ * \param acc  The initial CRC value (usually zero)
+ */
+void crc16_init(struct crc16_ctx *ctx, unsigned short acc);
+
+/**
+ * \brief      Add a chunk of data to a streaming CRC16 context
+ * \param ctx  The context
+ * \param data Pointer to the data
+ * \param datalen The length of the data
+ *
+ *             This function can be called any number of times with
+ *             consecutive chunks of a data stream. The result is the
+ *             same as calling crc16_data() once over the whole
+ *             stream.
+ */
+void crc16_update(struct crc16_ctx *ctx, const unsigned char *data,
+                  int datalen);
+
+/**
+ * \brief      Get the CRC16 checksum of a streaming context
+ * \param ctx  The context
+ * \return     The CRC16 checksum of all data added so far.
+ */
+unsigned short crc16_final(const struct crc16_ctx *ctx);
+
 #endif /* CRC16_H_ */
 
 /** @} */
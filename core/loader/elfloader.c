@@ -137,6 +137,21 @@ struct process * const * elfloader_autostart_processes;
 
 static struct relevant_section bss, data, rodata, text;
 
+#if ELFLOADER_SCRATCH_SIZE > 0
+/* The symbol and string tables of the file being loaded, and a hash
+   table over the symbol names, when they fit in the scratch memory.
+   syms is NULL when the tables are read from the file. */
+#define LOCAL_HASH_SIZE 32
+#define NO_SYMBOL 0xffff
+static elf32_word scratch[(ELFLOADER_SCRATCH_SIZE + sizeof(elf32_word) - 1) /
+			  sizeof(elf32_word)];
+static struct elf32_sym *syms;
+static unsigned short nsyms;
+static unsigned short *hash_first, *hash_next;
+static char *strings;
+static unsigned short stringsize;
+#endif /* ELFLOADER_SCRATCH_SIZE > 0 */
+
 static const unsigned char elf_magic_header[] =
   {0x7f, 0x45, 0x4c, 0x46,  /* 0x7f, 'E', 'L', 'F' */
    0x01,                    /* Only 32-bit objects. */
@@ -172,6 +187,104 @@ seek_write(int fd, unsigned int offset, char *buf, int len)
 }
 */
 /*---------------------------------------------------------------------------*/
+#if ELFLOADER_SCRATCH_SIZE > 0
+static unsigned char
+hash_name(const char *name)
+{
+  unsigned char h;
+
+  for(h = 0; *name != 0; ++name) {
+    h = (h << 1) + (h >> 7) + *name;
+  }
+  return h & (LOCAL_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+read_tables(int fd, unsigned int symtab, unsigned short symtabsize,
+	    unsigned int strtab, unsigned short strtabsize)
+{
+  unsigned int i;
+  unsigned char h;
+
+  syms = NULL;
+  nsyms = symtabsize / sizeof(struct elf32_sym);
+
+  /* The symbol table goes first, so that it is aligned, followed by
+     the hash table and the strings. */
+  if(symtabsize + sizeof(unsigned short) * (LOCAL_HASH_SIZE + nsyms) +
+     strtabsize + 1 > sizeof(scratch)) {
+    PRINTF("elfloader: symbol tables do not fit in %d bytes\n",
+	   (int)sizeof(scratch));
+    return;
+  }
+  hash_first = (unsigned short *)((char *)scratch + symtabsize);
+  hash_next = hash_first + LOCAL_HASH_SIZE;
+  strings = (char *)(hash_next + nsyms);
+  stringsize = strtabsize;
+
+  seek_read(fd, symtab, (char *)scratch, symtabsize);
+  seek_read(fd, strtab, strings, strtabsize);
+  strings[strtabsize] = 0;
+  syms = (struct elf32_sym *)scratch;
+
+  /* Chain the symbols from the end of the table, so that the first
+     symbol with a name is found first, as with the file lookup. */
+  for(i = 0; i < LOCAL_HASH_SIZE; ++i) {
+    hash_first[i] = NO_SYMBOL;
+  }
+  for(i = nsyms; i > 0; --i) {
+    if(syms[i - 1].st_name != 0 && syms[i - 1].st_name < stringsize) {
+      h = hash_name(&strings[syms[i - 1].st_name]);
+      hash_next[i - 1] = hash_first[h];
+      hash_first[h] = i - 1;
+    }
+  }
+}
+#endif /* ELFLOADER_SCRATCH_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+/* Get symbol number num and its name, either from the scratch memory
+   or from the file into the name buffer. */
+static const char *
+read_symbol(int fd, unsigned int symtab, unsigned int strtab,
+	    unsigned int num, struct elf32_sym *s, char *name, int namelen)
+{
+#if ELFLOADER_SCRATCH_SIZE > 0
+  if(syms != NULL) {
+    if(num >= nsyms) {
+      memset(s, 0, sizeof(*s));
+      return "";
+    }
+    *s = syms[num];
+    return s->st_name < stringsize ? &strings[s->st_name] : "";
+  }
+#endif /* ELFLOADER_SCRATCH_SIZE > 0 */
+  seek_read(fd, symtab + sizeof(struct elf32_sym) * num, (char *)s,
+	    sizeof(*s));
+  if(s->st_name != 0) {
+    seek_read(fd, strtab + s->st_name, name, namelen);
+  }
+  return name;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+local_symbol_address(struct elf32_sym *s)
+{
+  struct relevant_section *sect;
+
+  if(s->st_shndx == bss.number) {
+    sect = &bss;
+  } else if(s->st_shndx == data.number) {
+    sect = &data;
+  } else if(s->st_shndx == rodata.number) {
+    sect = &rodata;
+  } else if(s->st_shndx == text.number) {
+    sect = &text;
+  } else {
+    return NULL;
+  }
+  return &(sect->address[s->st_value]);
+}
+/*---------------------------------------------------------------------------*/
 static void *
 find_local_symbol(int fd, const char *symbol,
 		  unsigned int symtab, unsigned short symtabsize,
@@ -180,26 +293,25 @@ find_local_symbol(int fd, const char *symbol,
   struct elf32_sym s;
   unsigned int a;
   char name[30];
-  struct relevant_section *sect;
-  
+
+#if ELFLOADER_SCRATCH_SIZE > 0
+  if(syms != NULL) {
+    for(a = hash_first[hash_name(symbol)]; a != NO_SYMBOL; a = hash_next[a]) {
+      if(strcmp(&strings[syms[a].st_name], symbol) == 0) {
+	return local_symbol_address(&syms[a]);
+      }
+    }
+    return NULL;
+  }
+#endif /* ELFLOADER_SCRATCH_SIZE > 0 */
+
   for(a = symtab; a < symtab + symtabsize; a += sizeof(s)) {
     seek_read(fd, a, (char *)&s, sizeof(s));
 
     if(s.st_name != 0) {
       seek_read(fd, strtab + s.st_name, name, sizeof(name));
       if(strcmp(name, symbol) == 0) {
-	if(s.st_shndx == bss.number) {
-	  sect = &bss;
-	} else if(s.st_shndx == data.number) {
-	  sect = &data;
-  } else if(s.st_shndx == rodata.number) {
-    sect = &rodata;
-	} else if(s.st_shndx == text.number) {
-	  sect = &text;
-	} else {
-	  return NULL;
-	}
-	return &(sect->address[s.st_value]);
+	return local_symbol_address(&s);
       }
     }
   }
@@ -221,7 +333,8 @@ relocate_section(int fd,
   int rel_size = 0;
   struct elf32_sym s;
   unsigned int a;
-  char name[30];
+  char namebuf[30];
+  const char *name;
   char *addr;
   struct relevant_section *sect;
 
@@ -234,11 +347,9 @@ relocate_section(int fd,
   
   for(a = section; a < section + size; a += rel_size) {
     seek_read(fd, a, (char *)&rela, rel_size);
-    seek_read(fd,
-	      symtab + sizeof(struct elf32_sym) * ELF32_R_SYM(rela.r_info),
-	      (char *)&s, sizeof(s));
+    name = read_symbol(fd, symtab, strtab, ELF32_R_SYM(rela.r_info),
+		       &s, namebuf, sizeof(namebuf));
     if(s.st_name != 0) {
-      seek_read(fd, strtab + s.st_name, name, sizeof(name));
       PRINTF("name: %s\n", name);
       addr = (char *)symtab_lookup(name);
       /* ADDED */
@@ -258,7 +369,7 @@ relocate_section(int fd,
 	  sect = &text;
 	} else {
 	  PRINTF("elfloader unknown name: '%30s'\n", name);
-	  memcpy(elfloader_unknown, name, sizeof(elfloader_unknown));
+	  strncpy(elfloader_unknown, name, sizeof(elfloader_unknown) - 1);
 	  elfloader_unknown[sizeof(elfloader_unknown) - 1] = 0;
 	  return ELFLOADER_SYMBOL_NOT_FOUND;
 	}
@@ -297,13 +408,13 @@ find_program_processes(int fd,
 {
   struct elf32_sym s;
   unsigned int a;
-  char name[30];
+  char namebuf[30];
+  const char *name;
   
-  for(a = symtab; a < symtab + size; a += sizeof(s)) {
-    seek_read(fd, a, (char *)&s, sizeof(s));
+  for(a = 0; a < size / sizeof(s); ++a) {
+    name = read_symbol(fd, symtab, strtab, a, &s, namebuf, sizeof(namebuf));
 
     if(s.st_name != 0) {
-      seek_read(fd, strtab + s.st_name, name, sizeof(name));
       if(strcmp(name, "autostart_processes") == 0) {
 	return &data.address[s.st_value];
       }
@@ -438,7 +549,9 @@ elfloader_load(int fd)
       PRINTF("symtab\n");
       symtaboff = shdr.sh_offset;
       symtabsize = shdr.sh_size;
-    } else if(shdr.sh_type == SHT_STRTAB/*strncmp(name, ".strtab", 7) == 0*/) {
+    } else if(shdr.sh_type == SHT_STRTAB/*strncmp(name, ".strtab", 7) == 0*/ &&
+	      i != ehdr.e_shstrndx) {
+      /* The section name string table is also of type SHT_STRTAB. */
       PRINTF("strtab\n");
       strtaboff = shdr.sh_offset;
       strtabsize = shdr.sh_size;
@@ -504,6 +617,10 @@ elfloader_load(int fd)
     return ELFLOADER_NO_TEXT;
   }
 
+#if ELFLOADER_SCRATCH_SIZE > 0
+  read_tables(fd, symtaboff, symtabsize, strtaboff, strtabsize);
+#endif /* ELFLOADER_SCRATCH_SIZE > 0 */
+
   PRINTF("before allocate ram\n");
   bss.address = (char *)elfloader_arch_allocate_ram(bsssize + datasize);
   data.address = (char *)bss.address + bsssize;
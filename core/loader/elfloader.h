@@ -175,6 +175,21 @@ extern char elfloader_unknown[30];
 #endif
 #endif /* ELFLOADER_TEXTMEMORY_SIZE */
 
+/*
+ * Size of the scratch memory into which elfloader_load() reads the
+ * symbol and string tables of the ELF file. If both tables fit,
+ * symbols are resolved from memory through a hash table instead of
+ * being read from the file for every relocation. With 0, symbols are
+ * always read from the file.
+ */
+#ifndef ELFLOADER_SCRATCH_SIZE
+#ifdef ELFLOADER_CONF_SCRATCH_SIZE
+#define ELFLOADER_SCRATCH_SIZE ELFLOADER_CONF_SCRATCH_SIZE
+#else
+#define ELFLOADER_SCRATCH_SIZE 0
+#endif
+#endif /* ELFLOADER_SCRATCH_SIZE */
+
 typedef unsigned long  elf32_word;
 typedef   signed long  elf32_sword;
 typedef unsigned short elf32_half;
@@ -41,4 +41,9 @@ extern const int symbols_nelts;
 
 extern const struct symbols symbols[/* symbols_nelts */];
 
+/* Hash table over symbols[], generated by tools/mknmlist. Used by
+   symtab_lookup() if SYMTAB_CONF_HASH is set. */
+extern const int symbols_hash_size;
+extern const unsigned short symbols_hash[/* symbols_hash_size */];
+
 #endif /* SYMBOLS_DEF_H_ */
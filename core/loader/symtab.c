@@ -30,19 +30,50 @@
  *
  */
 
+#include "contiki-conf.h"
 #include "symtab.h"
 
 #include "loader/symbols.h"
 
+#include <stdint.h>
 #include <string.h>
 
+/* Hashing needs the symbols_hash[] table that tools/mknmlist
+   generates along with symbols[]. */
+#ifndef SYMTAB_CONF_HASH
+#define SYMTAB_CONF_HASH 0
+#endif
+
 /* Binary search is twice as large but still small. */
 #ifndef SYMTAB_CONF_BINARY_SEARCH
 #define SYMTAB_CONF_BINARY_SEARCH 1
 #endif
 
 /*---------------------------------------------------------------------------*/
-#if SYMTAB_CONF_BINARY_SEARCH
+#if SYMTAB_CONF_HASH
+void *
+symtab_lookup(const char *name)
+{
+  const char *p;
+  uint16_t h;
+  int i;
+
+  /* The same hash function as in tools/mknmlist. */
+  h = 5381;
+  for(p = name; *p != 0; ++p) {
+    h = h * 33 + (unsigned char)*p;
+  }
+
+  for(i = h & (symbols_hash_size - 1);
+      symbols_hash[i] != 0;
+      i = (i + 1) & (symbols_hash_size - 1)) {
+    if(strcmp(name, symbols[symbols_hash[i] - 1].name) == 0) {
+      return symbols[symbols_hash[i] - 1].value;
+    }
+  }
+  return NULL;
+}
+#elif SYMTAB_CONF_BINARY_SEARCH
 void *
 symtab_lookup(const char *name)
 {
@@ -50,7 +81,7 @@ symtab_lookup(const char *name)
   int r;
   
   start = 0;
-  end = symbols_nelts - 1;	/* Last entry is { 0, 0 }. */
+  end = symbols_nelts - 2;	/* Last entry is { 0, 0 }. */
 
   while(start <= end) {
     /* Check middle, divide */
@@ -78,5 +109,5 @@ symtab_lookup(const char *name)
   }
   return 0;
 }
-#endif /* SYMTAB_CONF_BINARY_SEARCH */
+#endif /* SYMTAB_CONF_HASH */
 /*---------------------------------------------------------------------------*/
@@ -59,6 +59,21 @@ call_event(struct tcp_socket *s, tcp_socket_event_t event)
 static void
 senddata(struct tcp_socket *s)
 {
+#if UIP_TCP_SEND_WINDOW > 1
+  /* The data before output_data_send_nxt is in flight, and uIP takes
+     care of retransmitting it. */
+  int len = MIN(s->output_data_max_seg, uip_sendwnd());
+
+  len = MIN(s->output_data_len - s->output_data_send_nxt, len);
+  if(len > 0) {
+    uip_send(&s->output_data_ptr[s->output_data_send_nxt], len);
+    s->output_data_send_nxt += len;
+    if(s->output_data_send_nxt < s->output_data_len) {
+      /* Get called again to fill the rest of the send window. */
+      tcpip_poll_tcp(uip_conn);
+    }
+  }
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   int len = MIN(s->output_data_max_seg, uip_mss());
 
   if(s->output_senddata_len > 0) {
@@ -66,11 +81,34 @@ senddata(struct tcp_socket *s)
     s->output_data_send_nxt = len;
     uip_send(s->output_data_ptr, len);
   }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 }
 /*---------------------------------------------------------------------------*/
 static void
 acked(struct tcp_socket *s)
 {
+#if UIP_TCP_SEND_WINDOW > 1
+  uint16_t len = uip_ackedlen();
+
+  if(len == 0) {
+    return;
+  }
+  if(len > s->output_data_send_nxt) {
+    PRINTF("tcp: acked assertion failed len (%d) > s->output_data_send_nxt (%d)\n",
+           len, s->output_data_send_nxt);
+    tcp_markconn(uip_conn, NULL);
+    uip_abort();
+    call_event(s, TCP_SOCKET_ABORTED);
+    relisten(s);
+    return;
+  }
+  memmove(&s->output_data_ptr[0], &s->output_data_ptr[len],
+          s->output_data_len - len);
+  s->output_data_len -= len;
+  s->output_data_send_nxt -= len;
+
+  call_event(s, TCP_SOCKET_DATA_SENT);
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   if(s->output_senddata_len > 0) {
     /* Copy the data in the outputbuf down and update outputbufptr and
        outputbuf_lastsent */
@@ -96,6 +134,7 @@ acked(struct tcp_socket *s)
 
     call_event(s, TCP_SOCKET_DATA_SENT);
   }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -164,6 +203,7 @@ appcall(void *state)
 	  s->flags &= ~TCP_SOCKET_FLAGS_LISTENING;
           s->output_data_max_seg = uip_mss();
 	  tcp_markconn(uip_conn, s);
+	  s->c = uip_conn;
 	  call_event(s, TCP_SOCKET_CONNECTED);
 	  break;
 	}
@@ -176,6 +216,10 @@ appcall(void *state)
     if(s == NULL) {
       uip_abort();
     } else {
+#if UIP_TCP_SEND_WINDOW > 1
+      /* Nothing of the output buffer is in flight yet. */
+      s->output_data_send_nxt = 0;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
       if(uip_newdata()) {
         newdata(s);
       }
@@ -351,6 +395,20 @@ tcp_socket_send(struct tcp_socket *s,
   len = MIN(datalen, s->output_data_maxlen - s->output_data_len);
 
   memcpy(&s->output_data_ptr[s->output_data_len], data, len);
+
+  return tcp_socket_send_commit(s, len);
+}
+/*---------------------------------------------------------------------------*/
+int
+tcp_socket_send_commit(struct tcp_socket *s, int datalen)
+{
+  int len;
+
+  if(s == NULL) {
+    return -1;
+  }
+
+  len = MIN(datalen, s->output_data_maxlen - s->output_data_len);
   s->output_data_len += len;
 
   if(s->output_senddata_len == 0) {
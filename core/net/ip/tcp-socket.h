@@ -224,11 +224,41 @@ int tcp_socket_unlisten(struct tcp_socket *s);
  *             data has been acknowledged by the remote host, the
  *             event callback is sent with the TCP_SOCKET_DATA_SENT
  *             event.
+ *
+ *             If uIP is configured with a send window of more than
+ *             one segment (UIP_CONF_TCP_SEND_WINDOW), the socket
+ *             sends as many segments from the output buffer as the
+ *             window allows without waiting for each one to be
+ *             acknowledged, and the TCP_SOCKET_DATA_SENT event is
+ *             sent whenever some of the data has been acknowledged.
  */
 int tcp_socket_send(struct tcp_socket *s,
                     const uint8_t *dataptr,
                     int datalen);
 
+/**
+ * \brief      Send data that has been written into the output buffer
+ * \param s    A pointer to a TCP socket that must have been previously registered with tcp_socket_register()
+ * \param datalen The number of bytes written into the output buffer
+ * \retval -1  If an error occurs
+ * \return     The number of bytes that were successfully sent
+ *
+ *             This function works like tcp_socket_send(), but
+ *             instead of copying the data it sends datalen bytes
+ *             that the caller has already written directly into
+ *             the output buffer, starting at
+ *             tcp_socket_queuelen() bytes from the start of the
+ *             buffer that was given to tcp_socket_register(). At
+ *             most tcp_socket_max_sendlen() bytes may be written.
+ *
+ *             The data must be written and sent without giving up
+ *             control to other processes in between, because the
+ *             contents of the output buffer are moved when earlier
+ *             data is acknowledged.
+ */
+int tcp_socket_send_commit(struct tcp_socket *s,
+                           int datalen);
+
 /**
  * \brief      Send a string on a connected TCP socket
  * \param s    A pointer to a TCP socket that must have been previously registered with tcp_socket_register()
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2017, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Internet checksum computation.
+ */
+
+#include "net/ip/uip.h"
+#include "net/ip/uip-chksum.h"
+
+#include <string.h>
+
+/*---------------------------------------------------------------------------*/
+#if !UIP_ARCH_CHKSUM_ADD
+uint16_t
+uip_chksum_add(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+#if UIP_CHKSUM_WIDE
+  /*
+   * Sum native words and convert only the result to network byte
+   * order, which yields the same one's complement sum (RFC 1071).
+   */
+  uint64_t acc;
+  uint32_t w32;
+  uint16_t w16;
+
+  acc = UIP_HTONS(sum);
+  for(; len >= 4; len -= 4) {
+    memcpy(&w32, data, sizeof(w32));
+    acc += w32;
+    data += 4;
+  }
+  if(len >= 2) {
+    memcpy(&w16, data, sizeof(w16));
+    acc += w16;
+    data += 2;
+    len -= 2;
+  }
+  if(len) {
+    w16 = 0;
+    memcpy(&w16, data, 1);
+    acc += w16;
+  }
+
+  acc = (acc & 0xffffffff) + (acc >> 32);
+  acc = (acc & 0xffffffff) + (acc >> 32);
+  acc = (acc & 0xffff) + (acc >> 16);
+  acc = (acc & 0xffff) + (acc >> 16);
+
+  return UIP_HTONS((uint16_t)acc);
+#else /* UIP_CHKSUM_WIDE */
+  /* Defer the carries to the end instead of checking every word */
+  uint32_t acc;
+  const uint8_t *last_byte;
+
+  acc = sum;
+  last_byte = data + len - 1;
+
+  while(data < last_byte) {   /* At least two more bytes */
+    acc += ((uint16_t)data[0] << 8) | data[1];
+    data += 2;
+  }
+
+  if(data == last_byte) {
+    acc += (uint16_t)data[0] << 8;
+  }
+
+  acc = (acc & 0xffff) + (acc >> 16);
+  acc = (acc & 0xffff) + (acc >> 16);
+
+  /* Return sum in host byte order. */
+  return (uint16_t)acc;
+#endif /* UIP_CHKSUM_WIDE */
+}
+#endif /* !UIP_ARCH_CHKSUM_ADD */
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_chksum_replace(uint16_t chksum, uint16_t old_sum, uint16_t new_sum)
+{
+  uint32_t acc;
+
+  /* HC' = ~(~HC + ~m + m') */
+  acc = (uint16_t)~chksum;
+  acc += (uint16_t)~old_sum;
+  acc += new_sum;
+  acc = (acc & 0xffff) + (acc >> 16);
+  acc = (acc & 0xffff) + (acc >> 16);
+
+  return (uint16_t)~acc;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup uip
+ * @{
+ */
+
+/**
+ * \file
+ *         Internet checksum (RFC 1071) computation shared by the IPv4,
+ *         IPv6 and IP64 stacks, with incremental update (RFC 1624).
+ */
+
+#ifndef UIP_CHKSUM_H_
+#define UIP_CHKSUM_H_
+
+#include "contiki-conf.h"
+#include <stdint.h>
+
+/**
+ * Accumulate 32-bit words into a 64-bit sum instead of 16-bit words
+ * into a 32-bit sum. Only worthwhile on 32/64-bit CPUs that support
+ * unaligned loads, such as the native platform.
+ */
+#ifdef UIP_CHKSUM_CONF_WIDE
+#define UIP_CHKSUM_WIDE UIP_CHKSUM_CONF_WIDE
+#else /* UIP_CHKSUM_CONF_WIDE */
+#define UIP_CHKSUM_WIDE 0
+#endif /* UIP_CHKSUM_CONF_WIDE */
+
+/**
+ * \brief      Add data to a one's complement sum
+ * \param sum  The sum so far, in host byte order (zero to start)
+ * \param data The data to add
+ * \param len  The length of the data in bytes
+ * \return     The updated sum in host byte order
+ *
+ *             An odd trailing byte is padded with a zero byte, so
+ *             all but the last chunk added to a sum must have an
+ *             even length.
+ *
+ *             Architectures can provide their own implementation by
+ *             defining UIP_ARCH_CHKSUM_ADD to 1.
+ */
+uint16_t uip_chksum_add(uint16_t sum, const uint8_t *data, uint16_t len);
+
+/**
+ * \brief          Incrementally update a checksum (RFC 1624, eqn. 3)
+ * \param chksum   The checksum field to update, in host byte order
+ * \param old_sum  The one's complement sum of the data removed from
+ *                 the checksummed data
+ * \param new_sum  The one's complement sum of the data added instead
+ * \return         The updated checksum field in host byte order
+ *
+ *                 The removed and added data need not have the same
+ *                 length, which allows to swap pseudo headers of
+ *                 different IP versions.
+ */
+uint16_t uip_chksum_replace(uint16_t chksum, uint16_t old_sum,
+                            uint16_t new_sum);
+
+#endif /* UIP_CHKSUM_H_ */
+
+/** @} */
@@ -820,6 +820,37 @@ CCIF void uip_send(const void *data, int len);
  */
 #define uip_mss()             (uip_conn->mss)
 
+#if UIP_TCP_SEND_WINDOW > 1
+/**
+ * Get the number of bytes that the application may send on the
+ * current connection with uip_send().
+ *
+ * With a send window of more than one segment (UIP_TCP_SEND_WINDOW),
+ * the application may send new data whenever this is non-zero, even
+ * if previously sent data has not been acknowledged yet. uIP keeps
+ * the data until it is acknowledged and does all retransmissions. The
+ * number of bytes that an incoming segment acknowledged is given by
+ * uip_ackedlen().
+ *
+ * Data sent with uip_send() is never truncated: if it is larger than
+ * uip_sendwnd(), none of it is sent, and the application is called
+ * with uip_rexmit() set once the window has opened, so that it sends
+ * the data again. Applications written for a single segment in flight,
+ * such as protosocket applications, therefore keep working, but only
+ * those that size their data with uip_sendwnd(), such as tcp-socket
+ * applications, benefit from the larger window.
+ */
+uint16_t uip_sendwnd(void);
+
+/**
+ * The number of bytes acknowledged when uip_acked() is non-zero.
+ *
+ * \hideinitializer
+ */
+#define uip_ackedlen()        uip_acklen
+extern uint16_t uip_acklen;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
 /**
  * Set up a new UDP connection.
  *
@@ -868,7 +899,12 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_CONN_HASH_SIZE
+#define uip_udp_bind(conn, port) uip_udp_bind_hashed(conn, port)
+void uip_udp_bind_hashed(struct uip_udp_conn *conn, uint16_t port);
+#else /* UIP_CONN_HASH_SIZE */
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif /* UIP_CONN_HASH_SIZE */
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1352,6 +1388,11 @@ struct uip_conn {
   uint8_t timer;         /**< The retransmission timer. */
   uint8_t nrtx;          /**< The number of retransmissions for the last
                               segment sent. */
+#if UIP_TCP_SEND_WINDOW > 1
+  struct uip_tcp_rtx_seg *rtxq; /**< The segments in flight, oldest first. */
+  uint16_t snd_wnd;      /**< The window advertised by the remote host. */
+  uint8_t dupacks;       /**< The number of duplicate ACKs received. */
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   uip_tcp_appstate_t appstate; /** The application state. */
 };
@@ -1598,6 +1639,8 @@ void uip_process(uint8_t flag);
 #define UIP_TS_MASK     15
 
 #define UIP_STOPPED      16
+#define UIP_CLOSE_PENDING 32
+#define UIP_SEND_REJECTED 64
 
 /* The TCP and IP headers. */
 struct uip_tcpip_hdr {
@@ -435,6 +435,25 @@ void uip_log(char *msg);
 #define UIP_LISTENPORTS (UIP_CONF_MAX_LISTENPORTS)
 #endif /* UIP_CONF_MAX_LISTENPORTS */
 
+/**
+ * The number of buckets in the hash index used to find the TCP and
+ * UDP connection that an incoming packet belongs to.
+ *
+ * When set to zero, incoming packets are matched by scanning the
+ * connection tables linearly. Otherwise this must be a power of two
+ * no larger than 128. The index is keyed on the local port, remote
+ * port and remote address of each connection, and costs two bytes
+ * per bucket plus two bytes per connection for each of TCP and UDP.
+ * It is only supported by the IPv6 stack.
+ *
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_CONN_HASH_SIZE
+#define UIP_CONN_HASH_SIZE 0
+#else /* UIP_CONF_CONN_HASH_SIZE */
+#define UIP_CONN_HASH_SIZE (UIP_CONF_CONN_HASH_SIZE)
+#endif /* UIP_CONF_CONN_HASH_SIZE */
+
 /**
  * Determines if support for TCP urgent data notification should be
  * compiled in.
@@ -500,6 +519,47 @@ void uip_log(char *msg);
 #define UIP_RECEIVE_WINDOW (UIP_CONF_RECEIVE_WINDOW)
 #endif
 
+/**
+ * The maximum number of unacknowledged segments per TCP connection.
+ *
+ * By default uIP only has a single segment in flight, and asks the
+ * application to regenerate its data when the segment must be
+ * retransmitted, which limits the throughput to one MSS per round
+ * trip. With a larger send window, uIP keeps a copy of every segment
+ * in flight in a retransmission buffer, retransmits on its own, and
+ * does fast retransmit after UIP_TCP_DUPACK_THRESHOLD duplicate
+ * ACKs. Only applications that size their data with uip_sendwnd(),
+ * such as tcp-socket applications, send more than one segment per
+ * round trip; see uip_sendwnd(). Only supported by the IPv6 stack.
+ *
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_TCP_SEND_WINDOW
+#define UIP_TCP_SEND_WINDOW 1
+#else /* UIP_CONF_TCP_SEND_WINDOW */
+#define UIP_TCP_SEND_WINDOW (UIP_CONF_TCP_SEND_WINDOW)
+#endif /* UIP_CONF_TCP_SEND_WINDOW */
+
+/**
+ * The number of retransmission buffers, shared by all TCP
+ * connections, when UIP_TCP_SEND_WINDOW is larger than one.
+ *
+ * Each buffer holds one segment of up to UIP_TCP_MSS bytes.
+ *
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_TCP_RTX_SEGMENTS
+#define UIP_TCP_RTX_SEGMENTS UIP_TCP_SEND_WINDOW
+#else /* UIP_CONF_TCP_RTX_SEGMENTS */
+#define UIP_TCP_RTX_SEGMENTS (UIP_CONF_TCP_RTX_SEGMENTS)
+#endif /* UIP_CONF_TCP_RTX_SEGMENTS */
+
+/**
+ * The number of duplicate ACKs after which the oldest segment in
+ * flight is retransmitted without waiting for the timer.
+ */
+#define UIP_TCP_DUPACK_THRESHOLD 3
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
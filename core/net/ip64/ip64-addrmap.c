@@ -46,9 +46,52 @@
 #define NUM_ENTRIES 32
 #endif /* IP64_ADDRMAP_CONF_ENTRIES */
 
+#ifdef IP64_ADDRMAP_CONF_HASH_SIZE
+#define HASH_SIZE IP64_ADDRMAP_CONF_HASH_SIZE
+#else /* IP64_ADDRMAP_CONF_HASH_SIZE */
+#define HASH_SIZE 16
+#endif /* IP64_ADDRMAP_CONF_HASH_SIZE */
+
+#if HASH_SIZE & (HASH_SIZE - 1)
+#error IP64_ADDRMAP_CONF_HASH_SIZE must be a power of two
+#endif
+
+/* Mappings are expired with a timer wheel: WHEEL_SLOTS slots, each
+   WHEEL_TICK long. */
+#ifdef IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#define WHEEL_SLOTS IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#else /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+#define WHEEL_SLOTS 16
+#endif /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+
+#ifdef IP64_ADDRMAP_CONF_WHEEL_TICK
+#define WHEEL_TICK IP64_ADDRMAP_CONF_WHEEL_TICK
+#else /* IP64_ADDRMAP_CONF_WHEEL_TICK */
+#define WHEEL_TICK (CLOCK_SECOND * 4)
+#endif /* IP64_ADDRMAP_CONF_WHEEL_TICK */
+
 MEMB(entrymemb, struct ip64_addrmap_entry, NUM_ENTRIES);
 LIST(entrylist);
 
+/* Entries hashed on the IPv6 address/port, IPv4 address/port and
+   protocol, used for packets going out to the IPv4 network. */
+static struct ip64_addrmap_entry *tuple_hash[HASH_SIZE];
+
+/* Entries hashed on the mapped port, used for packets coming in from
+   the IPv4 network. */
+static struct ip64_addrmap_entry *port_hash[HASH_SIZE];
+
+/* The timer wheel. Slot wheel_pos holds the entries that expire
+   before wheel_time + WHEEL_TICK, the next slot those that expire
+   during the following tick, and so on. Entries that expire after the
+   last slot are kept in it and filed again when it comes around.
+   Because ip64_addrmap_set_lifetime() does not move an entry when its
+   lifetime is extended, an entry may be found in a slot before its
+   timer has expired; it is then filed again. */
+static struct ip64_addrmap_entry *wheel[WHEEL_SLOTS];
+static uint8_t wheel_pos;
+static clock_time_t wheel_time;
+
 #define FIRST_MAPPED_PORT 10000
 #define LAST_MAPPED_PORT  20000
 static uint16_t mapped_port = FIRST_MAPPED_PORT;
@@ -67,24 +110,149 @@ ip64_addrmap_init(void)
 {
   memb_init(&entrymemb);
   list_init(entrylist);
+  memset(tuple_hash, 0, sizeof(tuple_hash));
+  memset(port_hash, 0, sizeof(port_hash));
+  memset(wheel, 0, sizeof(wheel));
+  wheel_pos = 0;
+  wheel_time = clock_time();
   mapped_port = FIRST_MAPPED_PORT;
 }
 /*---------------------------------------------------------------------------*/
+static struct ip64_addrmap_entry **
+tuple_bucket(const uip_ip6addr_t *ip6addr,
+             uint16_t ip6port,
+             const uip_ip4addr_t *ip4addr,
+             uint16_t ip4port,
+             uint8_t protocol)
+{
+  uint16_t h;
+
+  h = ip6addr->u16[6] ^ ip6addr->u16[7] ^ ip6port ^
+    ip4addr->u16[0] ^ ip4addr->u16[1] ^ ip4port ^ protocol;
+  h ^= h >> 8;
+  return &tuple_hash[h & (HASH_SIZE - 1)];
+}
+/*---------------------------------------------------------------------------*/
+static struct ip64_addrmap_entry **
+port_bucket(uint16_t port)
+{
+  return &port_hash[(port ^ (port >> 8)) & (HASH_SIZE - 1)];
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_add(struct ip64_addrmap_entry *m)
+{
+  clock_time_t offset;
+  uint8_t slots;
+
+  /* Find the slot that covers the expiration time of the entry. */
+  slots = 0;
+  if(!timer_expired(&m->timer)) {
+    offset = clock_time() - wheel_time + timer_remaining(&m->timer);
+    if(offset / WHEEL_TICK >= WHEEL_SLOTS) {
+      slots = WHEEL_SLOTS - 1;
+    } else {
+      slots = offset / WHEEL_TICK;
+    }
+  }
+  m->wheel_slot = (wheel_pos + slots) % WHEEL_SLOTS;
+  m->wheel_next = wheel[m->wheel_slot];
+  wheel[m->wheel_slot] = m;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_remove(struct ip64_addrmap_entry *m)
+{
+  struct ip64_addrmap_entry **p;
+
+  for(p = &wheel[m->wheel_slot]; *p != NULL; p = &(*p)->wheel_next) {
+    if(*p == m) {
+      *p = m->wheel_next;
+      break;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+free_entry(struct ip64_addrmap_entry *m)
+{
+  struct ip64_addrmap_entry **p;
+
+  /* Unlink the entry from everything but the timer wheel. */
+  for(p = tuple_bucket(&m->ip6addr, m->ip6port, &m->ip4addr, m->ip4port,
+                       m->protocol);
+      *p != NULL; p = &(*p)->hash_next) {
+    if(*p == m) {
+      *p = m->hash_next;
+      break;
+    }
+  }
+  for(p = port_bucket(m->mapped_port); *p != NULL; p = &(*p)->port_next) {
+    if(*p == m) {
+      *p = m->port_next;
+      break;
+    }
+  }
+  list_remove(entrylist, m);
+  memb_free(&entrymemb, m);
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_entry(struct ip64_addrmap_entry *m)
+{
+  wheel_remove(m);
+  free_entry(m);
+}
+/*---------------------------------------------------------------------------*/
 static void
 check_age(void)
 {
-  struct ip64_addrmap_entry *m;
+  struct ip64_addrmap_entry *m, *expiring;
+  clock_time_t ticks;
+  uint8_t i;
 
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
-  m = list_head(entrylist);
-  while(m != NULL) {
+  /* Advance the timer wheel to the current time. The entries in the
+     slots that we pass are taken out of the wheel. Those whose timers
+     have expired are thrown away, the others are filed again. */
+  ticks = (clock_time() - wheel_time) / WHEEL_TICK;
+  if(ticks == 0) {
+    return;
+  }
+  expiring = NULL;
+  for(i = 0; i < WHEEL_SLOTS && i < ticks; i++) {
+    while(wheel[wheel_pos] != NULL) {
+      m = wheel[wheel_pos];
+      wheel[wheel_pos] = m->wheel_next;
+      m->wheel_next = expiring;
+      expiring = m;
+    }
+    wheel_pos = (wheel_pos + 1) % WHEEL_SLOTS;
+  }
+  wheel_pos = (wheel_pos + (ticks - i)) % WHEEL_SLOTS;
+  wheel_time += ticks * WHEEL_TICK;
+
+  while(expiring != NULL) {
+    m = expiring;
+    expiring = m->wheel_next;
     if(timer_expired(&m->timer)) {
-      list_remove(entrylist, m);
-      memb_free(&entrymemb, m);
-      m = list_head(entrylist);
+      free_entry(m);
     } else {
-      m = list_item_next(m);
+      wheel_add(m);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_expired(void)
+{
+  struct ip64_addrmap_entry *m, *next;
+
+  /* Throw away all address mappings that are too old, including the
+     ones that the timer wheel has not reached yet. */
+  for(m = list_head(entrylist); m != NULL; m = next) {
+    next = list_item_next(m);
+    if(timer_expired(&m->timer)) {
+      remove_entry(m);
     }
   }
 }
@@ -117,14 +285,30 @@ recycle(void)
   /* If we found an oldest recyclable entry, remove it and return
      non-zero. */
   if(oldest != NULL) {
-    list_remove(entrylist, oldest);
-    memb_free(&entrymemb, oldest);
+    remove_entry(oldest);
     return 1;
   }
 
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+static struct ip64_addrmap_entry *
+find_port(uint16_t mapped_port, uint8_t protocol, int any_protocol)
+{
+  struct ip64_addrmap_entry *m;
+
+  for(m = *port_bucket(mapped_port); m != NULL; m = m->port_next) {
+    printf("mapped port %d %d, protocol %d %d\n",
+	   m->mapped_port, mapped_port,
+	   m->protocol, protocol);
+    if(m->mapped_port == mapped_port &&
+       (any_protocol || m->protocol == protocol)) {
+      return m;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 struct ip64_addrmap_entry *
 ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
 		    uint16_t ip6port,
@@ -137,7 +321,8 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
   printf("lookup ip4port %d ip6port %d\n", uip_htons(ip4port),
 	 uip_htons(ip6port));
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
+  for(m = *tuple_bucket(ip6addr, ip6port, ip4addr, ip4port, protocol);
+      m != NULL; m = m->hash_next) {
     printf("protocol %d %d, ip4port %d %d, ip6port %d %d, ip4 %d ip6 %d\n",
 	   m->protocol, protocol,
 	   m->ip4port, ip4port,
@@ -149,6 +334,11 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
        m->ip6port == ip6port &&
        uip_ip4addr_cmp(&m->ip4addr, ip4addr) &&
        uip_ip6addr_cmp(&m->ip6addr, ip6addr)) {
+      if(timer_expired(&m->timer)) {
+        /* The timer wheel has not reached this entry yet. */
+        remove_entry(m);
+        return NULL;
+      }
       m->ip6to4++;
       return m;
     }
@@ -162,17 +352,15 @@ ip64_addrmap_lookup_port(uint16_t mapped_port, uint8_t protocol)
   struct ip64_addrmap_entry *m;
 
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
-    printf("mapped port %d %d, protocol %d %d\n",
-	   m->mapped_port, mapped_port,
-	   m->protocol, protocol);
-    if(m->mapped_port == mapped_port &&
-       m->protocol == protocol) {
-      m->ip4to6++;
-      return m;
+  m = find_port(mapped_port, protocol, 0);
+  if(m != NULL) {
+    if(timer_expired(&m->timer)) {
+      remove_entry(m);
+      return NULL;
     }
+    m->ip4to6++;
   }
-  return NULL;
+  return m;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -190,13 +378,17 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint8_t protocol)
 {
   struct ip64_addrmap_entry *m;
+  struct ip64_addrmap_entry **bucket;
 
   check_age();
   m = memb_alloc(&entrymemb);
   if(m == NULL) {
-    /* We could not allocate an entry, try to recycle one and try to
-       allocate again. */
-    if(recycle()) {
+    /* We could not allocate an entry, throw away the expired ones
+       that the timer wheel has not reached yet, or try to recycle one,
+       and try to allocate again. */
+    remove_expired();
+    m = memb_alloc(&entrymemb);
+    if(m == NULL && recycle()) {
       m = memb_alloc(&entrymemb);
     }
   }
@@ -214,22 +406,20 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
     /* Pick a new, unused local port. First make sure that the
        mapped_port number does not belong to any active connection. If
        so, we keep increasing the mapped_port until we're free. */
-    {
-      struct ip64_addrmap_entry *n;
-      n = list_head(entrylist);
-      while(n != NULL) {
-	if(n->mapped_port == mapped_port) {
-	  increase_mapped_port();
-	  n = list_head(entrylist);
-	} else {
-	  n = list_item_next(m);
-	}
-      }
+    while(find_port(mapped_port, protocol, 1) != NULL) {
+      increase_mapped_port();
     }
     m->mapped_port = mapped_port;
     increase_mapped_port();
 
     list_add(entrylist, m);
+    bucket = tuple_bucket(ip6addr, ip6port, ip4addr, ip4port, protocol);
+    m->hash_next = *bucket;
+    *bucket = m;
+    bucket = port_bucket(m->mapped_port);
+    m->port_next = *bucket;
+    *bucket = m;
+    wheel_add(m);
     return m;
   }
   return NULL;
@@ -240,7 +430,18 @@ ip64_addrmap_set_lifetime(struct ip64_addrmap_entry *e,
                           clock_time_t time)
 {
   if(e != NULL) {
-    timer_set(&e->timer, time);
+    if(timer_expired(&e->timer) || timer_remaining(&e->timer) <= time) {
+      /* The entry lives longer than before. It stays in its current
+         slot of the timer wheel, and is filed again when the wheel
+         reaches it. */
+      timer_set(&e->timer, time);
+    } else {
+      /* The entry expires earlier than before, so it must be moved to
+         an earlier slot. */
+      wheel_remove(e);
+      timer_set(&e->timer, time);
+      wheel_add(e);
+    }
   }
 }
 /*---------------------------------------------------------------------------*/
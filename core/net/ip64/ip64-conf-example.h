@@ -45,4 +45,13 @@
  * optional configuration parameter. The default value is set in ip64.h 
  */
 /* #define IP64_CONF_DHCP                      1 */
+
+/*
+ * The address map holds up to IP64_ADDRMAP_CONF_ENTRIES mappings and
+ * finds them through two hash tables of IP64_ADDRMAP_CONF_HASH_SIZE
+ * buckets (a power of two). Gateways with many nodes behind them may
+ * want to raise both. The defaults are set in ip64-addrmap.c
+ */
+/* #define IP64_ADDRMAP_CONF_ENTRIES           128 */
+/* #define IP64_ADDRMAP_CONF_HASH_SIZE         64 */
 #endif /* IP64_CONF_H */
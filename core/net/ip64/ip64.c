@@ -63,6 +63,7 @@
 #include "net/ipv6/uip-ds6.h"
 #include "ip64-ipv4-dhcp.h"
 #include "contiki-net.h"
+#include "net/ip/uip-chksum.h"
 
 #include "net/ip/uip-debug.h"
 
@@ -269,43 +270,45 @@ ip64_set_ipv6_address(const uip_ip6addr_t *addr)
 }
 /*---------------------------------------------------------------------------*/
 static uint16_t
-chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+ipv4_checksum(struct ipv4_hdr *hdr)
 {
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-
-  while(dataptr < last_byte) {	/* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-    dataptr += 2;
-  }
+  uint16_t sum;
 
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
+  sum = uip_chksum_add(0, (uint8_t *)hdr, IPV4_HDRLEN);
+  return (sum == 0) ? 0xffff : uip_htons(sum);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+ipv4_pseudo_header_sum(const struct ipv4_hdr *v4hdr,
+                       uint16_t transport_layer_len, uint8_t proto)
+{
+  uint16_t sum;
+
+  if(proto == IP_PROTO_ICMPV4) {
+    /* ping replies' checksums are calculated over the icmp-part only */
+    return 0;
   }
 
-  /* Return sum in host byte order. */
-  return sum;
+  /* IP protocol and length fields. This addition cannot carry. */
+  sum = transport_layer_len + proto;
+  /* Sum IP source and destination addresses. */
+  return uip_chksum_add(sum, (uint8_t *)&v4hdr->srcipaddr,
+                        2 * sizeof(uip_ip4addr_t));
 }
 /*---------------------------------------------------------------------------*/
 static uint16_t
-ipv4_checksum(struct ipv4_hdr *hdr)
+ipv6_pseudo_header_sum(const struct ipv6_hdr *v6hdr,
+                       uint16_t transport_layer_len, uint8_t proto)
 {
   uint16_t sum;
 
-  sum = chksum(0, (uint8_t *)hdr, IPV4_HDRLEN);
-  return (sum == 0) ? 0xffff : uip_htons(sum);
+  /* IP protocol and length fields. This addition cannot carry. */
+  sum = transport_layer_len + proto;
+  /* Sum IP source and destination addresses. */
+  sum = uip_chksum_add(sum, (uint8_t *)&v6hdr->srcipaddr,
+                       sizeof(uip_ip6addr_t));
+  return uip_chksum_add(sum, (uint8_t *)&v6hdr->destipaddr,
+                        sizeof(uip_ip6addr_t));
 }
 /*---------------------------------------------------------------------------*/
 static uint16_t
@@ -318,19 +321,10 @@ ipv4_transport_checksum(const uint8_t *packet, uint16_t len, uint8_t proto)
   transport_layer_len = len - IPV4_HDRLEN;
 
   /* First sum pseudoheader. */
-
-  if(proto != IP_PROTO_ICMPV4) {
-    /* IP protocol and length fields. This addition cannot carry. */
-    sum = transport_layer_len + proto;
-    /* Sum IP source and destination addresses. */
-    sum = chksum(sum, (uint8_t *)&v4hdr->srcipaddr, 2 * sizeof(uip_ip4addr_t));
-  } else {
-    /* ping replies' checksums are calculated over the icmp-part only */
-    sum = 0;
-  }
+  sum = ipv4_pseudo_header_sum(v4hdr, transport_layer_len, proto);
 
   /* Sum transport layer header and data. */
-  sum = chksum(sum, &packet[IPV4_HDRLEN], transport_layer_len);
+  sum = uip_chksum_add(sum, &packet[IPV4_HDRLEN], transport_layer_len);
 
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
@@ -345,19 +339,37 @@ ipv6_transport_checksum(const uint8_t *packet, uint16_t len, uint8_t proto)
   transport_layer_len = len - IPV6_HDRLEN;
 
   /* First sum pseudoheader. */
-
-  /* IP protocol and length fields. This addition cannot carry. */
-  sum = transport_layer_len + proto;
-  /* Sum IP source and destination addresses. */
-  sum = chksum(sum, (uint8_t *)&v6hdr->srcipaddr, sizeof(uip_ip6addr_t));
-  sum = chksum(sum, (uint8_t *)&v6hdr->destipaddr, sizeof(uip_ip6addr_t));
+  sum = ipv6_pseudo_header_sum(v6hdr, transport_layer_len, proto);
 
   /* Sum transport layer header and data. */
-  sum = chksum(sum, &packet[IPV6_HDRLEN], transport_layer_len);
+  sum = uip_chksum_add(sum, &packet[IPV6_HDRLEN], transport_layer_len);
 
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Add the transport layer header fields that the translation may
+ * rewrite to a sum: the port numbers of TCP and UDP, and the type and
+ * code of ICMP. Everything else is copied verbatim, so the checksum of
+ * the translated packet can be derived from the original checksum
+ * without summing the payload again.
+ */
+static uint16_t
+translated_fields_sum(uint16_t sum, const uint8_t *transport_hdr,
+                      uint8_t proto)
+{
+  if(proto == IP_PROTO_TCP || proto == IP_PROTO_UDP) {
+    return uip_chksum_add(sum, transport_hdr, 4);
+  }
+  return uip_chksum_add(sum, transport_hdr, 2);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+update_checksum(uint16_t chksum, uint16_t old_sum, uint16_t new_sum)
+{
+  return uip_htons(uip_chksum_replace(uip_ntohs(chksum), old_sum, new_sum));
+}
+/*---------------------------------------------------------------------------*/
 int
 ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
 	  uint8_t *resultpacket)
@@ -369,9 +381,12 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
   struct icmpv4_hdr *icmpv4hdr;
   struct icmpv6_hdr *icmpv6hdr;
   uint16_t ipv6len, ipv4len;
+  uint16_t old_sum, new_sum;
+  uint8_t payload_rewritten;
   struct ip64_addrmap_entry *m;
 
   v6hdr = (struct ipv6_hdr *)ipv6packet;
+  payload_rewritten = 0;
   v4hdr = (struct ipv4_hdr *)resultpacket;
 
   if((v6hdr->len[0] << 8) + v6hdr->len[1] <= ipv6packet_len) {
@@ -425,13 +440,14 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
     PRINTF("ip64_6to4: TCP header\n");
     v4hdr->proto = IP_PROTO_TCP;
 
-    /* Compute and check the TCP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
+#if DEBUG
+    /* The TCP checksum is updated incrementally, so a corrupt
+       segment keeps a bad checksum and is caught by the receiver. */
     if(ipv6_transport_checksum(ipv6packet, ipv6len,
                                IP_PROTO_TCP) != 0xffff) {
-      PRINTF("Bad TCP checksum, dropping packet\n");
+      PRINTF("Bad TCP checksum\n");
     }
+#endif /* DEBUG */
 
     break;
 
@@ -446,14 +462,14 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
                       ipv6len - IPV6_HDRLEN - sizeof(struct udp_hdr),
                       (uint8_t *)udphdr + sizeof(struct udp_hdr),
                       BUFSIZE - IPV4_HDRLEN - sizeof(struct udp_hdr));
+      payload_rewritten = 1;
     }
-    /* Compute and check the UDP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
+#if DEBUG
     if(ipv6_transport_checksum(ipv6packet, ipv6len,
                                IP_PROTO_UDP) != 0xffff) {
-      PRINTF("Bad UDP checksum, dropping packet\n");
+      PRINTF("Bad UDP checksum\n");
     }
+#endif /* DEBUG */
     break;
 
   case IP_PROTO_ICMPV6:
@@ -614,27 +630,41 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
 
 
 
+  /* Only the pseudo header and a few header fields differ between
+     the two packets, so we update the transport layer checksum
+     incrementally (RFC 1624) instead of summing the whole payload
+     again. */
+  old_sum = ipv6_pseudo_header_sum(v6hdr, ipv6len - IPV6_HDRLEN,
+                                   v6hdr->nxthdr);
+  old_sum = translated_fields_sum(old_sum, &ipv6packet[IPV6_HDRLEN],
+                                  v6hdr->nxthdr);
+  new_sum = ipv4_pseudo_header_sum(v4hdr, ipv4len - IPV4_HDRLEN,
+                                   v4hdr->proto);
+  new_sum = translated_fields_sum(new_sum, &resultpacket[IPV4_HDRLEN],
+                                  v4hdr->proto);
+
   /* The checksum is in different places in the different protocol
      headers, so we need to be sure that we update the correct
      field. */
   switch(v4hdr->proto) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum = update_checksum(tcphdr->tcpchksum, old_sum, new_sum);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_UDP));
+    if(payload_rewritten) {
+      udphdr->udpchksum = 0;
+      udphdr->udpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
+                                                    IP_PROTO_UDP));
+    } else {
+      udphdr->udpchksum = update_checksum(udphdr->udpchksum, old_sum, new_sum);
+    }
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
     break;
   case IP_PROTO_ICMPV4:
-    icmpv4hdr->icmpchksum = 0;
-    icmpv4hdr->icmpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						      IP_PROTO_ICMPV4));
+    icmpv4hdr->icmpchksum = update_checksum(icmpv4hdr->icmpchksum,
+                                            old_sum, new_sum);
     break;
 
   default:
@@ -658,9 +688,12 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
   struct icmpv4_hdr *icmpv4hdr;
   struct icmpv6_hdr *icmpv6hdr;
   uint16_t ipv4len, ipv6len, ipv6_packet_len;
+  uint16_t old_sum, new_sum;
+  uint8_t payload_rewritten;
   struct ip64_addrmap_entry *m;
 
   v6hdr = (struct ipv6_hdr *)resultpacket;
+  payload_rewritten = 0;
   v4hdr = (struct ipv4_hdr *)ipv4packet;
 
   if((v4hdr->len[0] << 8) + v4hdr->len[1] <= ipv4packet_len) {
@@ -741,7 +774,7 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
       v6hdr->len[0] = ipv6_packet_len >> 8;
       v6hdr->len[1] = ipv6_packet_len & 0xff;
       ipv6len = ipv6_packet_len + IPV6_HDRLEN;
-
+      payload_rewritten = 1;
     }
     break;
 
@@ -849,31 +882,43 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
     }
   }
 
+  /* Update the transport layer checksum incrementally, as in
+     ip64_6to4(). */
+  old_sum = ipv4_pseudo_header_sum(v4hdr, ipv4len - IPV4_HDRLEN,
+                                   v4hdr->proto);
+  old_sum = translated_fields_sum(old_sum, &ipv4packet[IPV4_HDRLEN],
+                                  v4hdr->proto);
+  new_sum = ipv6_pseudo_header_sum(v6hdr, ipv6len - IPV6_HDRLEN,
+                                   v6hdr->nxthdr);
+  new_sum = translated_fields_sum(new_sum, &resultpacket[IPV6_HDRLEN],
+                                  v6hdr->nxthdr);
+
   /* The checksum is in different places in the different protocol
      headers, so we need to be sure that we update the correct
      field. */
   switch(v6hdr->nxthdr) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum = update_checksum(tcphdr->tcpchksum, old_sum, new_sum);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_UDP));
+    /* A zero IPv4 UDP checksum means that the sender did not compute
+       one, but IPv6 requires it. */
+    if(payload_rewritten || udphdr->udpchksum == 0) {
+      udphdr->udpchksum = 0;
+      udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
+                                                    ipv6len,
+                                                    IP_PROTO_UDP));
+    } else {
+      udphdr->udpchksum = update_checksum(udphdr->udpchksum, old_sum, new_sum);
+    }
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
     break;
 
   case IP_PROTO_ICMPV6:
-    icmpv6hdr->icmpchksum = 0;
-    icmpv6hdr->icmpchksum = ~(ipv6_transport_checksum(resultpacket,
-                                                ipv6len,
-                                                IP_PROTO_ICMPV6));
+    icmpv6hdr->icmpchksum = update_checksum(icmpv6hdr->icmpchksum,
+                                            old_sum, new_sum);
     break;
   default:
     PRINTF("ip64_4to6: transport protocol %d not implemented\n", v4hdr->proto);
@@ -74,11 +74,13 @@
 #include "sys/cc.h"
 #include "net/ip/uip.h"
 #include "net/ip/uip_arch.h"
+#include "net/ip/uip-chksum.h"
 #include "net/ip/uipopt.h"
 #include "net/ipv6/uip-icmp6.h"
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
+#include "lib/memb.h"
 
 #if UIP_CONF_IPV6_RPL
 #include "rpl/rpl.h"
@@ -257,6 +259,26 @@ static uint8_t iss[4];
 
 /* Temporary variables. */
 uint8_t uip_acc32[4];
+
+#if UIP_TCP_SEND_WINDOW > 1
+/* A copy of a segment in flight, kept until it is acknowledged. */
+struct uip_tcp_rtx_seg {
+  struct uip_tcp_rtx_seg *next;
+  uint16_t len;
+  uint8_t data[UIP_TCP_MSS];
+};
+MEMB(rtx_segs, struct uip_tcp_rtx_seg, UIP_TCP_RTX_SEGMENTS);
+
+uint16_t uip_acklen;
+
+/* Set when the oldest segment in flight is to be retransmitted in
+   response to the incoming segment, instead of sending new data. */
+static uint8_t rtx_pending;
+
+/* The sequence number of the outgoing segment, relative to the
+   oldest unacknowledged byte in snd_nxt. */
+static uint16_t snd_offset;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 #endif /* UIP_TCP */
 /** @} */
 
@@ -318,45 +340,108 @@ uip_add32(uint8_t *op32, uint16_t op16)
   }
 }
 #endif /* UIP_ARCH_ADD32 */
-#endif /* UIP_TCP */
+#if UIP_TCP_SEND_WINDOW > 1
+/*---------------------------------------------------------------------------*/
+static uint8_t
+rtx_count(struct uip_conn *conn)
+{
+  struct uip_tcp_rtx_seg *seg;
+  uint8_t n;
 
-#if ! UIP_ARCH_CHKSUM
+  n = 0;
+  for(seg = conn->rtxq; seg != NULL; seg = seg->next) {
+    n++;
+  }
+  return n;
+}
 /*---------------------------------------------------------------------------*/
-static uint16_t
-chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+static void
+rtx_flush(struct uip_conn *conn)
+{
+  struct uip_tcp_rtx_seg *seg;
+
+  while(conn->rtxq != NULL) {
+    seg = conn->rtxq;
+    conn->rtxq = seg->next;
+    memb_free(&rtx_segs, seg);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Remove acknowledged data from the front of the retransmission queue. */
+static void
+rtx_ack(struct uip_conn *conn, uint16_t len)
 {
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-
-  while(dataptr < last_byte) {   /* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
+  struct uip_tcp_rtx_seg *seg;
+
+  while(len > 0 && conn->rtxq != NULL) {
+    seg = conn->rtxq;
+    if(len < seg->len) {
+      /* The peer acknowledged part of a segment. */
+      memmove(seg->data, &seg->data[len], seg->len - len);
+      seg->len -= len;
+      return;
     }
-    dataptr += 2;
+    len -= seg->len;
+    conn->rtxq = seg->next;
+    memb_free(&rtx_segs, seg);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+seq_to_u32(const uint8_t *seq)
+{
+  return ((uint32_t)seq[0] << 24) | ((uint32_t)seq[1] << 16) |
+    ((uint32_t)seq[2] << 8) | seq[3];
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * If the application has sent data that did not fit in the send
+ * window, and the window has opened since, we ask the application to
+ * send it again, as if it had been lost.
+ */
+static void
+rexmit_rejected(struct uip_conn *conn)
+{
+  if((conn->tcpstateflags & UIP_SEND_REJECTED) && uip_sendwnd() > 0) {
+    conn->tcpstateflags &= ~UIP_SEND_REJECTED;
+    uip_flags |= UIP_REXMIT;
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_sendwnd(void)
+{
+  uint16_t wnd;
+
+  if(uip_conn == NULL ||
+     (uip_conn->tcpstateflags & UIP_TS_MASK) != UIP_ESTABLISHED ||
+     (uip_conn->tcpstateflags & UIP_CLOSE_PENDING) ||
+     rtx_pending ||
+     rtx_count(uip_conn) >= UIP_TCP_SEND_WINDOW ||
+     memb_numfree(&rtx_segs) == 0) {
+    return 0;
   }
 
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
-    }
+  if(uip_conn->snd_wnd == 0) {
+    /* Probe a zero window with a single segment. */
+    return uip_outstanding(uip_conn) ? 0 : uip_conn->mss;
   }
 
-  /* Return sum in host byte order. */
-  return sum;
+  if(uip_conn->len >= uip_conn->snd_wnd) {
+    return 0;
+  }
+  wnd = uip_conn->snd_wnd - uip_conn->len;
+  return wnd < uip_conn->mss ? wnd : uip_conn->mss;
 }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+#endif /* UIP_TCP */
+
+#if ! UIP_ARCH_CHKSUM
 /*---------------------------------------------------------------------------*/
 uint16_t
 uip_chksum(uint16_t *data, uint16_t len)
 {
-  return uip_htons(chksum(0, (uint8_t *)data, len));
+  return uip_htons(uip_chksum_add(0, (uint8_t *)data, len));
 }
 /*---------------------------------------------------------------------------*/
 #ifndef UIP_ARCH_IPCHKSUM
@@ -365,7 +450,7 @@ uip_ipchksum(void)
 {
   uint16_t sum;
 
-  sum = chksum(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
+  sum = uip_chksum_add(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
   PRINTF("uip_ipchksum: sum 0x%04x\n", sum);
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
@@ -395,10 +480,10 @@ upper_layer_chksum(uint8_t proto)
   /* IP protocol and length fields. This addition cannot carry. */
   sum = upper_layer_len + proto;
   /* Sum IP source and destination addresses. */
-  sum = chksum(sum, (uint8_t *)&UIP_IP_BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+  sum = uip_chksum_add(sum, (uint8_t *)&UIP_IP_BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
 
   /* Sum TCP header and data. */
-  sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + uip_ext_len],
+  sum = uip_chksum_add(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + uip_ext_len],
                upper_layer_len);
 
   return (sum == 0) ? 0xffff : uip_htons(sum);
@@ -428,6 +513,98 @@ uip_udpchksum(void)
 #endif /* UIP_UDP && UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+#if UIP_CONN_HASH_SIZE
+#if (UIP_CONN_HASH_SIZE & (UIP_CONN_HASH_SIZE - 1)) || UIP_CONN_HASH_SIZE > 128
+#error UIP_CONF_CONN_HASH_SIZE must be a power of two no larger than 128
+#endif
+#if UIP_CONNS >= 255 || UIP_UDP_CONNS >= 255
+#error UIP_CONF_CONN_HASH_SIZE requires fewer than 255 connections
+#endif
+
+/* Marks the end of a hash chain, and connections that are not in any
+   chain. */
+#define CONN_HASH_NONE 0xff
+
+/* The connection hash index consists of one chain of table indices
+   per bucket. Connections that are closed or removed are not unlinked
+   right away; they are skipped by the lookups, which always check all
+   fields, and are moved to their new chain when the table entry is
+   reused. */
+#if UIP_TCP
+static uint8_t tcp_hash_head[UIP_CONN_HASH_SIZE];
+static uint8_t tcp_hash_next[UIP_CONNS];
+static uint8_t tcp_hash_bucket[UIP_CONNS];
+#endif /* UIP_TCP */
+#if UIP_UDP
+static uint8_t udp_hash_head[UIP_CONN_HASH_SIZE];
+static uint8_t udp_hash_next[UIP_UDP_CONNS];
+static uint8_t udp_hash_bucket[UIP_UDP_CONNS];
+#endif /* UIP_UDP */
+/*---------------------------------------------------------------------------*/
+static uint8_t
+conn_hash(uint16_t lport, uint16_t rport, const uip_ipaddr_t *ripaddr)
+{
+  uint16_t h;
+
+  h = lport ^ rport;
+  if(ripaddr != NULL) {
+    h ^= ripaddr->u16[6] ^ ripaddr->u16[7];
+  }
+  h ^= h >> 8;
+  return h & (UIP_CONN_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+conn_hash_init(uint8_t *head, uint8_t *bucket, int conns)
+{
+  memset(head, CONN_HASH_NONE, UIP_CONN_HASH_SIZE);
+  memset(bucket, CONN_HASH_NONE, conns);
+}
+/*---------------------------------------------------------------------------*/
+static void
+conn_hash_insert(uint8_t *head, uint8_t *next, uint8_t *bucket,
+                 uint8_t c, uint8_t b)
+{
+  uint8_t *p;
+
+  if(bucket[c] != CONN_HASH_NONE) {
+    for(p = &head[bucket[c]]; *p != CONN_HASH_NONE; p = &next[*p]) {
+      if(*p == c) {
+        *p = next[c];
+        break;
+      }
+    }
+  }
+
+  /* Keep the chain sorted by table index, so that a lookup finds the
+     same connection as a linear scan of the table would. */
+  for(p = &head[b]; *p != CONN_HASH_NONE && *p < c; p = &next[*p]);
+  next[c] = *p;
+  *p = c;
+  bucket[c] = b;
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP
+static void
+tcp_hash_insert(struct uip_conn *conn)
+{
+  conn_hash_insert(tcp_hash_head, tcp_hash_next, tcp_hash_bucket,
+                   conn - uip_conns,
+                   conn_hash(conn->lport, conn->rport, &conn->ripaddr));
+}
+#endif /* UIP_TCP */
+/*---------------------------------------------------------------------------*/
+#if UIP_UDP
+void
+uip_udp_bind_hashed(struct uip_udp_conn *conn, uint16_t port)
+{
+  conn->lport = port;
+  conn_hash_insert(udp_hash_head, udp_hash_next, udp_hash_bucket,
+                   conn - uip_udp_conns, conn_hash(port, 0, NULL));
+}
+#endif /* UIP_UDP */
+#endif /* UIP_CONN_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -443,7 +620,16 @@ uip_init(void)
   }
   for(c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SEND_WINDOW > 1
+    uip_conns[c].rtxq = NULL;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
   }
+#if UIP_TCP_SEND_WINDOW > 1
+  memb_init(&rtx_segs);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+#if UIP_CONN_HASH_SIZE
+  conn_hash_init(tcp_hash_head, tcp_hash_bucket, UIP_CONNS);
+#endif /* UIP_CONN_HASH_SIZE */
 #endif /* UIP_TCP */
 
 #if UIP_ACTIVE_OPEN || UIP_UDP
@@ -454,6 +640,9 @@ uip_init(void)
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     uip_udp_conns[c].lport = 0;
   }
+#if UIP_CONN_HASH_SIZE
+  conn_hash_init(udp_hash_head, udp_hash_bucket, UIP_UDP_CONNS);
+#endif /* UIP_CONN_HASH_SIZE */
 #endif /* UIP_UDP */
 
 #if UIP_IPV6_MULTICAST
@@ -506,6 +695,11 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   }
 
   conn->tcpstateflags = UIP_SYN_SENT;
+#if UIP_TCP_SEND_WINDOW > 1
+  rtx_flush(conn);
+  conn->snd_wnd = 0;
+  conn->dupacks = 0;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   conn->snd_nxt[0] = iss[0];
   conn->snd_nxt[1] = iss[1];
@@ -528,6 +722,9 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->lport = uip_htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_insert(conn);
+#endif /* UIP_CONN_HASH_SIZE */
 
   return conn;
 }
@@ -572,11 +769,22 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     lastport = 4096;
   }
 
+#if UIP_CONN_HASH_SIZE
+  /* All connections with a non-zero local port are in the chain of
+     that port, so only that chain needs to be checked. */
+  for(c = udp_hash_head[conn_hash(uip_htons(lastport), 0, NULL)];
+      c != CONN_HASH_NONE; c = udp_hash_next[c]) {
+    if(uip_udp_conns[c].lport == uip_htons(lastport)) {
+      goto again;
+    }
+  }
+#else /* UIP_CONN_HASH_SIZE */
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     if(uip_udp_conns[c].lport == uip_htons(lastport)) {
       goto again;
     }
   }
+#endif /* UIP_CONN_HASH_SIZE */
 
   conn = 0;
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
@@ -590,7 +798,7 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     return 0;
   }
 
-  conn->lport = UIP_HTONS(lastport);
+  uip_udp_bind(conn, UIP_HTONS(lastport));
   conn->rport = rport;
   if(ripaddr == NULL) {
     memset(&conn->ripaddr, 0, sizeof(uip_ipaddr_t));
@@ -944,11 +1152,22 @@ ext_hdr_options_process(void)
 void
 uip_process(uint8_t flag)
 {
-#if UIP_TCP
+#if UIP_TCP || UIP_CONN_HASH_SIZE
   int c;
+#endif /* UIP_TCP || UIP_CONN_HASH_SIZE */
+#if UIP_TCP
   uint16_t tmp16;
   uint8_t opt;
   register struct uip_conn *uip_connr = uip_conn;
+#if UIP_TCP_SEND_WINDOW > 1
+  struct uip_tcp_rtx_seg *seg;
+  uint32_t acked;
+  uint8_t recovering;
+
+  rtx_pending = 0;
+  snd_offset = 0;
+  uip_acklen = 0;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 #endif /* UIP_TCP */
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
@@ -962,8 +1181,17 @@ uip_process(uint8_t flag)
   if(flag == UIP_POLL_REQUEST) {
 #if UIP_TCP
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+#if UIP_TCP_SEND_WINDOW > 1
+       (uip_connr->rtxq != NULL ? uip_sendwnd() > 0 :
+        !uip_outstanding(uip_connr))) {
+#else /* UIP_TCP_SEND_WINDOW > 1 */
        !uip_outstanding(uip_connr)) {
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+      uip_slen = 0;
       uip_flags = UIP_POLL;
+#if UIP_TCP_SEND_WINDOW > 1
+      rexmit_rejected(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
       UIP_APPCALL();
       goto appsend;
 #if UIP_ACTIVE_OPEN
@@ -1016,6 +1244,9 @@ uip_process(uint8_t flag)
                uip_connr->tcpstateflags == UIP_SYN_RCVD) &&
               uip_connr->nrtx == UIP_MAXSYNRTX)) {
             uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SEND_WINDOW > 1
+            rtx_flush(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
             /*
              * We call UIP_APPCALL() with uip_flags set to
@@ -1058,6 +1289,14 @@ uip_process(uint8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
 
           case UIP_ESTABLISHED:
+#if UIP_TCP_SEND_WINDOW > 1
+            /*
+             * We have a copy of the oldest segment in flight, so we
+             * retransmit it without involving the application.
+             */
+            uip_connr->dupacks = 0;
+            goto rtx_send;
+#else /* UIP_TCP_SEND_WINDOW > 1 */
             /*
              * In the ESTABLISHED state, we call upon the application
              * to do the actual retransmit after which we jump into
@@ -1067,6 +1306,7 @@ uip_process(uint8_t flag)
             uip_flags = UIP_REXMIT;
             UIP_APPCALL();
             goto apprexmit;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
           case UIP_FIN_WAIT_1:
           case UIP_CLOSING:
@@ -1081,6 +1321,9 @@ uip_process(uint8_t flag)
          * application for new data.
          */
         uip_flags = UIP_POLL;
+#if UIP_TCP_SEND_WINDOW > 1
+        rexmit_rejected(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
         UIP_APPCALL();
         goto appsend;
       }
@@ -1514,9 +1757,15 @@ uip_process(uint8_t flag)
   }
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_CONN_HASH_SIZE
+  for(c = udp_hash_head[conn_hash(UIP_UDP_BUF->destport, 0, NULL)];
+      c != CONN_HASH_NONE; c = udp_hash_next[c]) {
+    uip_udp_conn = &uip_udp_conns[c];
+#else /* UIP_CONN_HASH_SIZE */
   for(uip_udp_conn = &uip_udp_conns[0];
       uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
       ++uip_udp_conn) {
+#endif /* UIP_CONN_HASH_SIZE */
     /* If the local UDP port is non-zero, the connection is considered
        to be used. If so, the local port number is checked against the
        destination port number in the received packet. If the two port
@@ -1618,8 +1867,15 @@ uip_process(uint8_t flag)
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_CONN_HASH_SIZE
+  for(c = tcp_hash_head[conn_hash(UIP_TCP_BUF->destport, UIP_TCP_BUF->srcport,
+                                  &UIP_IP_BUF->srcipaddr)];
+      c != CONN_HASH_NONE; c = tcp_hash_next[c]) {
+    uip_connr = &uip_conns[c];
+#else /* UIP_CONN_HASH_SIZE */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
+#endif /* UIP_CONN_HASH_SIZE */
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
        UIP_TCP_BUF->destport == uip_connr->lport &&
        UIP_TCP_BUF->srcport == uip_connr->rport &&
@@ -1742,7 +1998,15 @@ uip_process(uint8_t flag)
   uip_connr->lport = UIP_TCP_BUF->destport;
   uip_connr->rport = UIP_TCP_BUF->srcport;
   uip_ipaddr_copy(&uip_connr->ripaddr, &UIP_IP_BUF->srcipaddr);
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_insert(uip_connr);
+#endif /* UIP_CONN_HASH_SIZE */
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
+#if UIP_TCP_SEND_WINDOW > 1
+  rtx_flush(uip_connr);
+  uip_connr->snd_wnd = 0;
+  uip_connr->dupacks = 0;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   uip_connr->snd_nxt[0] = iss[0];
   uip_connr->snd_nxt[1] = iss[1];
@@ -1823,6 +2087,9 @@ uip_process(uint8_t flag)
      before we accept the reset. */
   if(UIP_TCP_BUF->flags & TCP_RST) {
     uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SEND_WINDOW > 1
+    rtx_flush(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
     UIP_LOG("tcp: got reset, aborting connection.");
     uip_flags = UIP_ABORT;
     UIP_APPCALL();
@@ -1868,6 +2135,67 @@ uip_process(uint8_t flag)
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
+#if UIP_TCP_SEND_WINDOW > 1
+  /* With a send window, an ACK may cover any number of the segments
+     in flight, as the peer may acknowledge only every other segment
+     (delayed ACKs) or lose some of its ACKs. We advance snd_nxt by
+     the number of bytes acknowledged, and count duplicate ACKs for
+     fast retransmit. */
+  if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
+    acked = seq_to_u32(UIP_TCP_BUF->ackno) - seq_to_u32(uip_connr->snd_nxt);
+    tmp16 = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + (uint16_t)UIP_TCP_BUF->wnd[1];
+    if(acked > 0 && acked <= uip_connr->len) {
+      uip_add32(uip_connr->snd_nxt, (uint16_t)acked);
+      uip_connr->snd_nxt[0] = uip_acc32[0];
+      uip_connr->snd_nxt[1] = uip_acc32[1];
+      uip_connr->snd_nxt[2] = uip_acc32[2];
+      uip_connr->snd_nxt[3] = uip_acc32[3];
+
+      /* Do RTT estimation, unless we have done retransmissions. */
+      if(uip_connr->nrtx == 0) {
+        signed char m;
+        m = uip_connr->rto - uip_connr->timer;
+        /* This is taken directly from VJs original code in his paper */
+        m = m - (uip_connr->sa >> 3);
+        uip_connr->sa += m;
+        if(m < 0) {
+          m = -m;
+        }
+        m = m - (uip_connr->sv >> 2);
+        uip_connr->sv += m;
+        uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
+      }
+
+      recovering = uip_connr->nrtx > 0 ||
+        uip_connr->dupacks >= UIP_TCP_DUPACK_THRESHOLD;
+      uip_connr->nrtx = 0;
+      uip_connr->dupacks = 0;
+
+      rtx_ack(uip_connr, (uint16_t)acked);
+      uip_connr->len -= (uint16_t)acked;
+      uip_acklen = (uint16_t)acked;
+      uip_flags = UIP_ACKDATA;
+      uip_connr->timer = uip_connr->rto;
+
+      /* A partial ACK after a retransmission means that the next
+         segment was lost as well. */
+      if(recovering && uip_connr->rtxq != NULL) {
+        rtx_pending = 1;
+      }
+    } else if(acked == 0 && uip_connr->rtxq != NULL && uip_len == 0 &&
+              (UIP_TCP_BUF->flags & (TCP_SYN | TCP_FIN)) == 0 &&
+              tmp16 == uip_connr->snd_wnd) {
+      if(++uip_connr->dupacks == UIP_TCP_DUPACK_THRESHOLD) {
+        UIP_STAT(++uip_stat.tcp.rexmit);
+        rtx_pending = 1;
+      }
+    }
+  }
+  if(UIP_TCP_BUF->flags & TCP_ACK) {
+    uip_connr->snd_wnd = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) +
+      (uint16_t)UIP_TCP_BUF->wnd[1];
+  }
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1906,6 +2234,7 @@ uip_process(uint8_t flag)
     }
 
   }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   /* Do different things depending on in what state the connection is. */
   switch(uip_connr->tcpstateflags & UIP_TS_MASK) {
@@ -2093,8 +2422,17 @@ uip_process(uint8_t flag)
          put into the uip_appdata and the length of the data should be
          put into uip_len. If the application don't have any data to
          send, uip_len must be set to 0. */
+#if UIP_TCP_SEND_WINDOW > 1
+    /* A duplicate ACK may have triggered a fast retransmit. */
+    if(rtx_pending && !(uip_flags & (UIP_NEWDATA | UIP_ACKDATA))) {
+      goto rtx_send;
+    }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
     if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA)) {
       uip_slen = 0;
+#if UIP_TCP_SEND_WINDOW > 1
+      rexmit_rejected(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
       UIP_APPCALL();
 
       appsend:
@@ -2102,10 +2440,26 @@ uip_process(uint8_t flag)
       if(uip_flags & UIP_ABORT) {
         uip_slen = 0;
         uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SEND_WINDOW > 1
+        rtx_flush(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
         UIP_TCP_BUF->flags = TCP_RST | TCP_ACK;
         goto tcp_send_nodata;
       }
 
+#if UIP_TCP_SEND_WINDOW > 1
+      /* The FIN can only be sent once all data in flight has been
+         acknowledged, so we defer the close until then. */
+      if(uip_connr->tcpstateflags & UIP_CLOSE_PENDING) {
+        uip_flags |= UIP_CLOSE;
+      }
+      if((uip_flags & UIP_CLOSE) && uip_connr->rtxq != NULL) {
+        uip_connr->tcpstateflags |= UIP_CLOSE_PENDING;
+        uip_flags &= ~UIP_CLOSE;
+        uip_slen = 0;
+      }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
       if(uip_flags & UIP_CLOSE) {
         uip_slen = 0;
         uip_connr->len = 1;
@@ -2115,6 +2469,64 @@ uip_process(uint8_t flag)
         goto tcp_send_nodata;
       }
 
+#if UIP_TCP_SEND_WINDOW > 1
+      /* The application cannot send more than what fits into the
+         send window and the receiver's window. Data that does not
+         fit is not sent at all, and rexmit_rejected() asks the
+         application for it again when the window has opened. */
+      if(uip_slen > 0 && (rtx_pending || uip_slen > uip_sendwnd())) {
+        uip_connr->tcpstateflags |= UIP_SEND_REJECTED;
+        uip_slen = 0;
+      }
+
+      if(rtx_pending) {
+        goto rtx_send;
+      }
+
+      if(uip_slen > 0) {
+        /* Keep a copy of the segment until it has been acknowledged. */
+        seg = memb_alloc(&rtx_segs);
+        memcpy(seg->data, uip_sappdata, uip_slen);
+        seg->len = uip_slen;
+        seg->next = NULL;
+        if(uip_connr->rtxq == NULL) {
+          uip_connr->rtxq = seg;
+        } else {
+          struct uip_tcp_rtx_seg *last;
+          for(last = uip_connr->rtxq; last->next != NULL; last = last->next);
+          last->next = seg;
+        }
+
+        /* The new segment starts after the data already in flight. */
+        snd_offset = uip_connr->len;
+        uip_connr->len += uip_slen;
+
+        uip_appdata = uip_sappdata;
+        uip_len = uip_slen + UIP_TCPIP_HLEN;
+        UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+        goto tcp_send_noopts;
+      }
+
+      if(uip_flags & UIP_NEWDATA) {
+        snd_offset = uip_connr->len;
+        uip_len = UIP_TCPIP_HLEN;
+        UIP_TCP_BUF->flags = TCP_ACK;
+        goto tcp_send_noopts;
+      }
+      goto drop;
+
+      rtx_send:
+      /* Retransmit the oldest segment in flight from our copy. */
+      seg = uip_connr->rtxq;
+      if(seg == NULL) {
+        goto drop;
+      }
+      memcpy(&uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN], seg->data, seg->len);
+      snd_offset = 0;
+      uip_len = seg->len + UIP_TCPIP_HLEN;
+      UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+      goto tcp_send_noopts;
+#else /* UIP_TCP_SEND_WINDOW > 1 */
       /* If uip_slen > 0, the application has data to be sent. */
       if(uip_slen > 0) {
 
@@ -2168,6 +2580,7 @@ uip_process(uint8_t flag)
         UIP_TCP_BUF->flags = TCP_ACK;
         goto tcp_send_noopts;
       }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
     }
     goto drop;
   case UIP_LAST_ACK:
@@ -2241,6 +2654,12 @@ uip_process(uint8_t flag)
      to set the appropriate TCP sequence numbers in the TCP header. */
   tcp_send_ack:
   UIP_TCP_BUF->flags = TCP_ACK;
+#if UIP_TCP_SEND_WINDOW > 1
+  /* Pure ACKs carry the sequence number of the next new byte. */
+  if(uip_connr->rtxq != NULL) {
+    snd_offset = uip_connr->len;
+  }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   tcp_send_nodata:
   uip_len = UIP_IPTCPH_LEN;
@@ -2260,10 +2679,18 @@ uip_process(uint8_t flag)
   UIP_TCP_BUF->ackno[2] = uip_connr->rcv_nxt[2];
   UIP_TCP_BUF->ackno[3] = uip_connr->rcv_nxt[3];
 
+#if UIP_TCP_SEND_WINDOW > 1
+  uip_add32(uip_connr->snd_nxt, snd_offset);
+  UIP_TCP_BUF->seqno[0] = uip_acc32[0];
+  UIP_TCP_BUF->seqno[1] = uip_acc32[1];
+  UIP_TCP_BUF->seqno[2] = uip_acc32[2];
+  UIP_TCP_BUF->seqno[3] = uip_acc32[3];
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   UIP_TCP_BUF->seqno[0] = uip_connr->snd_nxt[0];
   UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
   UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
   UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   UIP_TCP_BUF->srcport  = uip_connr->lport;
   UIP_TCP_BUF->destport = uip_connr->rport;
@@ -82,8 +82,43 @@ anti_replay_init_info(struct anti_replay_info *info)
   info->last_broadcast_counter
       = info->last_unicast_counter
       = anti_replay_get_counter();
+#if ANTI_REPLAY_WINDOW_SIZE
+  info->broadcast_window = info->unicast_window = 1;
+#endif /* ANTI_REPLAY_WINDOW_SIZE */
 }
 /*---------------------------------------------------------------------------*/
+#if ANTI_REPLAY_WINDOW_SIZE
+static int
+was_replayed(uint32_t received_counter,
+    uint32_t *last_counter, anti_replay_bitmap_t *window)
+{
+  uint32_t diff;
+  
+  if(received_counter > *last_counter) {
+    /* slide the window forward */
+    diff = received_counter - *last_counter;
+    if(diff >= ANTI_REPLAY_WINDOW_SIZE) {
+      *window = 1;
+    } else {
+      *window = (*window << diff) | 1;
+    }
+    *last_counter = received_counter;
+    return 0;
+  }
+  
+  diff = *last_counter - received_counter;
+  if(diff >= ANTI_REPLAY_WINDOW_SIZE) {
+    /* too old to tell */
+    return 1;
+  }
+  if(*window & ((anti_replay_bitmap_t)1 << diff)) {
+    return 1;
+  }
+  *window |= (anti_replay_bitmap_t)1 << diff;
+  return 0;
+}
+#endif /* ANTI_REPLAY_WINDOW_SIZE */
+/*---------------------------------------------------------------------------*/
 int
 anti_replay_was_replayed(struct anti_replay_info *info)
 {
@@ -91,6 +126,15 @@ anti_replay_was_replayed(struct anti_replay_info *info)
   
   received_counter = anti_replay_get_counter();
   
+#if ANTI_REPLAY_WINDOW_SIZE
+  if(packetbuf_holds_broadcast()) {
+    return was_replayed(received_counter,
+        &info->last_broadcast_counter, &info->broadcast_window);
+  } else {
+    return was_replayed(received_counter,
+        &info->last_unicast_counter, &info->unicast_window);
+  }
+#else /* ANTI_REPLAY_WINDOW_SIZE */
   if(packetbuf_holds_broadcast()) {
     /* broadcast */
     if(received_counter <= info->last_broadcast_counter) {
@@ -108,6 +152,7 @@ anti_replay_was_replayed(struct anti_replay_info *info)
       return 0;
     }
   }
+#endif /* ANTI_REPLAY_WINDOW_SIZE */
 }
 /*---------------------------------------------------------------------------*/
 #endif /* LLSEC802154_USES_FRAME_COUNTER */
@@ -47,9 +47,40 @@
 
 #include "contiki.h"
 
+/*
+ * Size of the sliding anti-replay window in frames. With a window of
+ * 0, only frames with a counter greater than the last seen one are
+ * accepted. With a window of N (at most 64), frames up to N - 1
+ * counter values older than the last seen one are accepted as long
+ * as they have not been received before. This tolerates frames that
+ * are reordered by retransmissions or LIFO queueing at the sender.
+ */
+#ifdef ANTI_REPLAY_CONF_WINDOW_SIZE
+#define ANTI_REPLAY_WINDOW_SIZE ANTI_REPLAY_CONF_WINDOW_SIZE
+#else /* ANTI_REPLAY_CONF_WINDOW_SIZE */
+#define ANTI_REPLAY_WINDOW_SIZE 0
+#endif /* ANTI_REPLAY_CONF_WINDOW_SIZE */
+
+#if ANTI_REPLAY_WINDOW_SIZE > 64
+#error "ANTI_REPLAY_CONF_WINDOW_SIZE must not exceed 64"
+#elif ANTI_REPLAY_WINDOW_SIZE > 32
+typedef uint64_t anti_replay_bitmap_t;
+#elif ANTI_REPLAY_WINDOW_SIZE > 16
+typedef uint32_t anti_replay_bitmap_t;
+#elif ANTI_REPLAY_WINDOW_SIZE > 8
+typedef uint16_t anti_replay_bitmap_t;
+#else
+typedef uint8_t anti_replay_bitmap_t;
+#endif
+
 struct anti_replay_info {
   uint32_t last_broadcast_counter;
   uint32_t last_unicast_counter;
+#if ANTI_REPLAY_WINDOW_SIZE
+  /* Bit i is set if last_*_counter - i has been received */
+  anti_replay_bitmap_t broadcast_window;
+  anti_replay_bitmap_t unicast_window;
+#endif /* ANTI_REPLAY_WINDOW_SIZE */
 };
 
 /**
@@ -43,6 +43,8 @@
 
 #include "sys/ctimer.h"
 #include "sys/clock.h"
+#include "sys/energest.h"
+#include "sys/trace.h"
 
 #include "lib/random.h"
 
@@ -130,6 +132,8 @@ MEMB(packet_memb, struct rdc_buf_list, MAX_QUEUED_PACKETS);
 MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
 LIST(neighbor_list);
 
+#define QUEUED_PACKETS() (MAX_QUEUED_PACKETS - memb_numfree(&packet_memb))
+
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
 /*---------------------------------------------------------------------------*/
@@ -173,7 +177,9 @@ transmit_packet_list(void *ptr)
       PRINTF("csma: preparing number %d %p, queue len %d\n", n->transmissions, q,
           list_length(n->queued_packet_list));
       /* Send packets in the neighbor's list */
+      ENERGEST_MAC_ON(ENERGEST_MAC_CONTENTION_TX);
       NETSTACK_RDC.send_list(packet_sent, n, q);
+      ENERGEST_MAC_OFF();
     }
   }
 }
@@ -191,6 +197,7 @@ schedule_transmission(struct neighbor_queue *n)
   if(delay > 0) {
     /* Pick a time for next transmission */
     delay = random_rand() % delay;
+    ENERGEST_MAC_ON(ENERGEST_MAC_BACKOFF);
   }
 
   PRINTF("csma: scheduling transmission in %u ticks, NB=%u, BE=%u\n",
@@ -210,6 +217,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
     memb_free(&packet_memb, p);
     PRINTF("csma: free_queued_packet, queue length %d, free packets %d\n",
            list_length(n->queued_packet_list), memb_numfree(&packet_memb));
+    TRACE_QUEUE(TRACE_QUEUE_CSMA, QUEUED_PACKETS());
     if(list_head(n->queued_packet_list) != NULL) {
       /* There is a next packet. We reset current tx information */
       n->transmissions = 0;
@@ -219,6 +227,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
     } else {
       /* This was the last packet in the queue, we free the neighbor */
       ctimer_stop(&n->transmit_timer);
+      ENERGEST_MAC_OFF();
       list_remove(neighbor_list, n);
       memb_free(&neighbor_memb, n);
     }
@@ -252,6 +261,7 @@ tx_done(int status, struct rdc_buf_list *q, struct neighbor_queue *n)
     break;
   }
 
+  TRACE_PACKET_TX(&n->addr, packetbuf_totlen(), status, ntx);
   free_packet(n, q, status);
   mac_call_sent_callback(sent, cptr, status, ntx);
 }
@@ -433,6 +443,7 @@ send_packet(mac_callback_t sent, void *ptr)
 
             PRINTF("csma: send_packet, queue length %d, free packets %d\n",
                    list_length(n->queued_packet_list), memb_numfree(&packet_memb));
+            TRACE_QUEUE(TRACE_QUEUE_CSMA, QUEUED_PACKETS());
             /* If q is the first packet in the neighbor's queue, send asap */
             if(list_head(n->queued_packet_list) == q) {
               schedule_transmission(n);
@@ -446,16 +457,19 @@ send_packet(mac_callback_t sent, void *ptr)
         PRINTF("csma: could not allocate queuebuf, dropping packet\n");
       }
       /* The packet allocation failed. Remove and free neighbor entry if empty. */
+      TRACE_PACKET_DROP(addr, packetbuf_totlen(), TRACE_DROP_NO_BUFFER);
       if(list_length(n->queued_packet_list) == 0) {
         list_remove(neighbor_list, n);
         memb_free(&neighbor_memb, n);
       }
     } else {
       PRINTF("csma: Neighbor queue full\n");
+      TRACE_PACKET_DROP(addr, packetbuf_totlen(), TRACE_DROP_QUEUE_FULL);
     }
     PRINTF("csma: could not allocate packet, dropping packet\n");
   } else {
     PRINTF("csma: could not allocate neighbor, dropping packet\n");
+    TRACE_PACKET_DROP(addr, packetbuf_totlen(), TRACE_DROP_NO_BUFFER);
   }
   mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
 }
@@ -463,6 +477,8 @@ send_packet(mac_callback_t sent, void *ptr)
 static void
 input_packet(void)
 {
+  TRACE_PACKET_RX(packetbuf_addr(PACKETBUF_ADDR_SENDER), packetbuf_datalen(),
+                  (int8_t)packetbuf_attr(PACKETBUF_ATTR_RSSI));
   NETSTACK_LLSEC.input();
 }
 /*---------------------------------------------------------------------------*/
@@ -16,6 +16,8 @@
 #include "net/netstack.h"
 #include "sys/ctimer.h"
 #include "sys/clock.h"
+#include "sys/energest.h"
+#include "sys/trace.h"
 
 #include <string.h>
 
@@ -77,6 +79,15 @@ linkaddr_t beacon_node;
 static struct ctimer slot_timer;
 uint8_t timer_on = 0;
 
+/*---------------------------------------------------------------------------*/
+/* Called by the RDC layer once the frame is out, with the frame in the
+   packetbuf */
+static void
+packet_sent(void *ptr, int status, int num_tx)
+{
+	TRACE_PACKET_TX(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), packetbuf_totlen(),
+			status, num_tx);
+}
 /*---------------------------------------------------------------------------*/
 static struct send_packet_data {
 	mac_callback_t sent;
@@ -112,7 +123,9 @@ transmit_packet(void *ptr)
 	if(now < slot_start || now > slot_start + SLOT_LENGTH - GUARD_PERIOD) {
 		PRINTF("TIMER We are outside our slot: %lu != [%lu,%lu]\n", now, slot_start, slot_start + SLOT_LENGTH);
 		if ((now >= slot_start - PRE_GUARD_PERIOD) && (now < slot_start + SLOT_LENGTH - GUARD_PERIOD)) {
+			ENERGEST_MAC_ON(ENERGEST_MAC_GUARD);
 			while (clock_time() < slot_start) {} // just wait for the slot
+			ENERGEST_MAC_OFF();
 		} else {
 			while(now > slot_start + SLOT_LENGTH - GUARD_PERIOD) {
 				slot_start += PERIOD_LENGTH;
@@ -125,12 +138,19 @@ transmit_packet(void *ptr)
 
 	if(clock_time() > slot_start + SLOT_LENGTH - GUARD_PERIOD) {
 		PRINTF("TIMER No more time to transmit\n");
+		if (packet_queued_flag) {
+			TRACE_SLOT(MY_SLOT, 0, TRACE_SLOT_SKIP);
+		}
 	} else {
 		if (packet_queued_flag) {
 			queuebuf_to_packetbuf(queued_packet);
 			PRINTF("TIMER In slot and transmitting\n");
-			NETSTACK_RDC.send(NULL, NULL);
+			TRACE_SLOT(MY_SLOT, 0, TRACE_SLOT_TX);
+			ENERGEST_MAC_ON(ENERGEST_MAC_SLOT_TX);
+			NETSTACK_RDC.send(packet_sent, NULL);
+			ENERGEST_MAC_OFF();
 			packet_queued_flag = 0;
+			TRACE_QUEUE(TRACE_QUEUE_TDMA, 0);
 		}
 	}
 	slot_start += PERIOD_LENGTH;
@@ -145,16 +165,22 @@ send_packet(mac_callback_t sent, void *ptr)
 	p.ptr = ptr;
 	// Step 1: Cleanup the queuebuf
 	if (packet_queued_flag) {
+		TRACE_PACKET_DROP(queuebuf_addr(queued_packet, PACKETBUF_ADDR_RECEIVER),
+				queuebuf_datalen(queued_packet), TRACE_DROP_QUEUE_FULL);
 		queuebuf_free(queued_packet);
 		packet_queued_flag = 0;
 	}
 	// Step 2: Copy the packetbuf to the queued packet
 	queued_packet = queuebuf_new_from_packetbuf();
 	if (queued_packet == NULL) {
+		TRACE_PACKET_DROP(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+				packetbuf_totlen(), TRACE_DROP_NO_BUFFER);
 		packet_queued_flag = 0;
 		sent(ptr, MAC_TX_ERR, 1);
+		return;
 	}
 	packet_queued_flag = 1;
+	TRACE_QUEUE(TRACE_QUEUE_TDMA, 1);
 	// Step 3: Start transmission
 	if (!timer_on)
 	  {
@@ -173,11 +199,16 @@ packet_input(void)
 	if ((packetbuf_holds_broadcast() && strcmp((char *) packetbuf_dataptr(), "TDMABeacon")) &&
 			linkaddr_cmp(&beacon_node, packetbuf_addr(PACKETBUF_ADDR_SENDER)))
 	{
+		if (beacon_received_flag == BEACON_NOT_RECEIVED) {
+			ENERGEST_MAC_OFF(); // synchronized, stop charging the beacon wait
+		}
 		beacon_received_flag = BEACON_RECEIVED;
 		last_beacon_receive_time = clock_time();
 		PRINTF("TDMA Beacon: Received TDMA Beacon, setting receive time to %lu\n", last_beacon_receive_time);
 	} else {
 		PRINTF("LLSec input\n");
+		TRACE_PACKET_RX(packetbuf_addr(PACKETBUF_ADDR_SENDER), packetbuf_datalen(),
+				(int8_t)packetbuf_attr(PACKETBUF_ATTR_RSSI));
 		NETSTACK_LLSEC.input();
 	}
 }
@@ -216,6 +247,8 @@ init(void)
 		broadcast_open(&beacon_broadcast, 129, &beacon_broadcast_call);
 		clock_time_t next_beacon_time = BEACON_INITIAL_PERIOD;
 		ctimer_set(&beacon_timer, next_beacon_time, _send_beacon, NULL);
+	} else {
+		ENERGEST_MAC_ON(ENERGEST_MAC_BEACON_RX);
 	}
 }
 
@@ -54,6 +54,7 @@
 #include "net/mac/tsch/tsch-packet.h"
 #include "net/mac/tsch/tsch-security.h"
 #include "net/mac/tsch/tsch-adaptive-timesync.h"
+#include "sys/trace.h"
 #if CONTIKI_TARGET_COOJA || CONTIKI_TARGET_COOJA_IP64
 #include "lib/simEnvChange.h"
 #include "sys/cooja_mt.h"
@@ -953,6 +954,8 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
                             tsch_lock_requested,
                             current_link == NULL);
       );
+      TRACE_SLOT(current_link != NULL ? current_link->timeslot : 0xffff,
+                 0, TRACE_SLOT_SKIP);
 
     } else {
       int is_active_slot;
@@ -974,6 +977,7 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
         /* Hop channel */
         current_channel = tsch_calculate_channel(&tsch_current_asn, current_link->channel_offset);
         NETSTACK_RADIO.set_value(RADIO_PARAM_CHANNEL, current_channel);
+        ENERGEST_MAC_CHANNEL(current_channel);
         /* Turn the radio on already here if configured so; necessary for radios with slow startup */
         tsch_radio_on(TSCH_RADIO_CMD_ON_START_OF_TIMESLOT);
         /* Decide whether it is a TX/RX/IDLE or OFF slot */
@@ -985,10 +989,15 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
            * 3. post tx callback
            **/
           static struct pt slot_tx_pt;
+          TRACE_SLOT(current_link->timeslot, current_channel, TRACE_SLOT_TX);
+          ENERGEST_MAC_ON((current_link->link_options & LINK_OPTION_SHARED) ?
+                          ENERGEST_MAC_CONTENTION_TX : ENERGEST_MAC_SLOT_TX);
           PT_SPAWN(&slot_operation_pt, &slot_tx_pt, tsch_tx_slot(&slot_tx_pt, t));
+          ENERGEST_MAC_OFF();
         } else {
           /* Listen */
           static struct pt slot_rx_pt;
+          TRACE_SLOT(current_link->timeslot, current_channel, TRACE_SLOT_RX);
           PT_SPAWN(&slot_operation_pt, &slot_rx_pt, tsch_rx_slot(&slot_rx_pt, t));
         }
       }
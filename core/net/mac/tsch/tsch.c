@@ -56,6 +56,7 @@
 #include "net/mac/tsch/tsch-security.h"
 #include "net/mac/mac-sequence.h"
 #include "lib/random.h"
+#include "sys/trace.h"
 
 #if FRAME802154_VERSION < FRAME802154_IEEE802154E_2012
 #error TSCH: FRAME802154_VERSION must be at least FRAME802154_IEEE802154E_2012
@@ -383,6 +384,8 @@ tsch_tx_process_pending()
     struct tsch_packet *p = dequeued_array[dequeued_index];
     /* Put packet into packetbuf for packet_sent callback */
     queuebuf_to_packetbuf(p->qb);
+    TRACE_PACKET_TX(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), packetbuf_totlen(),
+                    p->ret, p->transmissions);
     /* Call packet_sent callback */
     mac_call_sent_callback(p->sent, p->ptr, p->ret, p->transmissions);
     /* Free packet queuebuf */
@@ -613,6 +616,7 @@ PT_THREAD(tsch_scan(struct pt *pt))
 
   etimer_set(&scan_timer, CLOCK_SECOND / TSCH_ASSOCIATION_POLL_FREQUENCY);
   current_channel_since = clock_time();
+  ENERGEST_MAC_ON(ENERGEST_MAC_BEACON_RX);
 
   while(!tsch_is_associated && !tsch_is_coordinator) {
     /* Hop to any channel offset */
@@ -630,6 +634,7 @@ PT_THREAD(tsch_scan(struct pt *pt))
           random_rand() % sizeof(TSCH_JOIN_HOPPING_SEQUENCE)];
       if(current_channel != scan_channel) {
         NETSTACK_RADIO.set_value(RADIO_PARAM_CHANNEL, scan_channel);
+        ENERGEST_MAC_CHANNEL(scan_channel);
         current_channel = scan_channel;
         PRINTF("TSCH: scanning on channel %u\n", scan_channel);
       }
@@ -668,6 +673,7 @@ PT_THREAD(tsch_scan(struct pt *pt))
       PT_WAIT_UNTIL(pt, etimer_expired(&scan_timer));
     }
   }
+  ENERGEST_MAC_OFF();
 
   PT_END(pt);
 }
@@ -876,6 +882,7 @@ send_packet(mac_callback_t sent, void *ptr)
     } else {
       PRINTF("TSCH:! not associated, drop outgoing packet\n");
     }
+    TRACE_PACKET_DROP(addr, packetbuf_totlen(), TRACE_DROP_NO_LINK);
     ret = MAC_TX_ERR;
     mac_call_sent_callback(sent, ptr, ret, 1);
     return;
@@ -931,6 +938,7 @@ send_packet(mac_callback_t sent, void *ptr)
           TSCH_LOG_ID_FROM_LINKADDR(addr), tsch_packet_seqno,
           packet_count_before,
           tsch_queue_packet_count(addr));
+      TRACE_PACKET_DROP(addr, packetbuf_totlen(), TRACE_DROP_QUEUE_FULL);
       ret = MAC_TX_ERR;
     } else {
       p->header_len = hdr_len;
@@ -941,6 +949,7 @@ send_packet(mac_callback_t sent, void *ptr)
              p->header_len,
              queuebuf_datalen(p->qb));
       (void)packet_count_before; /* Discard "variable set but unused" warning in case of TSCH_LOG_LEVEL of 0 */
+      TRACE_QUEUE(TRACE_QUEUE_TSCH, tsch_queue_packet_count(addr));
     }
   }
   if(ret != MAC_TX_DEFERRED) {
@@ -957,6 +966,7 @@ packet_input(void)
 
   if(frame_parsed < 0) {
     PRINTF("TSCH:! failed to parse %u\n", packetbuf_datalen());
+    TRACE_PACKET_DROP(NULL, packetbuf_datalen(), TRACE_DROP_PARSE);
   } else {
     int duplicate = 0;
 
@@ -969,6 +979,8 @@ packet_input(void)
         PRINTF("TSCH:! drop dup ll from %u seqno %u\n",
                TSCH_LOG_ID_FROM_LINKADDR(packetbuf_addr(PACKETBUF_ADDR_SENDER)),
                packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO));
+        TRACE_PACKET_DROP(packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                          packetbuf_datalen(), TRACE_DROP_DUPLICATE);
       } else {
         mac_sequence_register_seqno();
       }
@@ -978,6 +990,8 @@ packet_input(void)
       PRINTF("TSCH: received from %u with seqno %u\n",
              TSCH_LOG_ID_FROM_LINKADDR(packetbuf_addr(PACKETBUF_ADDR_SENDER)),
              packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO));
+      TRACE_PACKET_RX(packetbuf_addr(PACKETBUF_ADDR_SENDER), packetbuf_datalen(),
+                      (int8_t)packetbuf_attr(PACKETBUF_ATTR_RSSI));
       NETSTACK_LLSEC.input();
     }
   }
@@ -52,6 +52,28 @@
 #define CHAMELEON_WITH_MAC_LINK_ADDRESSES 0
 #endif /* !CHAMELEON_CONF_WITH_MAC_LINK_ADDRESSES */
 
+/* The first time a channel sends or receives a packet, its attribute
+   list is compiled into a codec that holds the byte offset and bit
+   shift of every attribute in the header. Attributes that are whole
+   bytes or fit within two bytes are then packed and unpacked with
+   precomputed shifts instead of bit by bit. Channels that share an
+   attribute list share the codec. CHAMELEON_BITOPT_CODECS is the
+   number of distinct attribute lists that can be compiled, and
+   CHAMELEON_BITOPT_FIELDS the longest list that is compiled. Other
+   channels use the generic bit packing. Setting
+   CHAMELEON_BITOPT_CONF_CODECS to 0 disables the codecs. */
+#ifdef CHAMELEON_BITOPT_CONF_CODECS
+#define CHAMELEON_BITOPT_CODECS CHAMELEON_BITOPT_CONF_CODECS
+#else /* CHAMELEON_BITOPT_CONF_CODECS */
+#define CHAMELEON_BITOPT_CODECS 4
+#endif /* CHAMELEON_BITOPT_CONF_CODECS */
+
+#ifdef CHAMELEON_BITOPT_CONF_FIELDS
+#define CHAMELEON_BITOPT_FIELDS CHAMELEON_BITOPT_CONF_FIELDS
+#else /* CHAMELEON_BITOPT_CONF_FIELDS */
+#define CHAMELEON_BITOPT_FIELDS 12
+#endif /* CHAMELEON_BITOPT_CONF_FIELDS */
+
 struct bitopt_hdr {
   uint8_t channel[2];
 };
@@ -214,6 +236,168 @@ set_bits(uint8_t *ptr, int bitpos, uint8_t *val, int vallen)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if CHAMELEON_BITOPT_CODECS
+struct bitopt_field {
+  uint8_t type;
+  uint8_t offset;  /* Byte offset in the header */
+  uint8_t shift;   /* Bit position within the first byte */
+  uint8_t len;     /* Length in bits */
+};
+
+struct bitopt_codec {
+  const struct packetbuf_attrlist *attrlist;
+  uint8_t count;
+  struct bitopt_field fields[CHAMELEON_BITOPT_FIELDS];
+};
+
+static struct bitopt_codec codecs[CHAMELEON_BITOPT_CODECS];
+static uint8_t codec_count;
+
+/* Marks channels whose attribute list could not be compiled. */
+static const struct bitopt_codec no_codec;
+
+/*---------------------------------------------------------------------------*/
+static const struct bitopt_codec *
+codec_compile(const struct packetbuf_attrlist *a)
+{
+  struct bitopt_codec *codec;
+  struct bitopt_field *f;
+  int i, bitptr;
+
+  for(i = 0; i < codec_count; ++i) {
+    if(codecs[i].attrlist == a) {
+      return &codecs[i];
+    }
+  }
+  if(codec_count == CHAMELEON_BITOPT_CODECS) {
+    PRINTF("chameleon-bitopt: no room for another codec\n");
+    return &no_codec;
+  }
+
+  codec = &codecs[codec_count];
+  codec->attrlist = a;
+  codec->count = 0;
+  bitptr = 0;
+  for(; a->type != PACKETBUF_ATTR_NONE; ++a) {
+#if CHAMELEON_WITH_MAC_LINK_ADDRESSES
+    if(a->type == PACKETBUF_ADDR_SENDER ||
+       a->type == PACKETBUF_ADDR_RECEIVER) {
+      continue;
+    }
+#endif /* CHAMELEON_WITH_MAC_LINK_ADDRESSES */
+    if(codec->count == CHAMELEON_BITOPT_FIELDS || bitptr / 8 > 0xff) {
+      PRINTF("chameleon-bitopt: attribute list too long for a codec\n");
+      return &no_codec;
+    }
+    f = &codec->fields[codec->count++];
+    f->type = a->type;
+    f->offset = bitptr / 8;
+    f->shift = bitptr & 7;
+    f->len = a->len;
+    bitptr += a->len;
+  }
+  codec_count++;
+  return codec;
+}
+/*---------------------------------------------------------------------------*/
+static const struct bitopt_codec *
+channel_codec(struct channel *c)
+{
+  if(c->codec == NULL ||
+     (c->codec != &no_codec &&
+      ((const struct bitopt_codec *)c->codec)->attrlist != c->attrlist)) {
+    c->codec = codec_compile(c->attrlist);
+  }
+  return c->codec == &no_codec ? NULL : c->codec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+codec_pack(const struct bitopt_codec *codec, uint8_t *hdrptr)
+{
+  const struct bitopt_field *f;
+  const uint8_t *src;
+  uint8_t buffer[2];
+  uint8_t *p;
+  uint16_t shifted;
+  int i;
+
+  for(f = codec->fields; f < &codec->fields[codec->count]; ++f) {
+    p = &hdrptr[f->offset];
+    if(PACKETBUF_IS_ADDR(f->type)) {
+      src = (const uint8_t *)packetbuf_addr(f->type);
+    } else {
+      le16_write(buffer, packetbuf_attr(f->type));
+      src = buffer;
+    }
+
+    if(f->len < 8) {
+      shifted = (src[0] & ((1 << f->len) - 1)) << (16 - f->shift - f->len);
+      p[0] |= shifted >> 8;
+      if(f->shift + f->len > 8) {
+        p[1] |= shifted & 0xff;
+      }
+    } else if((f->len & 7) == 0) {
+      if(f->shift == 0) {
+        memcpy(p, src, f->len / 8);
+      } else {
+        for(i = 0; i < f->len / 8; ++i) {
+          p[i] |= src[i] >> f->shift;
+          p[i + 1] |= src[i] << (8 - f->shift);
+        }
+      }
+    } else {
+      set_bits(p, f->shift, (uint8_t *)src, f->len);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+codec_unpack(const struct bitopt_codec *codec, uint8_t *hdrptr)
+{
+  const struct bitopt_field *f;
+  linkaddr_t addr;
+  uint8_t buffer[2];
+  uint8_t *dst;
+  uint8_t *p;
+  uint16_t shifted;
+  int i;
+
+  for(f = codec->fields; f < &codec->fields[codec->count]; ++f) {
+    p = &hdrptr[f->offset];
+    if(PACKETBUF_IS_ADDR(f->type)) {
+      dst = addr.u8;
+    } else {
+      buffer[0] = buffer[1] = 0;
+      dst = buffer;
+    }
+
+    if(f->len < 8) {
+      shifted = p[0] << 8;
+      if(f->shift + f->len > 8) {
+        shifted |= p[1];
+      }
+      dst[0] = (shifted >> (16 - f->shift - f->len)) & ((1 << f->len) - 1);
+    } else if((f->len & 7) == 0) {
+      if(f->shift == 0) {
+        memcpy(dst, p, f->len / 8);
+      } else {
+        for(i = 0; i < f->len / 8; ++i) {
+          dst[i] = (p[i] << f->shift) | (p[i + 1] >> (8 - f->shift));
+        }
+      }
+    } else {
+      get_bits(dst, p, f->shift, f->len);
+    }
+
+    if(PACKETBUF_IS_ADDR(f->type)) {
+      packetbuf_set_addr(f->type, &addr);
+    } else {
+      packetbuf_set_attr(f->type, le16_read(buffer));
+    }
+  }
+}
+#endif /* CHAMELEON_BITOPT_CODECS */
+/*---------------------------------------------------------------------------*/
 #if 0
 static void
 printbin(int n, int digits)
@@ -260,7 +444,10 @@ pack_header(struct channel *c)
   int byteptr, bitptr, len;
   uint8_t *hdrptr;
   struct bitopt_hdr *hdr;
-  
+#if CHAMELEON_BITOPT_CODECS
+  const struct bitopt_codec *codec;
+#endif /* CHAMELEON_BITOPT_CODECS */
+
   /* Compute the total size of the final header by summing the size of
      all attributes that are used on this channel. */
 
@@ -275,7 +462,15 @@ pack_header(struct channel *c)
 
   hdrptr = ((uint8_t *)packetbuf_hdrptr()) + BITOPT_HDR_SIZE;
   memset(hdrptr, 0, hdrbytesize);
-  
+
+#if CHAMELEON_BITOPT_CODECS
+  codec = channel_codec(c);
+  if(codec != NULL) {
+    codec_pack(codec, hdrptr);
+    return 1; /* Send out packet */
+  }
+#endif /* CHAMELEON_BITOPT_CODECS */
+
   byteptr = bitptr = 0;
   
   for(a = c->attrlist; a->type != PACKETBUF_ATTR_NONE; ++a) {
@@ -326,7 +521,9 @@ unpack_header(void)
   uint8_t *hdrptr;
   struct bitopt_hdr *hdr;
   struct channel *c;
-  
+#if CHAMELEON_BITOPT_CODECS
+  const struct bitopt_codec *codec;
+#endif /* CHAMELEON_BITOPT_CODECS */
 
   /* The packet has a header that tells us what channel the packet is
      for. */
@@ -337,12 +534,12 @@ unpack_header(void)
   }
   PRINTF("Chameleon header %u %u\n",hdr->channel[1], hdr->channel[0]);
   c = channel_lookup((hdr->channel[1] << 8) + hdr->channel[0]);
-  PRINTF("Chameleon channel number %u\n", c->channelno);
   if(c == NULL) {
     PRINTF("chameleon-bitopt: input: channel %u not found\n",
            (hdr->channel[1] << 8) + hdr->channel[0]);
     return NULL;
   }
+  PRINTF("Chameleon channel number %u\n", c->channelno);
 
   hdrptr = packetbuf_dataptr();
   hdrbytesize = c->hdrsize / 8 + ((c->hdrsize & 7) == 0? 0: 1);
@@ -351,6 +548,15 @@ unpack_header(void)
     PRINTF("chameleon-bitopt: too short packet\n");
     return NULL;
   }
+
+#if CHAMELEON_BITOPT_CODECS
+  codec = channel_codec(c);
+  if(codec != NULL) {
+    codec_unpack(codec, hdrptr);
+    return c;
+  }
+#endif /* CHAMELEON_BITOPT_CODECS */
+
   byteptr = bitptr = 0;
   for(a = c->attrlist; a->type != PACKETBUF_ATTR_NONE; ++a) {
 #if CHAMELEON_WITH_MAC_LINK_ADDRESSES
@@ -41,13 +41,30 @@
 #include "net/rime/rime.h"
 #include "lib/list.h"
 
-LIST(channel_list);
+#include <string.h>
+
+/* Open channels are kept in a table of CHANNEL_HASH_SIZE buckets
+   (a power of two), indexed by the low bits of the channel number, so
+   that channel_lookup() does not have to walk every open channel for
+   each incoming packet. Nodes that listen to many channels, such as
+   gateways, may want to raise it. With a table at least as large as
+   the highest channel number in use, lookups are direct. */
+#ifdef CHANNEL_CONF_HASH_SIZE
+#define CHANNEL_HASH_SIZE CHANNEL_CONF_HASH_SIZE
+#else /* CHANNEL_CONF_HASH_SIZE */
+#define CHANNEL_HASH_SIZE 8
+#endif /* CHANNEL_CONF_HASH_SIZE */
+
+#define CHANNEL_BUCKET(channelno) \
+  ((list_t)&channel_table[(channelno) & (CHANNEL_HASH_SIZE - 1)])
+
+static void *channel_table[CHANNEL_HASH_SIZE];
 
 /*---------------------------------------------------------------------------*/
 void
 channel_init(void)
 {
-  list_init(channel_list);
+  memset(channel_table, 0, sizeof(channel_table));
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -58,6 +75,7 @@ channel_set_attributes(uint16_t channelno,
   c = channel_lookup(channelno);
   if(c != NULL) {
     c->attrlist = attrlist;
+    c->codec = NULL;
     c->hdrsize = chameleon_hdrsize(attrlist);
   }
 }
@@ -66,20 +84,22 @@ void
 channel_open(struct channel *c, uint16_t channelno)
 {
   c->channelno = channelno;
-  list_add(channel_list, c);
+  c->codec = NULL;
+  list_add(CHANNEL_BUCKET(channelno), c);
 }
 /*---------------------------------------------------------------------------*/
 void
 channel_close(struct channel *c)
 {
-  list_remove(channel_list, c);
+  list_remove(CHANNEL_BUCKET(c->channelno), c);
 }
 /*---------------------------------------------------------------------------*/
 struct channel *
 channel_lookup(uint16_t channelno)
 {
   struct channel *c;
-  for(c = list_head(channel_list); c != NULL; c = list_item_next(c)) {
+  for(c = list_head(CHANNEL_BUCKET(channelno));
+      c != NULL; c = list_item_next(c)) {
     if(c->channelno == channelno) {
       return c;
     }
@@ -50,6 +50,7 @@ struct channel {
   struct channel *next;
   uint16_t channelno;
   const struct packetbuf_attrlist *attrlist;
+  const void *codec;   /* Header codec cached by the Chameleon module */
   uint8_t hdrsize;
 };
 
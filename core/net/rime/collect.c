@@ -99,9 +99,12 @@ struct data_msg_hdr {
    (ACK_FLAGS_RTMETRIC_NEEDS_UPDATE). The flags can contain any
    combination of the flags. The ACK header also contains the routing
    metric of the node that sends tha ACK. This is used to keep an
-   up-to-date routing state in the network. */
+   up-to-date routing state in the network. The count field tells how
+   many packets the ACK acknowledges: the packet with the packet ID of
+   the ACK, and the count - 1 packets with the IDs before it. A count
+   of zero, which is what older nodes send, counts as one. */
 struct ack_msg {
-  uint8_t flags, dummy;
+  uint8_t flags, count;
   uint16_t rtmetric;
 };
 
@@ -141,6 +144,17 @@ struct ack_msg {
 #define KEEPALIVE_REXMITS          8
 #define MAX_REXMITS                31
 
+#define PACKET_ID_MASK             ((1 << COLLECT_PACKET_ID_BITS) - 1)
+
+/* BULK_ACK_TIME is for how long an ACK is held back, waiting to be
+   merged with the ACKs of the packets that follow. It must be well
+   below the retransmission timeout of the sender. */
+#ifdef COLLECT_CONF_BULK_ACK_TIME
+#define BULK_ACK_TIME COLLECT_CONF_BULK_ACK_TIME
+#else /* COLLECT_CONF_BULK_ACK_TIME */
+#define BULK_ACK_TIME (REXMIT_TIME / 8)
+#endif /* COLLECT_CONF_BULK_ACK_TIME */
+
 MEMB(send_queue_memb, struct packetqueue_item, MAX_SENDING_QUEUE);
 
 /* These specifiy the sink's routing metric (0) and the maximum
@@ -223,6 +237,9 @@ static void send_queued_packet(struct collect_conn *c);
 static void retransmit_callback(void *ptr);
 static void retransmit_not_sent_callback(void *ptr);
 static void set_keepalive_timer(struct collect_conn *c);
+#if COLLECT_WINDOW > 1
+static void send_window(struct collect_conn *c);
+#endif /* COLLECT_WINDOW > 1 */
 
 /*---------------------------------------------------------------------------*/
 /**
@@ -558,6 +575,29 @@ proactive_probing_callback(void *ptr)
   }
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * This function is called when there is a packet to send but no
+ * parent to send it to.
+ *
+ */
+static void
+request_route(struct collect_conn *c)
+{
+#if COLLECT_ANNOUNCEMENTS
+#if COLLECT_CONF_WITH_LISTEN
+  PRINTF("listen\n");
+  announcement_listen(1);
+  ctimer_set(&c->transmit_after_scan_timer, ANNOUNCEMENT_SCAN_TIME,
+             send_queued_packet, c);
+#else /* COLLECT_CONF_WITH_LISTEN */
+  if(c->is_router) {
+    announcement_set_value(&c->announcement, RTMETRIC_MAX);
+    announcement_bump(&c->announcement);
+  }
+#endif /* COLLECT_CONF_WITH_LISTEN */
+#endif /* COLLECT_ANNOUNCEMENTS */
+}
+/*---------------------------------------------------------------------------*/
 /**
  * This function is called when a queued packet should be sent
  * out. The function takes the first packet on the output queue, adds
@@ -574,6 +614,11 @@ send_queued_packet(struct collect_conn *c)
   struct data_msg_hdr hdr;
   int max_mac_rexmits;
 
+#if COLLECT_WINDOW > 1
+  send_window(c);
+  return;
+#endif /* COLLECT_WINDOW > 1 */
+
   /* If we are currently sending a packet, we do not attempt to send
      another one. */
   if(c->sending) {
@@ -651,19 +696,7 @@ send_queued_packet(struct collect_conn *c)
       send_packet(c, n);
 
     } else {
-#if COLLECT_ANNOUNCEMENTS
-#if COLLECT_CONF_WITH_LISTEN
-      PRINTF("listen\n");
-      announcement_listen(1);
-      ctimer_set(&c->transmit_after_scan_timer, ANNOUNCEMENT_SCAN_TIME,
-                 send_queued_packet, c);
-#else /* COLLECT_CONF_WITH_LISTEN */
-      if(c->is_router) {
-	announcement_set_value(&c->announcement, RTMETRIC_MAX);
-	announcement_bump(&c->announcement);
-      }
-#endif /* COLLECT_CONF_WITH_LISTEN */
-#endif /* COLLECT_ANNOUNCEMENTS */
+      request_route(c);
     }
   }
 }
@@ -774,12 +807,305 @@ send_next_packet(struct collect_conn *tc)
   send_queued_packet(tc);
 }
 /*---------------------------------------------------------------------------*/
+#if COLLECT_WINDOW > 1
+/**
+ * This function returns the queued packet at the given position in
+ * the window. Position zero is the first packet on the send queue.
+ *
+ */
+static struct packetqueue_item *
+window_item(struct collect_conn *c, int slot)
+{
+  struct packetqueue_item *i;
+
+  i = packetqueue_first(&c->send_queue);
+  while(i != NULL && slot-- > 0) {
+    i = list_item_next(i);
+  }
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+static int
+window_max_rexmits(struct collect_conn *c, int slot)
+{
+  struct packetqueue_item *i;
+
+  i = window_item(c, slot);
+  if(i == NULL || packetqueue_queuebuf(i) == NULL) {
+    return 0;
+  }
+  return queuebuf_attr(packetqueue_queuebuf(i), PACKETBUF_ATTR_MAX_REXMIT);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * This function sends the packet at the given position in the window
+ * to neighbor n. The packet ID is the sequence number of the first
+ * packet in the window plus the position.
+ *
+ */
+static void
+window_transmit(struct collect_conn *c, struct collect_neighbor *n, int slot)
+{
+  struct packetqueue_item *i;
+  struct queuebuf *q;
+  struct data_msg_hdr hdr;
+  int rexmits;
+
+  i = window_item(c, slot);
+  if(i == NULL || (q = packetqueue_queuebuf(i)) == NULL) {
+    return;
+  }
+  queuebuf_to_packetbuf(q);
+
+  PRINTF("%d.%d: window: sending packet %d with eseqno %d to %d.%d\n",
+         linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+         (c->seqno + slot) & PACKET_ID_MASK,
+         packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID),
+         n->addr.u8[0], n->addr.u8[1]);
+
+  rexmits = packetbuf_attr(PACKETBUF_ATTR_MAX_REXMIT) -
+    c->window_transmissions[slot];
+  packetbuf_set_attr(PACKETBUF_ATTR_RELIABLE, 1);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS,
+                     rexmits > MAX_MAC_REXMITS ? MAX_MAC_REXMITS : rexmits);
+  packetbuf_set_attr(PACKETBUF_ATTR_PACKET_ID,
+                     (c->seqno + slot) & PACKET_ID_MASK);
+
+  stats.datasent++;
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.rtmetric = c->rtmetric;
+  memcpy(packetbuf_dataptr(), &hdr, sizeof(struct data_msg_hdr));
+
+  /* As in send_packet(), the retransmission timer guards against a
+     MAC layer that does not call us back. Once the MAC has reported
+     on every packet in the window, node_packet_sent() replaces it
+     with the normal retransmission timer. */
+  if(c->sending == 0) {
+    ctimer_set(&c->retransmission_timer, 16 * REXMIT_TIME,
+               retransmit_not_sent_callback, c);
+  }
+  c->sending++;
+  c->send_time = clock_time();
+
+  unicast_send(&c->unicast_conn, &n->addr);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * This function sends queued packets until the window is full. New
+ * packets go to the parent that the packets already in flight were
+ * sent to. The parent is only switched when nothing is in flight, or
+ * when the window is retransmitted.
+ *
+ */
+static void
+send_window(struct collect_conn *c)
+{
+  struct collect_neighbor *n;
+  int slot;
+
+  if(window_item(c, c->inflight) == NULL) {
+    PRINTF("%d.%d: window: nothing more on queue\n",
+           linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1]);
+    return;
+  }
+
+  if(c->inflight == 0) {
+    linkaddr_copy(&c->current_parent, &c->parent);
+  }
+  n = collect_neighbor_list_find(&c->neighbor_list, &c->current_parent);
+  if(n == NULL && !linkaddr_cmp(&c->current_parent, &c->parent)) {
+    /* The parent that the window was sent to has been removed from
+       the neighbor list, so the packets in flight go to the new
+       parent instead, as in retransmit_window(). */
+    PRINTF("window: parent %d.%d gone, switching to %d.%d\n",
+           c->current_parent.u8[0], c->current_parent.u8[1],
+           c->parent.u8[0], c->parent.u8[1]);
+    linkaddr_copy(&c->current_parent, &c->parent);
+    memset(c->window_transmissions, 0, sizeof(c->window_transmissions));
+    n = collect_neighbor_list_find(&c->neighbor_list, &c->current_parent);
+  }
+  if(n == NULL) {
+    request_route(c);
+    return;
+  }
+
+  while(c->inflight < COLLECT_WINDOW &&
+        window_item(c, c->inflight) != NULL) {
+    /* The MAC layer may call node_packet_sent() before
+       unicast_send() returns, so the packet must be in the window
+       before it is sent. Packets in the window are identified by
+       their position on the queue, so their lifetime timer is
+       stopped: they are instead dropped by timedout(). */
+    slot = c->inflight++;
+    c->window_transmissions[slot] = 0;
+    ctimer_stop(&window_item(c, slot)->lifetimer);
+    window_transmit(c, n, slot);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * This function removes the acknowledged packets from the front of
+ * the window.
+ *
+ */
+static void
+window_advance(struct collect_conn *c)
+{
+  while(c->inflight > 0 && (c->acked & 1)) {
+    packetqueue_dequeue(&c->send_queue);
+    c->seqno = (c->seqno + 1) & PACKET_ID_MASK;
+    c->acked >>= 1;
+    c->inflight--;
+    memmove(&c->window_transmissions[0], &c->window_transmissions[1],
+            c->inflight);
+  }
+  if(c->inflight == 0 && c->sending == 0) {
+    ctimer_stop(&c->retransmission_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * This function retransmits the packets in the window that have not
+ * been acknowledged.
+ *
+ */
+static void
+retransmit_window(struct collect_conn *c)
+{
+  struct collect_neighbor *n;
+  int slot;
+
+  update_rtmetric(c);
+
+  /* If we have found a better parent, the unacknowledged packets go
+     there instead and their transmission counts start over. */
+  if(!linkaddr_cmp(&c->current_parent, &c->parent)) {
+    PRINTF("window: parent change from %d.%d to %d.%d\n",
+           c->current_parent.u8[0], c->current_parent.u8[1],
+           c->parent.u8[0], c->parent.u8[1]);
+    linkaddr_copy(&c->current_parent, &c->parent);
+    memset(c->window_transmissions, 0, sizeof(c->window_transmissions));
+  }
+  n = collect_neighbor_list_find(&c->neighbor_list, &c->current_parent);
+  if(n == NULL) {
+    /* We have no parent to send the window to. The attempt counts as
+       a failed transmission of the unacknowledged packets, so that
+       timedout() eventually drops them if no parent shows up, and
+       the retransmission timer is re-armed so that the window is not
+       left stuck with its packets' lifetime timers stopped. */
+    for(slot = 0; slot < c->inflight; ++slot) {
+      if((c->acked & (1 << slot)) == 0) {
+        c->window_transmissions[slot] += MAX_MAC_REXMITS + 1;
+      }
+    }
+    request_route(c);
+    ctimer_set(&c->retransmission_timer,
+               REXMIT_TIME + (random_rand() % (REXMIT_TIME)),
+               retransmit_callback, c);
+    return;
+  }
+  for(slot = 0; slot < c->inflight; ++slot) {
+    if((c->acked & (1 << slot)) == 0) {
+      window_transmit(c, n, slot);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_window_ack(struct collect_conn *tc, const struct ack_msg *msg)
+{
+  struct collect_neighbor *n;
+  uint8_t covered;
+  int count, slot, max_rexmits;
+
+  /* Find the packets in the window that the ACK covers and that have
+     not already been acknowledged. */
+  covered = 0;
+  if(linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                  &tc->current_parent)) {
+    for(count = msg->count == 0 ? 1 : msg->count; count > 0; --count) {
+      slot = (packetbuf_attr(PACKETBUF_ATTR_PACKET_ID) - (count - 1) -
+              tc->seqno) & PACKET_ID_MASK;
+      if(slot < tc->inflight) {
+        covered |= 1 << slot;
+      }
+    }
+  }
+  covered &= ~tc->acked;
+  if(covered == 0) {
+    stats.badack++;
+    return;
+  }
+  stats.ackrecv++;
+
+  n = collect_neighbor_list_find(&tc->neighbor_list,
+                                 packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  if(n != NULL) {
+    /* As in handle_ack(), a packet that was acknowledged before the
+       MAC layer reported it as sent counts as MAX_MAC_REXMITS
+       transmissions. */
+    for(slot = 0; slot < tc->inflight; ++slot) {
+      if(covered & (1 << slot)) {
+        collect_neighbor_tx(n, tc->window_transmissions[slot] == 0 ?
+                            MAX_MAC_REXMITS :
+                            tc->window_transmissions[slot]);
+      }
+    }
+    collect_neighbor_update_rtmetric(n, msg->rtmetric);
+    update_rtmetric(tc);
+  }
+
+  PRINTF("%d.%d: window: ACK %d count %d from %d.%d, flags %02x\n",
+         linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+         packetbuf_attr(PACKETBUF_ATTR_PACKET_ID), msg->count,
+         tc->current_parent.u8[0], tc->current_parent.u8[1],
+         msg->flags);
+
+  max_rexmits = window_max_rexmits(tc, 0);
+  if(msg->flags & ACK_FLAGS_CONGESTED) {
+    if(n != NULL) {
+      collect_neighbor_set_congested(n);
+      collect_neighbor_tx(n, max_rexmits * 2);
+    }
+    update_rtmetric(tc);
+  }
+  if((msg->flags & ACK_FLAGS_DROPPED) == 0 ||
+     (msg->flags & ACK_FLAGS_LIFETIME_EXCEEDED)) {
+    tc->acked |= covered;
+    window_advance(tc);
+    send_window(tc);
+  } else {
+    /* The parent dropped the packet: penalize it and let the
+       retransmission timer send the packet again. */
+    if(n != NULL) {
+      collect_neighbor_tx(n, max_rexmits);
+    }
+    update_rtmetric(tc);
+    ctimer_set(&tc->retransmission_timer,
+               REXMIT_TIME + (random_rand() % (REXMIT_TIME)),
+               retransmit_callback, tc);
+  }
+
+  if(msg->flags & ACK_FLAGS_RTMETRIC_NEEDS_UPDATE) {
+    bump_advertisement(tc);
+  }
+  set_keepalive_timer(tc);
+}
+#endif /* COLLECT_WINDOW > 1 */
+/*---------------------------------------------------------------------------*/
 static void
 handle_ack(struct collect_conn *tc)
 {
   struct ack_msg msg;
   struct collect_neighbor *n;
 
+#if COLLECT_WINDOW > 1
+  memcpy(&msg, packetbuf_dataptr(), sizeof(struct ack_msg));
+  handle_window_ack(tc, &msg);
+  return;
+#endif /* COLLECT_WINDOW > 1 */
+
   PRINTF("handle_ack: sender %d.%d current_parent %d.%d, id %d seqno %d\n",
          packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[0],
          packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[1],
@@ -874,10 +1200,10 @@ handle_ack(struct collect_conn *tc)
 }
 /*---------------------------------------------------------------------------*/
 static void
-send_ack(struct collect_conn *tc, const linkaddr_t *to, int flags)
+send_ack_msg(struct collect_conn *tc, const linkaddr_t *to,
+             uint16_t packet_seqno, uint8_t count, int flags)
 {
   struct ack_msg *ack;
-  uint16_t packet_seqno = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID);
 
   packetbuf_clear();
   packetbuf_set_datalen(sizeof(struct ack_msg));
@@ -885,6 +1211,7 @@ send_ack(struct collect_conn *tc, const linkaddr_t *to, int flags)
   memset(ack, 0, sizeof(struct ack_msg));
   ack->rtmetric = tc->rtmetric;
   ack->flags = flags;
+  ack->count = count;
 
   packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, to);
   packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE, PACKETBUF_ATTR_PACKET_TYPE_ACK);
@@ -903,6 +1230,66 @@ send_ack(struct collect_conn *tc, const linkaddr_t *to, int flags)
   stats.acksent++;
 }
 /*---------------------------------------------------------------------------*/
+#if COLLECT_BULK_ACK
+static void
+flush_ack(struct collect_conn *tc)
+{
+  uint8_t count;
+
+  if(tc->ack_count > 0) {
+    count = tc->ack_count;
+    tc->ack_count = 0;
+    ctimer_stop(&tc->ack_timer);
+    send_ack_msg(tc, &tc->ack_to, tc->ack_seqno, count, tc->ack_flags);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+ack_timer_callback(void *ptr)
+{
+  flush_ack(ptr);
+}
+#endif /* COLLECT_BULK_ACK */
+/*---------------------------------------------------------------------------*/
+/**
+ * This function acknowledges the packet in the packetbuf. With
+ * COLLECT_BULK_ACK, a positive ACK is held back for BULK_ACK_TIME
+ * and merged with the ACKs of the packets with the next packet IDs
+ * from the same neighbor, up to COLLECT_WINDOW packets. Sending an
+ * ACK overwrites the packetbuf.
+ *
+ */
+static void
+send_ack(struct collect_conn *tc, const linkaddr_t *to, int flags)
+{
+  uint16_t packet_seqno = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID);
+
+#if COLLECT_BULK_ACK
+  if((flags & ACK_FLAGS_DROPPED) == 0) {
+    if(tc->ack_count > 0 && linkaddr_cmp(&tc->ack_to, to) &&
+       packet_seqno == ((tc->ack_seqno + 1) & PACKET_ID_MASK)) {
+      tc->ack_seqno = packet_seqno;
+      tc->ack_flags |= flags;
+      tc->ack_count++;
+    } else {
+      flush_ack(tc);
+      linkaddr_copy(&tc->ack_to, to);
+      tc->ack_seqno = packet_seqno;
+      tc->ack_flags = flags;
+      tc->ack_count = 1;
+      ctimer_set(&tc->ack_timer, BULK_ACK_TIME, ack_timer_callback, tc);
+    }
+    if(tc->ack_count >= COLLECT_WINDOW) {
+      flush_ack(tc);
+    }
+    return;
+  }
+  flush_ack(tc);
+#endif /* COLLECT_BULK_ACK */
+
+  send_ack_msg(tc, to, packet_seqno, 1, flags);
+}
+/*---------------------------------------------------------------------------*/
 static void
 add_packet_to_recent_packets(struct collect_conn *tc)
 {
@@ -1115,6 +1502,22 @@ timedout(struct collect_conn *tc)
          tc->current_parent.u8[0], tc->current_parent.u8[1],
          tc->max_rexmits);
 
+#if COLLECT_WINDOW > 1
+  /* The first packet in the window is dropped. The other packets in
+     flight stay in the window. */
+  n = collect_neighbor_list_find(&tc->neighbor_list,
+                                 &tc->current_parent);
+  if(n != NULL) {
+    collect_neighbor_tx_fail(n, window_max_rexmits(tc, 0));
+  }
+  update_rtmetric(tc);
+  tc->acked |= 1;
+  window_advance(tc);
+  send_window(tc);
+  set_keepalive_timer(tc);
+  return;
+#endif /* COLLECT_WINDOW > 1 */
+
   tc->sending = 0;
   n = collect_neighbor_list_find(&tc->neighbor_list,
                                  &tc->current_parent);
@@ -1131,11 +1534,40 @@ node_packet_sent(struct unicast_conn *c, int status, int transmissions)
 {
   struct collect_conn *tc = (struct collect_conn *)
     ((char *)c - offsetof(struct collect_conn, unicast_conn));
+#if COLLECT_WINDOW > 1
+  int slot;
+#endif /* COLLECT_WINDOW > 1 */
 
   /* For data packets, we record the number of transmissions */
   if(packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) ==
      PACKETBUF_ATTR_PACKET_TYPE_DATA) {
 
+#if COLLECT_WINDOW > 1
+    /* The transmissions are recorded for the packet in the window
+       with this packet ID. When the MAC layer has reported on all
+       packets in the window, we either time out the first packet or
+       wait for the ACKs before retransmitting. */
+    slot = (packetbuf_attr(PACKETBUF_ATTR_PACKET_ID) - tc->seqno) &
+      PACKET_ID_MASK;
+    if(slot < tc->inflight) {
+      tc->window_transmissions[slot] += transmissions;
+    }
+    if(tc->sending > 0) {
+      tc->sending--;
+    }
+    if(tc->sending == 0 && tc->inflight > 0) {
+      if(tc->window_transmissions[0] >= window_max_rexmits(tc, 0)) {
+        timedout(tc);
+        stats.timedout++;
+      } else {
+        ctimer_set(&tc->retransmission_timer,
+                   REXMIT_TIME / 2 + (random_rand() % (REXMIT_TIME / 2)),
+                   retransmit_callback, tc);
+      }
+    }
+    return;
+#endif /* COLLECT_WINDOW > 1 */
+
     tc->transmissions += transmissions;
     PRINTF("tx %d\n", tc->transmissions);    
     PRINTF("%d.%d: MAC sent %d transmissions to %d.%d, status %d, total transmissions %d\n",
@@ -1169,6 +1601,12 @@ retransmit_not_sent_callback(void *ptr)
   struct collect_conn *c = ptr;
 
   PRINTF("retransmit not sent, %d transmissions\n", c->transmissions);
+#if COLLECT_WINDOW > 1
+  c->sending = 0;
+  if(c->inflight > 0) {
+    c->window_transmissions[0] += MAX_MAC_REXMITS + 1;
+  }
+#endif /* COLLECT_WINDOW > 1 */
   c->transmissions += MAX_MAC_REXMITS + 1;
   retransmit_callback(c);
 }
@@ -1186,6 +1624,18 @@ retransmit_callback(void *ptr)
   struct collect_conn *c = ptr;
 
   PRINTF("retransmit, %d transmissions\n", c->transmissions);
+#if COLLECT_WINDOW > 1
+  if(c->inflight == 0) {
+    return;
+  }
+  if(c->window_transmissions[0] >= window_max_rexmits(c, 0)) {
+    timedout(c);
+    stats.timedout++;
+  } else {
+    retransmit_window(c);
+  }
+  return;
+#endif /* COLLECT_WINDOW > 1 */
   if(c->transmissions >= c->max_rexmits) {
     timedout(c);
     stats.timedout++;
@@ -1306,6 +1756,13 @@ collect_open(struct collect_conn *tc, uint16_t channels,
   tc->is_router = is_router;
   tc->seqno = 10;
   tc->eseqno = 0;
+#if COLLECT_WINDOW > 1
+  tc->sending = 0;
+  tc->inflight = tc->acked = 0;
+#endif /* COLLECT_WINDOW > 1 */
+#if COLLECT_BULK_ACK
+  tc->ack_count = 0;
+#endif /* COLLECT_BULK_ACK */
   LIST_STRUCT_INIT(tc, send_queue_list);
   collect_neighbor_list_new(&tc->neighbor_list);
   tc->send_queue.list = &(tc->send_queue_list);
@@ -1386,6 +1843,14 @@ collect_close(struct collect_conn *tc)
   while(packetqueue_first(&tc->send_queue) != NULL) {
     packetqueue_dequeue(&tc->send_queue);
   }
+#if COLLECT_WINDOW > 1
+  ctimer_stop(&tc->retransmission_timer);
+  tc->inflight = tc->acked = 0;
+#endif /* COLLECT_WINDOW > 1 */
+#if COLLECT_BULK_ACK
+  ctimer_stop(&tc->ack_timer);
+  tc->ack_count = 0;
+#endif /* COLLECT_BULK_ACK */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -1404,6 +1869,9 @@ collect_set_sink(struct collect_conn *tc, int should_be_sink)
 
     /* Stop the retransmission timer. */
     ctimer_stop(&tc->retransmission_timer);
+#if COLLECT_WINDOW > 1
+    tc->inflight = tc->acked = 0;
+#endif /* COLLECT_WINDOW > 1 */
   } else {
     tc->rtmetric = RTMETRIC_MAX;
   }
@@ -91,6 +91,34 @@
 #define COLLECT_MAX_REXMIT_BITS 5
 #endif /* COLLECT_CONF_REXMIT_BITS */
 
+/* COLLECT_CONF_WINDOW is the number of packets that a node may have
+   in flight to its parent. With the default window of one packet, a
+   node waits for the ACK of each packet before it sends the next
+   one. With a larger window, forwarding is pipelined: queued packets
+   are sent back to back with consecutive packet IDs, each packet is
+   acknowledged on its own, and only the packets that have not been
+   acknowledged are retransmitted. The window can be at most 8
+   packets and at most half of the packet ID space. */
+#ifdef COLLECT_CONF_WINDOW
+#define COLLECT_WINDOW COLLECT_CONF_WINDOW
+#else /* COLLECT_CONF_WINDOW */
+#define COLLECT_WINDOW 1
+#endif /* COLLECT_CONF_WINDOW */
+
+#if COLLECT_WINDOW > 8 || COLLECT_WINDOW > (1 << (COLLECT_PACKET_ID_BITS - 1))
+#error COLLECT_CONF_WINDOW is too large
+#endif
+
+/* COLLECT_CONF_BULK_ACK makes a node hold back its ACKs for a short
+   while, so that packets that arrive back to back from the same
+   neighbor are acknowledged with a single ACK. This only pays off if
+   the neighbors use a window larger than one packet. */
+#ifdef COLLECT_CONF_BULK_ACK
+#define COLLECT_BULK_ACK COLLECT_CONF_BULK_ACK
+#else /* COLLECT_CONF_BULK_ACK */
+#define COLLECT_BULK_ACK 0
+#endif /* COLLECT_CONF_BULK_ACK */
+
 #define COLLECT_ATTRIBUTES  { PACKETBUF_ADDR_ESENDER,     PACKETBUF_ADDRSIZE }, \
                             { PACKETBUF_ATTR_EPACKET_ID,  PACKETBUF_ATTR_BIT * COLLECT_PACKET_ID_BITS }, \
                             { PACKETBUF_ATTR_PACKET_ID,   PACKETBUF_ATTR_BIT * COLLECT_PACKET_ID_BITS }, \
@@ -141,6 +169,21 @@ struct collect_conn {
   uint8_t is_router;
 
   clock_time_t send_time;
+
+#if COLLECT_WINDOW > 1
+  /* The first inflight packets on the send queue have been sent with
+     the packet IDs seqno, seqno + 1, ...; bit n of acked is set when
+     packet seqno + n has been acknowledged. */
+  uint8_t inflight, acked;
+  uint8_t window_transmissions[COLLECT_WINDOW];
+#endif /* COLLECT_WINDOW > 1 */
+
+#if COLLECT_BULK_ACK
+  /* An ACK that is held back to be merged with later ones. */
+  struct ctimer ack_timer;
+  linkaddr_t ack_to;
+  uint8_t ack_seqno, ack_count, ack_flags;
+#endif /* COLLECT_BULK_ACK */
 };
 
 enum {
@@ -43,6 +43,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "lib/list.h"
 #include "lib/memb.h"
@@ -68,16 +69,52 @@
 #define DEFAULT_LIFETIME 60
 #endif /* ROUTE_CONF_DEFAULT_LIFETIME */
 
+/* Routes are found through a hash table of HASH_SIZE buckets, keyed
+   by the destination address. */
+#ifdef ROUTE_CONF_HASH_SIZE
+#define HASH_SIZE ROUTE_CONF_HASH_SIZE
+#else /* ROUTE_CONF_HASH_SIZE */
+#define HASH_SIZE 8
+#endif /* ROUTE_CONF_HASH_SIZE */
+
+/* Routes expire through a timer wheel of WHEEL_SIZE one-second
+   slots. Every second, only the routes in one slot are looked at. A
+   route that has been refreshed since it was put in its slot is
+   moved to the slot of its new expiry time then. With a wheel at
+   least as large as the route lifetime, every route is looked at
+   only once per lifetime. Both sizes must be powers of two, and the
+   wheel can have at most 256 slots. */
+#ifdef ROUTE_CONF_WHEEL_SIZE
+#define WHEEL_SIZE ROUTE_CONF_WHEEL_SIZE
+#else /* ROUTE_CONF_WHEEL_SIZE */
+#define WHEEL_SIZE 16
+#endif /* ROUTE_CONF_WHEEL_SIZE */
+
 /*
- * List of route entries.
+ * List of route entries, newest first.
  */
 LIST(route_table);
 MEMB(route_mem, struct route_entry, NUM_RT_ENTRIES);
 
+static struct route_entry *hash_table[HASH_SIZE];
+static struct route_entry *wheel[WHEEL_SIZE];
+
+/* The route clock counts seconds since route_init(). */
+static uint16_t now;
+
 static struct ctimer t;
 
 static int max_time = DEFAULT_LIFETIME;
 
+static int num_routes;
+
+/* The entry last returned by route_get(), so that walking the table
+   with route_get() does not restart from the head for every entry. */
+static struct route_entry *get_entry;
+static int get_num;
+
+static struct route_stats stats;
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -87,21 +124,96 @@ static int max_time = DEFAULT_LIFETIME;
 #endif
 
 
+/*---------------------------------------------------------------------------*/
+static struct route_entry **
+hash_bucket(const linkaddr_t *addr)
+{
+  uint8_t h;
+  int i;
+
+  h = 0;
+  for(i = 0; i < LINKADDR_SIZE; ++i) {
+    h ^= addr->u8[i];
+  }
+  return &hash_table[h & (HASH_SIZE - 1)];
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_remove(struct route_entry *e)
+{
+  struct route_entry **p;
+
+  for(p = hash_bucket(&e->dest); *p != NULL; p = &(*p)->hash_next) {
+    if(*p == e) {
+      *p = e->hash_next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_insert(struct route_entry *e)
+{
+  uint16_t expiry;
+
+  /* A route that has already expired, which happens when the lifetime
+     is shortened, is looked at in the next second. */
+  if((uint16_t)(now - e->refreshed) >= max_time) {
+    expiry = now + 1;
+  } else {
+    expiry = e->refreshed + max_time;
+  }
+  e->wheel_slot = expiry & (WHEEL_SIZE - 1);
+  e->wheel_next = wheel[e->wheel_slot];
+  wheel[e->wheel_slot] = e;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_remove(struct route_entry *e)
+{
+  struct route_entry **p;
+
+  for(p = &wheel[e->wheel_slot]; *p != NULL; p = &(*p)->wheel_next) {
+    if(*p == e) {
+      *p = e->wheel_next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+free_entry(struct route_entry *e)
+{
+  hash_remove(e);
+  list_remove(route_table, e);
+  memb_free(&route_mem, e);
+  num_routes--;
+  get_entry = NULL;
+}
 /*---------------------------------------------------------------------------*/
 static void
 periodic(void *ptr)
 {
-  struct route_entry *e;
+  struct route_entry *e, *next;
 
-  for(e = list_head(route_table); e != NULL; e = list_item_next(e)) {
-    e->time++;
-    if(e->time >= max_time) {
+  now++;
+
+  /* Take the routes out of the slot for this second. The ones that
+     have expired are removed and the others go to the slot of their
+     current expiry time, which may be this slot again. */
+  e = wheel[now & (WHEEL_SIZE - 1)];
+  wheel[now & (WHEEL_SIZE - 1)] = NULL;
+  for(; e != NULL; e = next) {
+    next = e->wheel_next;
+    if((uint16_t)(now - e->refreshed) >= max_time) {
       PRINTF("route periodic: removing entry to %d.%d with nexthop %d.%d and cost %d\n",
 	     e->dest.u8[0], e->dest.u8[1],
 	     e->nexthop.u8[0], e->nexthop.u8[1],
 	     e->cost);
-      list_remove(route_table, e);
-      memb_free(&route_mem, e);
+      stats.expirations++;
+      free_entry(e);
+    } else {
+      wheel_insert(e);
     }
   }
 
@@ -113,6 +225,10 @@ route_init(void)
 {
   list_init(route_table);
   memb_init(&route_mem);
+  memset(hash_table, 0, sizeof(hash_table));
+  memset(wheel, 0, sizeof(wheel));
+  num_routes = 0;
+  get_entry = NULL;
 
   ctimer_set(&t, CLOCK_SECOND, periodic, NULL);
 }
@@ -122,10 +238,19 @@ route_add(const linkaddr_t *dest, const linkaddr_t *nexthop,
 	  uint8_t cost, uint8_t seqno)
 {
   struct route_entry *e, *oldest = NULL;
+  struct route_entry **bucket;
 
   /* Avoid inserting duplicate entries. */
-  e = route_lookup(dest);
-  if(e != NULL && linkaddr_cmp(&e->nexthop, nexthop)) {
+  bucket = hash_bucket(dest);
+  for(e = *bucket; e != NULL; e = e->hash_next) {
+    if(linkaddr_cmp(&e->dest, dest) && linkaddr_cmp(&e->nexthop, nexthop)) {
+      break;
+    }
+  }
+
+  if(e != NULL) {
+    hash_remove(e);
+    wheel_remove(e);
     list_remove(route_table, e);
   } else {
     /* Allocate a new entry or reuse the oldest entry with highest cost. */
@@ -133,16 +258,23 @@ route_add(const linkaddr_t *dest, const linkaddr_t *nexthop,
     if(e == NULL) {
       /* Remove oldest entry. */
       for(e = list_head(route_table); e != NULL; e = list_item_next(e)) {
-        if(oldest == NULL || e->time >= oldest->time) {
+        if(oldest == NULL ||
+           (uint16_t)(now - e->refreshed) >=
+           (uint16_t)(now - oldest->refreshed)) {
           oldest = e;
         }
       }
       e = oldest;
-      list_remove(route_table, e);
       PRINTF("route_add: removing entry to %d.%d with nexthop %d.%d and cost %d\n",
 	     e->dest.u8[0], e->dest.u8[1],
 	     e->nexthop.u8[0], e->nexthop.u8[1],
 	     e->cost);
+      hash_remove(e);
+      wheel_remove(e);
+      list_remove(route_table, e);
+      stats.evictions++;
+    } else {
+      num_routes++;
     }
   }
 
@@ -150,11 +282,16 @@ route_add(const linkaddr_t *dest, const linkaddr_t *nexthop,
   linkaddr_copy(&e->nexthop, nexthop);
   e->cost = cost;
   e->seqno = seqno;
-  e->time = 0;
+  e->refreshed = now;
   e->decay = 0;
 
   /* New entry goes first. */
   list_push(route_table, e);
+  e->hash_next = *bucket;
+  *bucket = e;
+  wheel_insert(e);
+  get_entry = NULL;
+  stats.adds++;
 
   PRINTF("route_add: new entry to %d.%d with nexthop %d.%d and cost %d\n",
 	 e->dest.u8[0], e->dest.u8[1],
@@ -175,10 +312,7 @@ route_lookup(const linkaddr_t *dest)
   best_entry = NULL;
   
   /* Find the route with the lowest cost. */
-  for(e = list_head(route_table); e != NULL; e = list_item_next(e)) {
-    /*    printf("route_lookup: comparing %d.%d.%d.%d with %d.%d.%d.%d\n",
-	   uip_ipaddr_to_quad(dest), uip_ipaddr_to_quad(&e->dest));*/
-
+  for(e = *hash_bucket(dest); e != NULL; e = e->hash_next) {
     if(linkaddr_cmp(dest, &e->dest)) {
       if(e->cost < lowest_cost) {
 	best_entry = e;
@@ -186,6 +320,12 @@ route_lookup(const linkaddr_t *dest)
       }
     }
   }
+
+  if(best_entry != NULL) {
+    stats.hits++;
+  } else {
+    stats.misses++;
+  }
   return best_entry;
 }
 /*---------------------------------------------------------------------------*/
@@ -194,12 +334,13 @@ route_refresh(struct route_entry *e)
 {
   if(e != NULL) {
     /* Refresh age of route so that used routes do not get thrown
-       out. */
-    e->time = 0;
+       out. The entry stays in its slot of the timer wheel until the
+       slot comes up. */
+    e->refreshed = now;
     e->decay = 0;
     
     PRINTF("route_refresh: time %d last %d decay %d for entry to %d.%d with nexthop %d.%d and cost %d\n",
-           e->time, e->time_last_decay, e->decay,
+           e->refreshed, e->time_last_decay, e->decay,
            e->dest.u8[0], e->dest.u8[1],
            e->nexthop.u8[0], e->nexthop.u8[1],
            e->cost);
@@ -214,14 +355,14 @@ route_decay(struct route_entry *e)
      is called to decay a route. The route can only be decayed once
      per second. */
   PRINTF("route_decay: time %d last %d decay %d for entry to %d.%d with nexthop %d.%d and cost %d\n",
-	 e->time, e->time_last_decay, e->decay,
+	 e->refreshed, e->time_last_decay, e->decay,
 	 e->dest.u8[0], e->dest.u8[1],
 	 e->nexthop.u8[0], e->nexthop.u8[1],
 	 e->cost);
   
-  if(e->time != e->time_last_decay) {
+  if(e->time_last_decay != (uint8_t)now) {
     /* Do not decay a route too often - not more than once per second. */
-    e->time_last_decay = e->time;
+    e->time_last_decay = now;
     e->decay++;
 
     if(e->decay >= DECAY_THRESHOLD) {
@@ -237,8 +378,8 @@ route_decay(struct route_entry *e)
 void
 route_remove(struct route_entry *e)
 {
-  list_remove(route_table, e);
-  memb_free(&route_mem, e);
+  wheel_remove(e);
+  free_entry(e);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -254,39 +395,55 @@ route_flush_all(void)
       break;
     }
   }
+  memset(hash_table, 0, sizeof(hash_table));
+  memset(wheel, 0, sizeof(wheel));
+  num_routes = 0;
+  get_entry = NULL;
 }
 /*---------------------------------------------------------------------------*/
 void
 route_set_lifetime(int seconds)
 {
+  struct route_entry *e;
+
   max_time = seconds;
+
+  /* The expiry times have changed, so the routes are put back into
+     the wheel. */
+  memset(wheel, 0, sizeof(wheel));
+  for(e = list_head(route_table); e != NULL; e = list_item_next(e)) {
+    wheel_insert(e);
+  }
 }
 /*---------------------------------------------------------------------------*/
 int
 route_num(void)
 {
-  struct route_entry *e;
-  int i = 0;
-
-  for(e = list_head(route_table); e != NULL; e = list_item_next(e)) {
-    i++;
-  }
-  return i;
+  return num_routes;
 }
 /*---------------------------------------------------------------------------*/
 struct route_entry *
 route_get(int num)
 {
   struct route_entry *e;
-  int i = 0;
+  int i;
 
-  for(e = list_head(route_table); e != NULL; e = list_item_next(e)) {
-    if(i == num) {
-      return e;
-    }
-    i++;
+  if(get_entry != NULL && num == get_num + 1) {
+    e = list_item_next(get_entry);
+  } else {
+    for(e = list_head(route_table), i = 0; e != NULL && i < num;
+        e = list_item_next(e), i++);
   }
-  return NULL;
+
+  get_entry = e;
+  get_num = num;
+  return e;
+}
+/*---------------------------------------------------------------------------*/
+const struct route_stats *
+route_get_stats(void)
+{
+  return &stats;
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
@@ -56,16 +56,26 @@
 
 struct route_entry {
   struct route_entry *next;
+  struct route_entry *hash_next;
+  struct route_entry *wheel_next;
   linkaddr_t dest;
   linkaddr_t nexthop;
   uint8_t seqno;
   uint8_t cost;
-  uint8_t time;
+  uint16_t refreshed;
+  uint8_t wheel_slot;
 
   uint8_t decay;
   uint8_t time_last_decay;
 };
 
+struct route_stats {
+  unsigned long hits, misses;  /* route_lookup() calls that found a route or not */
+  unsigned long adds;          /* Routes added or updated */
+  unsigned long evictions;     /* Routes removed to make room for new ones */
+  unsigned long expirations;   /* Routes removed at the end of their lifetime */
+};
+
 void route_init(void);
 int route_add(const linkaddr_t *dest, const linkaddr_t *nexthop,
 	      uint8_t cost, uint8_t seqno);
@@ -79,6 +89,8 @@ void route_set_lifetime(int seconds);
 int route_num(void);
 struct route_entry *route_get(int num);
 
+const struct route_stats *route_get_stats(void);
+
 #endif /* ROUTE_H_ */
 /** @} */
 /** @} */
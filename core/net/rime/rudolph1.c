@@ -44,6 +44,7 @@
 
 #include <stdio.h>
 #include <stddef.h> /* for offsetof */
+#include <string.h>
 
 #include "net/rime/rime.h"
 #include "net/rime/rudolph1.h"
@@ -52,7 +53,9 @@
 #define DEFAULT_SEND_INTERVAL CLOCK_SECOND * 2
 #define TRICKLE_INTERVAL CLOCK_SECOND / 2
 #define NACK_TIMEOUT CLOCK_SECOND / 4
+#define NACK_RETRY_TIME CLOCK_SECOND
 #define REPAIR_TIMEOUT CLOCK_SECOND / 4
+#define REPAIR_BURST_TIMEOUT CLOCK_SECOND / 16
 
 struct rudolph1_hdr {
   uint8_t type;
@@ -60,14 +63,19 @@ struct rudolph1_hdr {
   uint16_t chunk;
 };
 
-#define RUDOLPH1_DATASIZE 64
-
 struct rudolph1_datapacket {
   struct rudolph1_hdr h;
   uint8_t datalen;
   uint8_t data[RUDOLPH1_DATASIZE];
 };
 
+/* With a window, a NACK carries a bitmap of the missing chunks,
+   starting at the chunk in the header. */
+struct rudolph1_nack {
+  struct rudolph1_hdr h;
+  uint16_t missing;
+};
+
 enum {
   TYPE_DATA,
   TYPE_NACK,
@@ -83,12 +91,33 @@ enum {
 
 #define LT(a, b) ((signed char)((a) - (b)) < 0)
 
+#define WINDOW_BIT(chunk) ((uint16_t)1 << (chunk))
+#define WINDOW_MASK ((uint16_t)(((uint32_t)1 << RUDOLPH1_WINDOW) - 1))
+
+/*---------------------------------------------------------------------------*/
+#if RUDOLPH1_WINDOW > 1
+static int
+in_window(struct rudolph1_conn *c, int chunk)
+{
+  return chunk >= c->chunk && chunk - c->chunk < RUDOLPH1_WINDOW &&
+    (c->received & WINDOW_BIT(chunk - c->chunk));
+}
+#endif /* RUDOLPH1_WINDOW > 1 */
 /*---------------------------------------------------------------------------*/
 static int
 read_data(struct rudolph1_conn *c, uint8_t *dataptr, int chunk)
 {
   int len = 0;
 
+#if RUDOLPH1_WINDOW > 1
+  /* Chunks that have not been written out yet are in the window. */
+  if(in_window(c, chunk)) {
+    len = chunk - c->chunk == c->last ? c->lastlen : RUDOLPH1_DATASIZE;
+    memcpy(dataptr, c->buf[chunk - c->chunk], len);
+    return len;
+  }
+#endif /* RUDOLPH1_WINDOW > 1 */
+
   if(c->cb->read_chunk) {
     len = c->cb->read_chunk(c, chunk * RUDOLPH1_DATASIZE,
 			    dataptr, RUDOLPH1_DATASIZE);
@@ -113,6 +142,7 @@ format_data(struct rudolph1_conn *c, int chunk)
   return p->datalen;
 }
 /*---------------------------------------------------------------------------*/
+#if RUDOLPH1_WINDOW == 1
 static void
 write_data(struct rudolph1_conn *c, int chunk, uint8_t *data, int datalen)
 {
@@ -131,10 +161,95 @@ write_data(struct rudolph1_conn *c, int chunk, uint8_t *data, int datalen)
 		       RUDOLPH1_FLAG_NONE, data, datalen);
   }
 }
+#endif /* RUDOLPH1_WINDOW == 1 */
+/*---------------------------------------------------------------------------*/
+#if RUDOLPH1_WINDOW > 1
+static void
+reset_window(struct rudolph1_conn *c)
+{
+  c->received = 0;
+  c->last = RUDOLPH1_WINDOW;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+missing_chunks(struct rudolph1_conn *c)
+{
+  uint16_t mask;
+  int n;
+
+  /* We are missing the chunks in the window that we have not
+     received, up to the highest chunk we have heard of and not past
+     the last chunk of the file. */
+  if(c->highest_chunk_heard < c->chunk) {
+    return 0;
+  }
+  n = c->highest_chunk_heard - c->chunk;
+  if(n >= RUDOLPH1_WINDOW) {
+    mask = WINDOW_MASK;
+  } else {
+    mask = WINDOW_BIT(n + 1) - 1;
+  }
+  if(c->last < RUDOLPH1_WINDOW) {
+    mask &= (uint16_t)(((uint32_t)2 << c->last) - 1);
+  }
+  return mask & ~c->received;
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_window(struct rudolph1_conn *c)
+{
+  uint16_t mask;
+  int flag, num;
+
+  /* The window is written out when it is full, or when it holds the
+     last chunk and all chunks before it. */
+  if(c->last < RUDOLPH1_WINDOW) {
+    mask = (uint16_t)(((uint32_t)2 << c->last) - 1);
+    num = c->last + 1;
+    flag = RUDOLPH1_FLAG_LASTCHUNK;
+  } else {
+    mask = WINDOW_MASK;
+    num = RUDOLPH1_WINDOW;
+    flag = RUDOLPH1_FLAG_NONE;
+  }
+  if((c->received & mask) != mask) {
+    return;
+  }
+
+  PRINTF("%d.%d: writing chunks %d to %d\n",
+	 linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+	 c->chunk, c->chunk + num - 1);
+  if(c->chunk == 0) {
+    c->cb->write_chunk(c, 0, RUDOLPH1_FLAG_NEWFILE, c->buf[0], 0);
+  }
+  c->cb->write_chunk(c, c->chunk * RUDOLPH1_DATASIZE, flag, c->buf[0],
+		     flag == RUDOLPH1_FLAG_LASTCHUNK ?
+		     c->last * RUDOLPH1_DATASIZE + c->lastlen :
+		     RUDOLPH1_WINDOW * RUDOLPH1_DATASIZE);
+  c->chunk += num;
+  reset_window(c);
+}
+#endif /* RUDOLPH1_WINDOW > 1 */
 /*---------------------------------------------------------------------------*/
 static void
 send_nack(struct rudolph1_conn *c)
 {
+#if RUDOLPH1_WINDOW > 1
+  struct rudolph1_nack *nack;
+  packetbuf_clear();
+  packetbuf_hdralloc(sizeof(struct rudolph1_nack));
+  nack = packetbuf_hdrptr();
+
+  nack->h.type = TYPE_NACK;
+  nack->h.version = c->version;
+  nack->h.chunk = c->chunk;
+  nack->missing = missing_chunks(c);
+
+  PRINTF("%d.%d: Sending nack for %d:%d missing 0x%04x\n",
+	 linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+	 nack->h.version, nack->h.chunk, nack->missing);
+  ipolite_send(&c->ipolite, NACK_TIMEOUT, sizeof(struct rudolph1_nack));
+#else /* RUDOLPH1_WINDOW > 1 */
   struct rudolph1_hdr *hdr;
   packetbuf_clear();
   packetbuf_hdralloc(sizeof(struct rudolph1_hdr));
@@ -148,8 +263,127 @@ send_nack(struct rudolph1_conn *c)
 	 linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
 	 hdr->version, hdr->chunk);
   ipolite_send(&c->ipolite, NACK_TIMEOUT, sizeof(struct rudolph1_hdr));
+#endif /* RUDOLPH1_WINDOW > 1 */
 }
 /*---------------------------------------------------------------------------*/
+#if RUDOLPH1_WINDOW > 1
+static void
+nack_timeout(void *ptr)
+{
+  struct rudolph1_conn *c = ptr;
+
+  /* Neighbors only send data when the sender has a new chunk, so we
+     repeat our NACK until we have all chunks that we know of. */
+  if(missing_chunks(c) != 0) {
+    send_nack(c);
+    ctimer_set(&c->nack_timer, NACK_RETRY_TIME, nack_timeout, c);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_data(struct rudolph1_conn *c, struct rudolph1_datapacket *p)
+{
+  int slot;
+
+  if(LT(c->version, p->h.version)) {
+    PRINTF("%d.%d: rudolph1 new version %d, chunk %d\n",
+	   linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+	   p->h.version, p->h.chunk);
+    c->version = p->h.version;
+    c->highest_chunk_heard = c->chunk = 0;
+    reset_window(c);
+    c->repair_missing = 0;
+  } else if(p->h.version != c->version) {
+    /* Ignore packets with old version */
+    return;
+  }
+
+  if(p->h.chunk < c->chunk) {
+    /* Ignore chunks that we already have written */
+    return;
+  }
+  if(p->h.chunk > c->highest_chunk_heard) {
+    c->highest_chunk_heard = p->h.chunk;
+  }
+
+  slot = p->h.chunk - c->chunk;
+  if(slot < RUDOLPH1_WINDOW && !(c->received & WINDOW_BIT(slot))) {
+    PRINTF("%d.%d: received chunk %d into window at %d\n",
+	   linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+	   p->h.chunk, c->chunk);
+    memcpy(c->buf[slot], p->data, p->datalen);
+    c->received |= WINDOW_BIT(slot);
+    if(p->datalen < RUDOLPH1_DATASIZE) {
+      c->last = slot;
+      c->lastlen = p->datalen;
+    }
+    write_window(c);
+  }
+
+  /* Ask for all chunks that we know we are missing. */
+  if(missing_chunks(c) != 0) {
+    send_nack(c);
+    ctimer_set(&c->nack_timer, NACK_RETRY_TIME, nack_timeout, c);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_repair(struct rudolph1_conn *c, clock_time_t interval)
+{
+  int i;
+
+  for(i = 0; !(c->repair_missing & WINDOW_BIT(i)); ++i);
+  c->repair_missing &= ~WINDOW_BIT(i);
+
+  PRINTF("%d.%d: sending repair for chunk %d\n",
+	 linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+	 c->repair_chunk + i);
+  format_data(c, c->repair_chunk + i);
+  c->repairing = 1;
+  ipolite_send(&c->ipolite, interval, sizeof(struct rudolph1_hdr));
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_nack(struct rudolph1_conn *c, struct rudolph1_nack *nack)
+{
+  uint16_t have;
+  int i, chunk;
+
+  /* Find the missing chunks that we can repair: those we have written
+     out or sent, and those in our window. */
+  have = 0;
+  for(i = 0; i < RUDOLPH1_WINDOW; ++i) {
+    chunk = nack->h.chunk + i;
+    if((nack->missing & WINDOW_BIT(i)) &&
+       (chunk < c->chunk || in_window(c, chunk))) {
+      have |= WINDOW_BIT(i);
+    }
+  }
+  if(have == 0) {
+    return;
+  }
+
+  if(c->repair_missing != 0 && c->repair_chunk == nack->h.chunk) {
+    c->repair_missing |= have;
+  } else {
+    c->repair_chunk = nack->h.chunk;
+    c->repair_missing = have;
+  }
+  if(!c->repairing) {
+    send_repair(c, REPAIR_TIMEOUT);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+next_repair(struct rudolph1_conn *c)
+{
+  /* Send the remaining repairs back to back. */
+  c->repairing = 0;
+  if(c->repair_missing != 0) {
+    send_repair(c, REPAIR_BURST_TIMEOUT);
+  }
+}
+#else /* RUDOLPH1_WINDOW > 1 */
 static void
 handle_data(struct rudolph1_conn *c, struct rudolph1_datapacket *p)
 {
@@ -201,6 +435,7 @@ handle_data(struct rudolph1_conn *c, struct rudolph1_datapacket *p)
   }
 
 }
+#endif /* RUDOLPH1_WINDOW > 1 */
 /*---------------------------------------------------------------------------*/
 static void
 recv_trickle(struct trickle_conn *trickle)
@@ -221,6 +456,10 @@ sent_ipolite(struct ipolite_conn *ipolite)
 {
   PRINTF("%d.%d: Sent ipolite\n",
 	 linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1]);
+#if RUDOLPH1_WINDOW > 1
+  next_repair((struct rudolph1_conn *)
+	      ((char *)ipolite - offsetof(struct rudolph1_conn, ipolite)));
+#endif /* RUDOLPH1_WINDOW > 1 */
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -228,6 +467,10 @@ dropped_ipolite(struct ipolite_conn *ipolite)
 {
   PRINTF("%d.%d: dropped ipolite\n",
 	 linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1]);
+#if RUDOLPH1_WINDOW > 1
+  next_repair((struct rudolph1_conn *)
+	      ((char *)ipolite - offsetof(struct rudolph1_conn, ipolite)));
+#endif /* RUDOLPH1_WINDOW > 1 */
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -249,6 +492,9 @@ recv_ipolite(struct ipolite_conn *ipolite, const linkaddr_t *from)
 	   p->h.version, p->h.chunk,
 	   c->version, c->chunk);
     if(p->h.version == c->version) {
+#if RUDOLPH1_WINDOW > 1
+      handle_nack(c, (struct rudolph1_nack *)p);
+#else /* RUDOLPH1_WINDOW > 1 */
       if(p->h.chunk < c->chunk) {
 	/* Format and send a repair packet */
 	PRINTF("%d.%d: sending repair for chunk %d\n",
@@ -257,6 +503,7 @@ recv_ipolite(struct ipolite_conn *ipolite, const linkaddr_t *from)
 	format_data(c, p->h.chunk);
 	ipolite_send(&c->ipolite, REPAIR_TIMEOUT, sizeof(struct rudolph1_hdr));
       }
+#endif /* RUDOLPH1_WINDOW > 1 */
     } else if(LT(p->h.version, c->version)) {
       format_data(c, 0);
       ipolite_send(&c->ipolite, c->send_interval / 2, sizeof(struct rudolph1_hdr));
@@ -307,6 +554,11 @@ rudolph1_open(struct rudolph1_conn *c, uint16_t channel,
   c->cb = cb;
   c->version = 0;
   c->send_interval = DEFAULT_SEND_INTERVAL;
+#if RUDOLPH1_WINDOW > 1
+  reset_window(c);
+  c->repair_missing = 0;
+  c->repairing = 0;
+#endif /* RUDOLPH1_WINDOW > 1 */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -314,6 +566,9 @@ rudolph1_close(struct rudolph1_conn *c)
 {
   trickle_close(&c->trickle);
   ipolite_close(&c->ipolite);
+#if RUDOLPH1_WINDOW > 1
+  ctimer_stop(&c->nack_timer);
+#endif /* RUDOLPH1_WINDOW > 1 */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -321,6 +576,10 @@ rudolph1_send(struct rudolph1_conn *c, clock_time_t send_interval)
 {
   c->version++;
   c->chunk = c->highest_chunk_heard = 0;
+#if RUDOLPH1_WINDOW > 1
+  reset_window(c);
+  c->repair_missing = 0;
+#endif /* RUDOLPH1_WINDOW > 1 */
   /*  c->trickle_interval = TRICKLE_INTERVAL;*/
   format_data(c, 0);
   trickle_send(&c->trickle);
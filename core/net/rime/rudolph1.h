@@ -54,6 +54,19 @@
  * The rudolph1 module uses 2 channels; one for data transmissions and
  * one for NACKs and repair packets.
  *
+ * \section rudolph1-window Windowed transfer
+ *
+ * By default, a receiver only accepts the next chunk it is missing
+ * and asks for it with a NACK; chunks that arrive out of order are
+ * dropped. With RUDOLPH1_CONF_WINDOW set to more than one chunk, a
+ * receiver buffers a window of chunks, accepts them in any order and
+ * asks for all chunks it is missing in the window with one NACK that
+ * carries a bitmap. Neighbors that have the chunks, either written
+ * out or still in their window buffer, send the repairs back to back.
+ * A complete window is written with a single call to write_chunk(),
+ * so write_chunk() can get up to RUDOLPH1_WINDOW * RUDOLPH1_DATASIZE
+ * bytes at a time. All nodes must use the same window size.
+ *
  */
 
 #ifndef RUDOLPH1_H_
@@ -63,6 +76,18 @@
 #include "net/rime/ipolite.h"
 #include "sys/ctimer.h"
 
+#define RUDOLPH1_DATASIZE 64
+
+#ifdef RUDOLPH1_CONF_WINDOW
+#define RUDOLPH1_WINDOW RUDOLPH1_CONF_WINDOW
+#else /* RUDOLPH1_CONF_WINDOW */
+#define RUDOLPH1_WINDOW 1
+#endif /* RUDOLPH1_CONF_WINDOW */
+
+#if RUDOLPH1_WINDOW > 16
+#error RUDOLPH1_CONF_WINDOW can be at most 16 chunks
+#endif
+
 struct rudolph1_conn;
 
 enum {
@@ -88,6 +113,16 @@ struct rudolph1_conn {
   uint8_t version;
   /*  uint8_t trickle_interval;*/
   uint8_t nacks;
+#if RUDOLPH1_WINDOW > 1
+  /* The window starts at chunk, the next chunk to be written. */
+  uint8_t buf[RUDOLPH1_WINDOW][RUDOLPH1_DATASIZE];
+  uint16_t received;
+  uint8_t last, lastlen;
+  struct ctimer nack_timer;
+  /* Chunks that we have been asked to repair. */
+  uint16_t repair_chunk, repair_missing;
+  uint8_t repairing;
+#endif /* RUDOLPH1_WINDOW > 1 */
 };
 
 void rudolph1_open(struct rudolph1_conn *c, uint16_t channel,
@@ -38,6 +38,8 @@
  */
 
 #include "sys/energest.h"
+#include "sys/rtimer.h"
+#include "sys/clock.h"
 #include "contiki-conf.h"
 
 #if ENERGEST_CONF_ON
@@ -50,11 +52,66 @@ energest_t energest_leveldevice_current_leveltime[ENERGEST_CONF_LEVELDEVICE_LEVE
 #endif
 unsigned char energest_current_mode[ENERGEST_TYPE_MAX];
 
+#if ENERGEST_CONF_MAC_STATES
+#define MAC_STATE_NONE ENERGEST_MAC_MAX
+/*
+ * The MAC state and channel are set from the MAC, which may run in
+ * interrupt context (as TSCH does), so only energest_mac_on(),
+ * energest_mac_off() and energest_mac_channel() write the counters
+ * below. They bump mac_seq when they do, and the readers, which run in
+ * process context, retry if it changed while they were reading.
+ */
+static volatile unsigned char mac_seq;
+static unsigned long mac_time[ENERGEST_MAC_MAX];
+static unsigned char mac_state = MAC_STATE_NONE;
+static rtimer_clock_t mac_state_since;
+
+/*
+ * The rtimer wraps after two seconds on some platforms, so a state
+ * that lasts longer than half an rtimer wrap is measured with the
+ * clock instead.
+ */
+static clock_time_t mac_state_since_clock;
+static clock_time_t mac_long_state;
+
+/*
+ * The radio on time (transmit + listen) is charged to the channel the
+ * MAC last reported, in one go whenever the channel changes.
+ */
+static unsigned long channel_time[ENERGEST_MAC_CHANNELS];
+static int mac_channel = -1;
+static unsigned long channel_radio_since;
+
+static unsigned long
+radio_time(void)
+{
+  return energest_type_time(ENERGEST_TYPE_TRANSMIT) +
+    energest_type_time(ENERGEST_TYPE_LISTEN);
+}
+/*---------------------------------------------------------------------------*/
+/* The time spent in the current MAC state so far, in rtimer ticks */
+static unsigned long
+mac_state_elapsed(void)
+{
+  clock_time_t elapsed;
+
+  elapsed = clock_time() - mac_state_since_clock;
+  if(elapsed < mac_long_state) {
+    return (rtimer_clock_t)(RTIMER_NOW() - mac_state_since);
+  }
+  return (unsigned long)(elapsed / CLOCK_SECOND) * RTIMER_SECOND +
+    (unsigned long)(elapsed % CLOCK_SECOND) * RTIMER_SECOND / CLOCK_SECOND;
+}
+#endif /* ENERGEST_CONF_MAC_STATES */
+
 /*---------------------------------------------------------------------------*/
 void
 energest_init(void)
 {
   int i;
+#if ENERGEST_CONF_MAC_STATES
+  unsigned long half_wrap;
+#endif /* ENERGEST_CONF_MAC_STATES */
   for(i = 0; i < ENERGEST_TYPE_MAX; ++i) {
     energest_total_time[i].current = energest_current_time[i] = 0;
     energest_current_mode[i] = 0;
@@ -64,6 +121,28 @@ energest_init(void)
     energest_leveldevice_current_leveltime[i].current = 0;
   }
 #endif
+#if ENERGEST_CONF_MAC_STATES
+  for(i = 0; i < ENERGEST_MAC_MAX; ++i) {
+    mac_time[i] = 0;
+  }
+  for(i = 0; i < ENERGEST_MAC_CHANNELS; ++i) {
+    channel_time[i] = 0;
+  }
+  mac_state = MAC_STATE_NONE;
+  mac_channel = -1;
+  channel_radio_since = 0;
+
+  half_wrap = (unsigned long)((rtimer_clock_t)~0 >> 1);
+  if(half_wrap >= RTIMER_SECOND) {
+    half_wrap = half_wrap / RTIMER_SECOND * CLOCK_SECOND;
+  } else {
+    half_wrap = half_wrap * CLOCK_SECOND / RTIMER_SECOND;
+  }
+  if(half_wrap > (clock_time_t)~0 >> 1) {
+    half_wrap = (clock_time_t)~0 >> 1;
+  }
+  mac_long_state = half_wrap;
+#endif /* ENERGEST_CONF_MAC_STATES */
 }
 /*---------------------------------------------------------------------------*/
 unsigned long
@@ -113,9 +192,100 @@ energest_flush(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if ENERGEST_CONF_MAC_STATES
+void
+energest_mac_on(int state)
+{
+  if(mac_state != MAC_STATE_NONE) {
+    mac_time[mac_state] += mac_state_elapsed();
+  }
+  mac_state = state;
+  mac_state_since = RTIMER_NOW();
+  mac_state_since_clock = clock_time();
+  mac_seq++;
+}
+/*---------------------------------------------------------------------------*/
+void
+energest_mac_off(void)
+{
+  if(mac_state != MAC_STATE_NONE) {
+    mac_time[mac_state] += mac_state_elapsed();
+  }
+  mac_state = MAC_STATE_NONE;
+  mac_seq++;
+}
+/*---------------------------------------------------------------------------*/
+void
+energest_mac_channel(int channel)
+{
+  unsigned long radio;
+
+  channel -= ENERGEST_MAC_CHANNEL_FIRST;
+  if(channel < 0 || channel >= ENERGEST_MAC_CHANNELS) {
+    channel = -1;
+  }
+  if(channel != mac_channel) {
+    radio = radio_time();
+    if(mac_channel >= 0) {
+      channel_time[mac_channel] += radio - channel_radio_since;
+    }
+    channel_radio_since = radio;
+    mac_channel = channel;
+    mac_seq++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+energest_mac_time(int state)
+{
+  unsigned char seq;
+  unsigned long t;
+
+  do {
+    seq = mac_seq;
+    t = mac_time[state];
+    if(mac_state == state) {
+      t += mac_state_elapsed();
+    }
+  } while(seq != mac_seq);
+  return t;
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+energest_mac_channel_time(int channel)
+{
+  unsigned char seq;
+  unsigned long t;
+
+  channel -= ENERGEST_MAC_CHANNEL_FIRST;
+  if(channel < 0 || channel >= ENERGEST_MAC_CHANNELS) {
+    return 0;
+  }
+  do {
+    seq = mac_seq;
+    t = channel_time[channel];
+    if(mac_channel == channel) {
+      t += radio_time() - channel_radio_since;
+    }
+  } while(seq != mac_seq);
+  return t;
+}
+#else /* ENERGEST_CONF_MAC_STATES */
+void energest_mac_on(int state) {}
+void energest_mac_off(void) {}
+void energest_mac_channel(int channel) {}
+unsigned long energest_mac_time(int state) { return 0; }
+unsigned long energest_mac_channel_time(int channel) { return 0; }
+#endif /* ENERGEST_CONF_MAC_STATES */
+/*---------------------------------------------------------------------------*/
 #else /* ENERGEST_CONF_ON */
 void energest_type_set(int type, unsigned long val) {}
 void energest_init(void) {}
 unsigned long energest_type_time(int type) { return 0; }
 void energest_flush(void) {}
+void energest_mac_on(int state) {}
+void energest_mac_off(void) {}
+void energest_mac_channel(int channel) {}
+unsigned long energest_mac_time(int state) { return 0; }
+unsigned long energest_mac_channel_time(int channel) { return 0; }
 #endif /* ENERGEST_CONF_ON */
@@ -67,8 +67,40 @@ enum energest_type {
   ENERGEST_TYPE_MAX
 };
 
+/*
+ * States that a MAC protocol can charge time to with ENERGEST_MAC_ON(),
+ * when ENERGEST_CONF_MAC_STATES is set. A MAC is in at most one state at
+ * a time.
+ */
+enum energest_mac_state {
+  ENERGEST_MAC_BEACON_RX,       /* Waiting for or receiving a beacon */
+  ENERGEST_MAC_SLOT_TX,         /* Transmitting in a slot the node owns */
+  ENERGEST_MAC_CONTENTION_TX,   /* Transmitting in a contention period */
+  ENERGEST_MAC_GUARD,           /* Idle in a guard time before a slot */
+  ENERGEST_MAC_BACKOFF,         /* Waiting in a random backoff */
+
+  ENERGEST_MAC_MAX
+};
+
+#ifdef ENERGEST_CONF_MAC_CHANNELS
+#define ENERGEST_MAC_CHANNELS ENERGEST_CONF_MAC_CHANNELS
+#else
+#define ENERGEST_MAC_CHANNELS 16
+#endif
+
+#ifdef ENERGEST_CONF_MAC_CHANNEL_FIRST
+#define ENERGEST_MAC_CHANNEL_FIRST ENERGEST_CONF_MAC_CHANNEL_FIRST
+#else
+#define ENERGEST_MAC_CHANNEL_FIRST 11
+#endif
+
 void energest_init(void);
 unsigned long energest_type_time(int type);
+unsigned long energest_mac_time(int state);
+unsigned long energest_mac_channel_time(int channel);
+void energest_mac_on(int state);
+void energest_mac_off(void);
+void energest_mac_channel(int channel);
 #ifdef ENERGEST_CONF_LEVELDEVICE_LEVELS
 unsigned long energest_leveldevice_leveltime(int powerlevel);
 #endif
@@ -145,7 +177,20 @@ extern energest_t energest_leveldevice_current_leveltime[ENERGEST_CONF_LEVELDEVI
                                            } while(0)
 #endif
 
+#if ENERGEST_CONF_MAC_STATES
+#define ENERGEST_MAC_ON(state)       energest_mac_on(state)
+#define ENERGEST_MAC_OFF()           energest_mac_off()
+#define ENERGEST_MAC_CHANNEL(channel) energest_mac_channel(channel)
+#else /* ENERGEST_CONF_MAC_STATES */
+#define ENERGEST_MAC_ON(state) do { } while(0)
+#define ENERGEST_MAC_OFF() do { } while(0)
+#define ENERGEST_MAC_CHANNEL(channel) do { } while(0)
+#endif /* ENERGEST_CONF_MAC_STATES */
+
 #else /* ENERGEST_CONF_ON */
+#define ENERGEST_MAC_ON(state) do { } while(0)
+#define ENERGEST_MAC_OFF() do { } while(0)
+#define ENERGEST_MAC_CHANNEL(channel) do { } while(0)
 #define ENERGEST_ON(type) do { } while(0)
 #define ENERGEST_OFF(type) do { } while(0)
 #define ENERGEST_OFF_LEVEL(type,level) do { } while(0)
@@ -47,6 +47,11 @@
 
 #include "sys/process.h"
 #include "sys/arg.h"
+#if PROCESS_CONF_PROFILE
+#include "sys/clock.h"
+#include "sys/rtimer.h"
+#include <string.h>
+#endif /* PROCESS_CONF_PROFILE */
 
 /*
  * Pointer to the currently running process structure.
@@ -63,6 +68,9 @@ struct event_data {
   process_event_t ev;
   process_data_t data;
   struct process *p;
+#if PROCESS_CONF_PROFILE
+  rtimer_clock_t posted;
+#endif /* PROCESS_CONF_PROFILE */
 };
 
 static process_num_events_t nevents, fevent;
@@ -72,6 +80,15 @@ static struct event_data events[PROCESS_CONF_NUMEVENTS];
 process_num_events_t process_maxevents;
 #endif
 
+#if PROCESS_CONF_PROFILE
+/* Time spent in processes called synchronously from the running one */
+static rtimer_clock_t profile_nested;
+/* Set by do_event() when the next call delivers a queued event */
+static uint8_t profile_queued;
+static rtimer_clock_t profile_posted;
+#define PROFILE_NAME_LEN 16
+#endif /* PROCESS_CONF_PROFILE */
+
 static volatile unsigned char poll_requested;
 
 #define PROCESS_STATE_NONE        0
@@ -175,6 +192,12 @@ static void
 call_process(struct process *p, process_event_t ev, process_data_t data)
 {
   int ret;
+#if PROCESS_CONF_PROFILE
+  rtimer_clock_t start, elapsed, outer_nested;
+  uint8_t queued = profile_queued;
+
+  profile_queued = 0;
+#endif /* PROCESS_CONF_PROFILE */
 
 #if DEBUG
   if(p->state == PROCESS_STATE_CALLED) {
@@ -187,7 +210,29 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
     PRINTF("process: calling process '%s' with event %d\n", PROCESS_NAME_STRING(p), ev);
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
+#if PROCESS_CONF_PROFILE
+    start = RTIMER_NOW();
+    if(queued) {
+      elapsed = start - profile_posted;
+      p->profile.wait += elapsed;
+      if(elapsed > p->profile.max_wait) {
+        p->profile.max_wait = elapsed;
+      }
+      p->profile.events++;
+    }
+    outer_nested = profile_nested;
+    profile_nested = 0;
+#endif /* PROCESS_CONF_PROFILE */
     ret = p->thread(&p->pt, ev, data);
+#if PROCESS_CONF_PROFILE
+    elapsed = RTIMER_NOW() - start;
+    p->profile.time += elapsed - profile_nested;
+    if(elapsed - profile_nested > p->profile.max_time) {
+      p->profile.max_time = elapsed - profile_nested;
+    }
+    p->profile.calls++;
+    profile_nested = outer_nested + elapsed;
+#endif /* PROCESS_CONF_PROFILE */
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
@@ -249,6 +294,9 @@ do_event(void)
   process_data_t data;
   struct process *receiver;
   struct process *p;
+#if PROCESS_CONF_PROFILE
+  rtimer_clock_t posted;
+#endif /* PROCESS_CONF_PROFILE */
   
   /*
    * If there are any events in the queue, take the first one and walk
@@ -265,6 +313,9 @@ do_event(void)
     
     data = events[fevent].data;
     receiver = events[fevent].p;
+#if PROCESS_CONF_PROFILE
+    posted = events[fevent].posted;
+#endif /* PROCESS_CONF_PROFILE */
 
     /* Since we have seen the new event, we move pointer upwards
        and decrease the number of events. */
@@ -281,6 +332,10 @@ do_event(void)
 	if(poll_requested) {
 	  do_poll();
 	}
+#if PROCESS_CONF_PROFILE
+	profile_queued = 1;
+	profile_posted = posted;
+#endif /* PROCESS_CONF_PROFILE */
 	call_process(p, ev, data);
       }
     } else {
@@ -292,6 +347,10 @@ do_event(void)
 	receiver->state = PROCESS_STATE_RUNNING;
       }
 
+#if PROCESS_CONF_PROFILE
+      profile_queued = 1;
+      profile_posted = posted;
+#endif /* PROCESS_CONF_PROFILE */
       /* Make sure that the process actually is running. */
       call_process(receiver, ev, data);
     }
@@ -347,6 +406,9 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
   events[snum].ev = ev;
   events[snum].data = data;
   events[snum].p = p;
+#if PROCESS_CONF_PROFILE
+  events[snum].posted = RTIMER_NOW();
+#endif /* PROCESS_CONF_PROFILE */
   ++nevents;
 
 #if PROCESS_CONF_STATS
@@ -385,4 +447,64 @@ process_is_running(struct process *p)
   return p->state != PROCESS_STATE_NONE;
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_PROFILE
+void
+process_profile_reset(void)
+{
+  struct process *p;
+
+  for(p = process_list; p != NULL; p = p->next) {
+    memset(&p->profile, 0, sizeof(p->profile));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+put16(uint8_t *buf, uint16_t v)
+{
+  buf[0] = v & 0xff;
+  buf[1] = v >> 8;
+  return buf + 2;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+put32(uint8_t *buf, uint32_t v)
+{
+  buf = put16(buf, v & 0xffff);
+  return put16(buf, v >> 16);
+}
+/*---------------------------------------------------------------------------*/
+int
+process_profile_dump(uint8_t *buf, int len)
+{
+  struct process *p;
+  uint8_t *ptr;
+  int namelen;
+
+  if(len < 4) {
+    return 0;
+  }
+  ptr = put32(buf, RTIMER_SECOND);
+
+  for(p = process_list; p != NULL; p = p->next) {
+    namelen = strlen(PROCESS_NAME_STRING(p));
+    if(namelen > PROFILE_NAME_LEN) {
+      namelen = PROFILE_NAME_LEN;
+    }
+    if(ptr + 1 + namelen + 6 * 4 > buf + len) {
+      break;
+    }
+    *ptr++ = namelen;
+    memcpy(ptr, PROCESS_NAME_STRING(p), namelen);
+    ptr += namelen;
+    ptr = put32(ptr, p->profile.calls);
+    ptr = put32(ptr, p->profile.events);
+    ptr = put32(ptr, p->profile.time);
+    ptr = put32(ptr, p->profile.max_time);
+    ptr = put32(ptr, p->profile.wait);
+    ptr = put32(ptr, p->profile.max_wait);
+  }
+  return ptr - buf;
+}
+#endif /* PROCESS_CONF_PROFILE */
+/*---------------------------------------------------------------------------*/
 /** @} */
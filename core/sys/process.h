@@ -312,6 +312,22 @@ static PT_THREAD(process_thread_##name(struct pt *process_pt,	\
 
 /** @} */
 
+#if PROCESS_CONF_PROFILE
+/**
+ * Per-process profiling counters, kept when PROCESS_CONF_PROFILE is
+ * set. All times are in rtimer ticks. The run time of a process does
+ * not include the time spent in processes that it calls synchronously.
+ */
+struct process_profile {
+  uint32_t time;      /**< Total time spent running the process */
+  uint32_t max_time;  /**< Longest single run of the process */
+  uint32_t wait;      /**< Total time events waited in the event queue */
+  uint32_t max_wait;  /**< Longest time an event waited in the queue */
+  uint32_t calls;     /**< Number of times the process has been run */
+  uint32_t events;    /**< Number of calls that delivered a queued event */
+};
+#endif /* PROCESS_CONF_PROFILE */
+
 struct process {
   struct process *next;
 #if PROCESS_CONF_NO_PROCESS_NAMES
@@ -323,6 +339,9 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+#if PROCESS_CONF_PROFILE
+  struct process_profile profile;
+#endif /* PROCESS_CONF_PROFILE */
 };
 
 /**
@@ -521,6 +540,36 @@ int process_nevents(void);
 
 /** @} */
 
+#if PROCESS_CONF_PROFILE
+/**
+ * \name Process profiling
+ * @{
+ */
+
+/**
+ * Clear the profiling counters of all running processes.
+ */
+void process_profile_reset(void);
+
+/**
+ * Write the profiling counters of all running processes to a buffer.
+ *
+ * The dump starts with RTIMER_SECOND as a 32-bit value, followed by
+ * one record per process: the length of the process' name (at most
+ * 16), the name without a terminating zero and the 32-bit calls,
+ * events, time, max_time, wait and max_wait counters. All values are
+ * little-endian. Records that do not fit
+ * in the buffer are left out.
+ *
+ * \param buf The buffer to write to.
+ * \param len The size of the buffer.
+ * \return The number of bytes written.
+ */
+int process_profile_dump(uint8_t *buf, int len);
+
+/** @} */
+#endif /* PROCESS_CONF_PROFILE */
+
 CCIF extern struct process *process_list;
 
 #define PROCESS_LIST() process_list
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Structured binary trace records
+ */
+
+#include "sys/trace.h"
+
+#include <stddef.h>
+
+#if TRACE_ENABLED
+
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+put_addr(uint8_t *p, const linkaddr_t *addr)
+{
+  if(addr == NULL) {
+    addr = &linkaddr_null;
+  }
+  *p++ = addr->u8[LINKADDR_SIZE - 2];
+  *p++ = addr->u8[LINKADDR_SIZE - 1];
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+put_u16(uint8_t *p, uint16_t v)
+{
+  *p++ = v & 0xff;
+  *p++ = v >> 8;
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+static void
+emit(uint8_t *record, uint8_t type, const uint8_t *end)
+{
+  record[0] = type;
+  record[1] = end - record - 2;
+  trace_arch_write(record, end - record);
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_packet_tx(const linkaddr_t *addr, uint16_t len,
+                uint8_t status, uint8_t transmissions)
+{
+  uint8_t r[TRACE_RECORD_MAX];
+  uint8_t *p;
+
+  p = put_addr(r + 2, addr);
+  p = put_u16(p, len);
+  *p++ = status;
+  *p++ = transmissions;
+  emit(r, TRACE_RECORD_TX, p);
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_packet_rx(const linkaddr_t *addr, uint16_t len, int8_t rssi)
+{
+  uint8_t r[TRACE_RECORD_MAX];
+  uint8_t *p;
+
+  p = put_addr(r + 2, addr);
+  p = put_u16(p, len);
+  *p++ = (uint8_t)rssi;
+  emit(r, TRACE_RECORD_RX, p);
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_packet_drop(const linkaddr_t *addr, uint16_t len, uint8_t reason)
+{
+  uint8_t r[TRACE_RECORD_MAX];
+  uint8_t *p;
+
+  p = put_addr(r + 2, addr);
+  p = put_u16(p, len);
+  *p++ = reason;
+  emit(r, TRACE_RECORD_DROP, p);
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_slot(uint16_t timeslot, uint8_t channel, uint8_t event)
+{
+  uint8_t r[TRACE_RECORD_MAX];
+  uint8_t *p;
+
+  p = put_u16(r + 2, timeslot);
+  *p++ = channel;
+  *p++ = event;
+  emit(r, TRACE_RECORD_SLOT, p);
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_queue(uint8_t queue, uint8_t length)
+{
+  uint8_t r[TRACE_RECORD_MAX];
+  uint8_t *p;
+
+  p = r + 2;
+  *p++ = queue;
+  *p++ = length;
+  emit(r, TRACE_RECORD_QUEUE, p);
+}
+/*---------------------------------------------------------------------------*/
+#endif /* TRACE_ENABLED */
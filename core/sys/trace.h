@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Structured binary trace records
+ *
+ *         The trace module emits small fixed-layout records for
+ *         network events (packet transmission, reception and drops,
+ *         TSCH and TDMA slot activity and queue lengths). Unlike
+ *         printf() logging, the records need no formatting on the node
+ *         and no parsing on the host. The platform supplies
+ *         trace_arch_write(), which in Cooja hands the records to the
+ *         ContikiTrace mote interface, or to the MspTrace interface on
+ *         MSPSim motes. The records are decoded by tools/trace-decode.c.
+ *
+ *         Each record starts with a type byte and a payload length
+ *         byte, followed by the payload. Multi-byte fields are
+ *         little-endian. Link-layer addresses are truncated to their
+ *         two last bytes, which is the node id on all platforms that
+ *         derive the address from it.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "contiki-conf.h"
+#include "net/linkaddr.h"
+
+/* Record types */
+#define TRACE_RECORD_TX    1 /* addr[2] len[2] status[1] transmissions[1] */
+#define TRACE_RECORD_RX    2 /* addr[2] len[2] rssi[1] */
+#define TRACE_RECORD_DROP  3 /* addr[2] len[2] reason[1] */
+#define TRACE_RECORD_SLOT  4 /* timeslot[2] channel[1] event[1] */
+#define TRACE_RECORD_QUEUE 5 /* queue[1] length[1] */
+
+/* Reasons for TRACE_RECORD_DROP */
+#define TRACE_DROP_QUEUE_FULL  1
+#define TRACE_DROP_NO_BUFFER   2
+#define TRACE_DROP_DUPLICATE   3
+#define TRACE_DROP_PARSE       4
+#define TRACE_DROP_NO_LINK     5
+
+/* Events for TRACE_RECORD_SLOT */
+#define TRACE_SLOT_TX      1
+#define TRACE_SLOT_RX      2
+#define TRACE_SLOT_SKIP    3
+
+/* Queue identifiers for TRACE_RECORD_QUEUE */
+#define TRACE_QUEUE_CSMA   0
+#define TRACE_QUEUE_TSCH   1
+#define TRACE_QUEUE_TDMA   2 /* Beacon TDMA and Z-MAC, one packet */
+
+/* The largest record, header included */
+#define TRACE_RECORD_MAX   8
+
+#ifdef TRACE_CONF_ENABLED
+#define TRACE_ENABLED TRACE_CONF_ENABLED
+#else /* TRACE_CONF_ENABLED */
+#define TRACE_ENABLED 0
+#endif /* TRACE_CONF_ENABLED */
+
+#if TRACE_ENABLED
+void trace_packet_tx(const linkaddr_t *addr, uint16_t len,
+                     uint8_t status, uint8_t transmissions);
+void trace_packet_rx(const linkaddr_t *addr, uint16_t len, int8_t rssi);
+void trace_packet_drop(const linkaddr_t *addr, uint16_t len, uint8_t reason);
+void trace_slot(uint16_t timeslot, uint8_t channel, uint8_t event);
+void trace_queue(uint8_t queue, uint8_t length);
+
+/**
+ * Write one complete record to the trace channel. Implemented by
+ * the platform. Records that do not fit are dropped as a whole.
+ */
+void trace_arch_write(const uint8_t *record, uint8_t len);
+
+#define TRACE_PACKET_TX(a, l, s, t) trace_packet_tx(a, l, s, t)
+#define TRACE_PACKET_RX(a, l, r)    trace_packet_rx(a, l, r)
+#define TRACE_PACKET_DROP(a, l, r)  trace_packet_drop(a, l, r)
+#define TRACE_SLOT(ts, c, e)        trace_slot(ts, c, e)
+#define TRACE_QUEUE(q, l)           trace_queue(q, l)
+#else /* TRACE_ENABLED */
+#define TRACE_PACKET_TX(a, l, s, t)
+#define TRACE_PACKET_RX(a, l, r)
+#define TRACE_PACKET_DROP(a, l, r)
+#define TRACE_SLOT(ts, c, e)
+#define TRACE_QUEUE(q, l)
+#endif /* TRACE_ENABLED */
+
+#endif /* TRACE_H_ */
@@ -117,6 +117,9 @@ started = 0;
 while(true) {
   YIELD(); /* wait for another mote output */
   log.log(time + " " + id + " " + msg + "\n");
+  if(msg.startsWith("netperf,")) {
+    log.append("netperf.csv", msg + "\n"); /* Results, one row per test and node */
+  }
   if(msg.startsWith("Done")) {
     log.testOK();
   }
@@ -124,7 +127,7 @@ while(true) {
     log.testFailed();
   }
   if(id == 1 &amp;&amp; msg.startsWith("1.0: Contiki") &amp;&amp; started == 0) {
-    write(mote, "netperf -bups 2.0 20\n"); /* Write to mote serial port */
+    write(mote, "netperf -c -bups -l 64 -r 8 -n 2 2.0 50\n"); /* Write to mote serial port */
     started = 1;
   }
 }
@@ -2,3 +2,6 @@
 #define NETSTACK_CONF_RDC nullrdc_driver
 #define NETSTACK_CONF_FRAMER framer_802154
 //#define TIMESYNCH_CONF_ENABLED 1
+
+/* Trace records for the MAC comparison, collected by Cooja */
+#define TRACE_CONF_ENABLED 1
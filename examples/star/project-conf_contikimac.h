@@ -8,3 +8,5 @@
 #define NETSTACK_CONF_RDC contikimac_driver
 #define NETSTACK_CONF_MAC csma_driver
 #define NETSTACK_CONF_FRAMER framer_802154
+
+#define TRACE_CONF_ENABLED 1
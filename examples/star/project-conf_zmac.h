@@ -2,3 +2,5 @@
 #define NETSTACK_CONF_RDC nullrdc_driver
 #define NETSTACK_CONF_FRAMER framer_802154
 //#define TIMESYNCH_CONF_ENABLED 1
+
+#define TRACE_CONF_ENABLED 1
@@ -42,6 +42,9 @@
 #define LOG_CONF_ENABLED 1
 #define RIMESTATS_CONF_ON 1
 #define RIMESTATS_CONF_ENABLED 1
+#ifndef TRACE_CONF_ENABLED
+#define TRACE_CONF_ENABLED 1
+#endif /* TRACE_CONF_ENABLED */
 
 #define COOJA 1
 
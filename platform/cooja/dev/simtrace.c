@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2006, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "sys/trace.h"
+#include "lib/simEnvChange.h"
+
+#ifdef SIMTRACE_CONF_BUFSIZE
+#define SIMTRACE_BUFSIZE SIMTRACE_CONF_BUFSIZE
+#else
+#define SIMTRACE_BUFSIZE 512
+#endif
+
+const struct simInterface simtrace_interface;
+
+/* Variables shared between COOJA and Contiki */
+unsigned char simTraceData[SIMTRACE_BUFSIZE];
+int simTraceLength;
+int simTraceLost;
+char simTraceFlag;
+
+/*-----------------------------------------------------------------------------------*/
+#if TRACE_ENABLED
+void
+trace_arch_write(const uint8_t *record, uint8_t len)
+{
+  if(simTraceLength + len > SIMTRACE_BUFSIZE) {
+    /* COOJA empties the buffer after every tick; count what did not fit */
+    simTraceLost++;
+    simTraceFlag = 1;
+    return;
+  }
+
+  memcpy(simTraceData + simTraceLength, record, len);
+  simTraceLength += len;
+  simTraceFlag = 1;
+}
+#endif /* TRACE_ENABLED */
+/*-----------------------------------------------------------------------------------*/
+static void
+doInterfaceActionsBeforeTick(void)
+{
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+doInterfaceActionsAfterTick(void)
+{
+}
+/*-----------------------------------------------------------------------------------*/
+
+SIM_INTERFACE(simtrace_interface,
+	      doInterfaceActionsBeforeTick,
+	      doInterfaceActionsAfterTick);
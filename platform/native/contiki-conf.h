@@ -74,6 +74,18 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_LOGGING         0
 #define UIP_CONF_UDP_CHECKSUMS   1
 
+#ifndef CRC16_CONF_IMPL
+#define CRC16_CONF_IMPL          2 /* CRC16_IMPL_SLICE4 */
+#endif /* CRC16_CONF_IMPL */
+
+#ifndef AES_128_CONF
+#define AES_128_CONF             aes_128_ttable_driver
+#endif /* AES_128_CONF */
+
+#ifndef UIP_CHKSUM_CONF_WIDE
+#define UIP_CHKSUM_CONF_WIDE     1
+#endif /* UIP_CHKSUM_CONF_WIDE */
+
 #ifndef NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE
 #define NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE 8
 #endif /* NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE */
@@ -82,6 +94,10 @@ typedef unsigned short uip_stats_t;
 
 #define LINKADDR_CONF_SIZE              8
 
+#ifndef UIP_CONF_CONN_HASH_SIZE
+#define UIP_CONF_CONN_HASH_SIZE        16
+#endif /* UIP_CONF_CONN_HASH_SIZE */
+
 #ifndef NETSTACK_CONF_MAC
 #define NETSTACK_CONF_MAC     nullmac_driver
 #endif /* NETSTACK_CONF_MAC */
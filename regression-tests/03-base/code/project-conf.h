@@ -34,4 +34,9 @@
 
 #define UNIT_TEST_PRINT_FUNCTION test_print_report
 
+/* Exercise both the slice-by-4 block loop and the table-driven tail */
+#ifndef CRC16_CONF_IMPL
+#define CRC16_CONF_IMPL CRC16_IMPL_SLICE4
+#endif /* CRC16_CONF_IMPL */
+
 #endif /* !_PROJECT_CONF_H_ */
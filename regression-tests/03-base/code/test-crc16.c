@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2017, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+
+#include "contiki.h"
+#include "unit-test.h"
+
+#include "lib/crc16.h"
+
+PROCESS(test_process, "crc16.c test");
+AUTOSTART_PROCESSES(&test_process);
+
+#define DATA_LEN   257
+#define BENCH_LEN  1024
+#define BENCH_RUNS 256
+
+static unsigned char buf[BENCH_LEN];
+
+static void
+test_print_report(const unit_test_t *utp)
+{
+  printf("=check-me= ");
+  if(utp->result == unit_test_failure) {
+    printf("FAILED   - %s: exit at L%u\n", utp->descr, utp->exit_line);
+  } else {
+    printf("SUCCEEDED - %s\n", utp->descr);
+  }
+}
+
+/* The byte-at-a-time reference that crc16_data() must agree with */
+static unsigned short
+reference_crc(const unsigned char *p, int len, unsigned short acc)
+{
+  while(len-- > 0) {
+    acc = crc16_add(*p++, acc);
+  }
+  return acc;
+}
+
+UNIT_TEST_REGISTER(test_crc16_vector, "Check value");
+UNIT_TEST(test_crc16_vector)
+{
+  UNIT_TEST_BEGIN();
+
+  /* CRC-16/KERMIT check value for "123456789" */
+  UNIT_TEST_ASSERT(crc16_data((const unsigned char *)"123456789", 9, 0)
+                   == 0x2189);
+  UNIT_TEST_ASSERT(crc16_data(buf, 0, 0x1234) == 0x1234);
+
+  UNIT_TEST_END();
+}
+
+UNIT_TEST_REGISTER(test_crc16_reference, "Reference");
+UNIT_TEST(test_crc16_reference)
+{
+  int len;
+  int offset;
+
+  UNIT_TEST_BEGIN();
+
+  /* Every length and alignment, including the tails of the block loop */
+  for(offset = 0; offset < 4; offset++) {
+    for(len = 0; len <= DATA_LEN - 4; len++) {
+      UNIT_TEST_ASSERT(crc16_data(&buf[offset], len, 0) ==
+                       reference_crc(&buf[offset], len, 0));
+      UNIT_TEST_ASSERT(crc16_data(&buf[offset], len, 0xffff) ==
+                       reference_crc(&buf[offset], len, 0xffff));
+    }
+  }
+
+  UNIT_TEST_END();
+}
+
+UNIT_TEST_REGISTER(test_crc16_stream, "Stream");
+UNIT_TEST(test_crc16_stream)
+{
+  struct crc16_ctx ctx;
+  int chunk;
+  int pos;
+  int n;
+
+  UNIT_TEST_BEGIN();
+
+  for(chunk = 1; chunk <= 17; chunk++) {
+    crc16_init(&ctx, 0);
+    for(pos = 0; pos < DATA_LEN; pos += n) {
+      n = DATA_LEN - pos < chunk ? DATA_LEN - pos : chunk;
+      crc16_update(&ctx, &buf[pos], n);
+    }
+    UNIT_TEST_ASSERT(crc16_final(&ctx) == reference_crc(buf, DATA_LEN, 0));
+  }
+
+  UNIT_TEST_END();
+}
+
+static void
+benchmark(void)
+{
+  rtimer_clock_t start;
+  rtimer_clock_t bytewise;
+  rtimer_clock_t block;
+  volatile unsigned short crc;
+  int i;
+
+  start = RTIMER_NOW();
+  for(i = 0; i < BENCH_RUNS; i++) {
+    crc = reference_crc(buf, BENCH_LEN, 0);
+  }
+  bytewise = RTIMER_NOW() - start;
+
+  start = RTIMER_NOW();
+  for(i = 0; i < BENCH_RUNS; i++) {
+    crc = crc16_data(buf, BENCH_LEN, 0);
+  }
+  block = RTIMER_NOW() - start;
+  (void)crc;
+
+  printf("crc16 impl %u: %lu bytes, crc16_add %lu ticks, crc16_data %lu ticks (%lu ticks/s)\n",
+         CRC16_IMPL, (unsigned long)BENCH_LEN * BENCH_RUNS,
+         (unsigned long)bytewise, (unsigned long)block,
+         (unsigned long)RTIMER_SECOND);
+}
+
+PROCESS_THREAD(test_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+  printf("Run unit-test\n");
+  printf("---\n");
+
+  for(i = 0; i < BENCH_LEN; i++) {
+    buf[i] = (i * 7 + 13) ^ (i >> 3);
+  }
+
+  UNIT_TEST_RUN(test_crc16_vector);
+  UNIT_TEST_RUN(test_crc16_reference);
+  UNIT_TEST_RUN(test_crc16_stream);
+
+  benchmark();
+
+  printf("=check-me= DONE\n");
+  PROCESS_END();
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+package org.contikios.cooja.mspmote.interfaces;
+
+import java.util.Collection;
+import java.util.Observable;
+import java.util.Observer;
+
+import javax.swing.BoxLayout;
+import javax.swing.JLabel;
+import javax.swing.JPanel;
+
+import org.apache.log4j.Logger;
+import org.jdom.Element;
+
+import org.contikios.cooja.ClassDescription;
+import org.contikios.cooja.Mote;
+import org.contikios.cooja.MoteInterface;
+import org.contikios.cooja.mote.memory.VarMemory;
+import org.contikios.cooja.mspmote.MspMote;
+import org.contikios.cooja.util.TraceFile;
+import se.sics.mspsim.core.Memory;
+import se.sics.mspsim.core.MemoryMonitor;
+
+/**
+ * Binary trace mote interface for MSPSim motes.
+ *
+ * Observes writes to the Contiki variable cooja_trace_ptr, set by
+ * cpu/msp430/mspsim-trace.c for every record written by
+ * core/sys/trace.c. The record the pointer points to is appended to the
+ * trace file shared by all motes of the simulation, see TraceFile. The
+ * record is copied out while the write executes, so none are lost.
+ *
+ * The interface is disabled if the firmware was built without
+ * TRACE_CONF_ENABLED.
+ */
+@ClassDescription("Binary trace")
+public class MspTrace extends MoteInterface {
+  private static Logger logger = Logger.getLogger(MspTrace.class);
+
+  private final static String CONTIKI_POINTER = "cooja_trace_ptr";
+
+  private MspMote mote;
+  private VarMemory mem;
+  private MemoryMonitor memoryMonitor = null;
+  private byte[] lastRecord = null;
+  private long records = 0;
+
+  public MspTrace(Mote mote) {
+    this.mote = (MspMote) mote;
+    this.mem = new VarMemory(this.mote.getMemory());
+
+    if (!mem.variableExists(CONTIKI_POINTER)) {
+      /* Disabled */
+      return;
+    }
+    TraceFile.register(mote.getSimulation());
+    this.mote.getCPU().addWatchPoint((int) mem.getVariableAddress(CONTIKI_POINTER),
+        memoryMonitor = new MemoryMonitor.Adapter() {
+        @Override
+        public void notifyWriteAfter(int adr, int data, Memory.AccessMode mode) {
+          readRecord(data);
+        }
+    });
+  }
+
+  private void readRecord(int address) {
+    byte[] header = mote.getMemory().getMemorySegment(address, 2);
+    int len = 2 + (header[1] & 0xff);
+    byte[] record = mote.getMemory().getMemorySegment(address, len);
+
+    if (TraceFile.write(mote, record, len) != 1) {
+      logger.warn("Bad trace record from mote " + mote.getID());
+      return;
+    }
+    records++;
+    lastRecord = record;
+    setChanged();
+    notifyObservers(mote);
+  }
+
+  /**
+   * @return Last record collected, or null
+   */
+  public byte[] getLastRecord() {
+    return lastRecord;
+  }
+
+  public JPanel getInterfaceVisualizer() {
+    JPanel panel = new JPanel();
+    panel.setLayout(new BoxLayout(panel, BoxLayout.Y_AXIS));
+
+    final JLabel statusLabel = new JLabel();
+    statusLabel.setText("Records: " + records);
+    panel.add(statusLabel);
+
+    Observer observer;
+    this.addObserver(observer = new Observer() {
+      public void update(Observable obs, Object obj) {
+        statusLabel.setText("Records: " + records);
+      }
+    });
+
+    // Saving observer reference for releaseInterfaceVisualizer
+    panel.putClientProperty("intf_obs", observer);
+
+    return panel;
+  }
+
+  public void releaseInterfaceVisualizer(JPanel panel) {
+    Observer observer = (Observer) panel.getClientProperty("intf_obs");
+    if (observer == null) {
+      logger.fatal("Error when releasing panel, observer is null");
+      return;
+    }
+
+    this.deleteObserver(observer);
+  }
+
+  public Collection<Element> getConfigXML() {
+    return null;
+  }
+
+  public void setConfigXML(Collection<Element> configXML, boolean visAvailable) {
+    /* Observed Contiki pointer is hardcoded */
+  }
+
+  public void removed() {
+    super.removed();
+
+    if (memoryMonitor != null) {
+      mote.getCPU().removeWatchPoint((int) mem.getVariableAddress(CONTIKI_POINTER), memoryMonitor);
+      TraceFile.release();
+    }
+  }
+}
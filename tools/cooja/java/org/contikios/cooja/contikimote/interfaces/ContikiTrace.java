@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+package org.contikios.cooja.contikimote.interfaces;
+
+import java.util.Collection;
+import java.util.Observable;
+import java.util.Observer;
+
+import javax.swing.BoxLayout;
+import javax.swing.JLabel;
+import javax.swing.JPanel;
+
+import org.apache.log4j.Logger;
+import org.jdom.Element;
+
+import org.contikios.cooja.ClassDescription;
+import org.contikios.cooja.Mote;
+import org.contikios.cooja.MoteInterface;
+import org.contikios.cooja.contikimote.ContikiMoteInterface;
+import org.contikios.cooja.interfaces.PolledAfterActiveTicks;
+import org.contikios.cooja.mote.memory.VarMemory;
+import org.contikios.cooja.util.TraceFile;
+
+/**
+ * Binary trace mote interface.
+ *
+ * Collects the structured trace records written by core/sys/trace.c and
+ * appends them to the trace file shared by all motes of the simulation,
+ * see TraceFile. Records the mote could not buffer during a tick are
+ * reported as a record of type 0 holding the lost count.
+ *
+ * Contiki variables:
+ * <ul>
+ * <li>char simTraceFlag (1=mote has new records)
+ * <li>int simTraceLength
+ * <li>int simTraceLost
+ * <li>byte[] simTraceData
+ * </ul>
+ * <p>
+ *
+ * Core interface:
+ * <ul>
+ * <li>simtrace_interface
+ * </ul>
+ * <p>
+ * This observable notifies observers when new records have been collected.
+ */
+@ClassDescription("Binary trace")
+public class ContikiTrace extends MoteInterface implements ContikiMoteInterface, PolledAfterActiveTicks {
+  private static Logger logger = Logger.getLogger(ContikiTrace.class);
+
+  private Mote mote;
+  private VarMemory moteMem;
+  private byte[] lastRecords = null;
+  private long records = 0;
+  private long lost = 0;
+
+  public ContikiTrace(Mote mote) {
+    this.mote = mote;
+    this.moteMem = new VarMemory(mote.getMemory());
+    TraceFile.register(mote.getSimulation());
+  }
+
+  public static String[] getCoreInterfaceDependencies() {
+    return new String[]{"simtrace_interface"};
+  }
+
+  /**
+   * @return Raw records collected in the last tick, or null
+   */
+  public byte[] getLastRecords() {
+    return lastRecords;
+  }
+
+  public void doActionsAfterTick() {
+    if (moteMem.getByteValueOf("simTraceFlag") != 1) {
+      return;
+    }
+
+    int len = moteMem.getIntValueOf("simTraceLength");
+    int lostNow = moteMem.getIntValueOf("simTraceLost");
+    byte[] data = moteMem.getByteArray("simTraceData", len);
+
+    moteMem.setByteValueOf("simTraceFlag", (byte) 0);
+    moteMem.setIntValueOf("simTraceLength", 0);
+    moteMem.setIntValueOf("simTraceLost", 0);
+
+    records += TraceFile.write(mote, data, len);
+    if (lostNow > 0) {
+      TraceFile.writeLost(mote, lostNow);
+      lost += lostNow;
+    }
+
+    lastRecords = data;
+    this.setChanged();
+    this.notifyObservers(mote);
+  }
+
+  public void removed() {
+    super.removed();
+    TraceFile.release();
+  }
+
+  public JPanel getInterfaceVisualizer() {
+    JPanel panel = new JPanel();
+    panel.setLayout(new BoxLayout(panel, BoxLayout.Y_AXIS));
+
+    final JLabel statusLabel = new JLabel();
+    statusLabel.setText("Records: " + records + ", lost: " + lost);
+    panel.add(statusLabel);
+
+    Observer observer;
+    this.addObserver(observer = new Observer() {
+      public void update(Observable obs, Object obj) {
+        statusLabel.setText("Records: " + records + ", lost: " + lost);
+      }
+    });
+
+    // Saving observer reference for releaseInterfaceVisualizer
+    panel.putClientProperty("intf_obs", observer);
+
+    return panel;
+  }
+
+  public void releaseInterfaceVisualizer(JPanel panel) {
+    Observer observer = (Observer) panel.getClientProperty("intf_obs");
+    if (observer == null) {
+      logger.fatal("Error when releasing panel, observer is null");
+      return;
+    }
+
+    this.deleteObserver(observer);
+  }
+
+  public Collection<Element> getConfigXML() {
+    return null;
+  }
+
+  public void setConfigXML(Collection<Element> configXML, boolean visAvailable) {
+  }
+
+}
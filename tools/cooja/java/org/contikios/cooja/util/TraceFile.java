@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+package org.contikios.cooja.util;
+
+import java.io.BufferedOutputStream;
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.io.OutputStream;
+import java.util.Observable;
+import java.util.Observer;
+
+import org.apache.log4j.Logger;
+
+import org.contikios.cooja.Mote;
+import org.contikios.cooja.Simulation;
+
+/**
+ * Trace file shared by the binary trace interfaces of all motes.
+ *
+ * Each record is prefixed with the simulation time (microseconds, 8 bytes)
+ * and the mote ID (2 bytes), all little-endian, after which the mote's
+ * own type, length and payload bytes follow unchanged. The file starts
+ * with the four bytes "CTR1". Records a mote could not hand over are
+ * reported as a record of type 0 holding the lost count.
+ * tools/trace-decode converts the file into CSV.
+ *
+ * The file is COOJA.trace in the current directory, or the path given by
+ * the cooja.trace system property. It is flushed once per simulated
+ * second, when the simulation stops, and when the JVM exits, so a
+ * headless run that is terminated keeps all but the last second.
+ */
+public class TraceFile {
+  private static Logger logger = Logger.getLogger(TraceFile.class);
+
+  public static final byte TRACE_LOST = 0;
+
+  private static final byte[] FILE_MAGIC = { 'C', 'T', 'R', '1' };
+  private static final long FLUSH_INTERVAL = 1000 * Simulation.MILLISECOND;
+
+  private static OutputStream out = null;
+  private static int users = 0;
+  private static long lastFlush = 0;
+
+  private static Simulation simulation = null;
+  private static Observer simulationObserver = null;
+  private static Thread shutdownHook = null;
+
+  /**
+   * Registers a trace interface of a mote in the given simulation.
+   * The file is closed when the last interface is released.
+   *
+   * @param sim Simulation
+   */
+  public static synchronized void register(Simulation sim) {
+    users++;
+    if (simulation == null) {
+      simulation = sim;
+      simulation.addObserver(simulationObserver = new Observer() {
+        public void update(Observable obs, Object obj) {
+          if (!((Simulation) obs).isRunning()) {
+            flush();
+          }
+        }
+      });
+    }
+    if (shutdownHook == null) {
+      shutdownHook = new Thread() {
+        public void run() {
+          flush();
+        }
+      };
+      Runtime.getRuntime().addShutdownHook(shutdownHook);
+    }
+  }
+
+  /**
+   * Releases a trace interface registered with register().
+   */
+  public static synchronized void release() {
+    users--;
+    if (users > 0) {
+      return;
+    }
+    if (simulation != null) {
+      simulation.deleteObserver(simulationObserver);
+      simulation = null;
+      simulationObserver = null;
+    }
+    if (shutdownHook != null) {
+      try {
+        Runtime.getRuntime().removeShutdownHook(shutdownHook);
+      } catch (IllegalStateException e) {
+        /* Already shutting down, the hook flushes the file */
+      }
+      shutdownHook = null;
+    }
+    if (out == null) {
+      return;
+    }
+    try {
+      out.close();
+    } catch (IOException e) {
+      logger.error("Trace file close failed: " + e.getMessage());
+    }
+    out = null;
+  }
+
+  /**
+   * Appends the complete records in data to the trace file.
+   *
+   * @param mote Mote that wrote the records
+   * @param data Records
+   * @param len Number of bytes used in data
+   * @return Number of records written
+   */
+  public static synchronized int write(Mote mote, byte[] data, int len) {
+    int pos = 0;
+    int records = 0;
+    try {
+      byte[] prefix = open(mote);
+      while (pos + 2 <= len) {
+        int recordLen = 2 + (data[pos + 1] & 0xff);
+        if (pos + recordLen > len) {
+          logger.warn("Truncated trace record from mote " + mote.getID());
+          break;
+        }
+        out.write(prefix);
+        out.write(data, pos, recordLen);
+        pos += recordLen;
+        records++;
+      }
+      flushPeriodically(mote);
+    } catch (IOException e) {
+      logger.error("Trace file write failed: " + e.getMessage());
+    }
+    return records;
+  }
+
+  /**
+   * Appends a record of type TRACE_LOST to the trace file.
+   *
+   * @param mote Mote that lost records
+   * @param lost Number of lost records
+   */
+  public static synchronized void writeLost(Mote mote, int lost) {
+    try {
+      byte[] prefix = open(mote);
+      out.write(prefix);
+      out.write(new byte[] {
+          TRACE_LOST, 2, (byte) lost, (byte) (lost >> 8) });
+    } catch (IOException e) {
+      logger.error("Trace file write failed: " + e.getMessage());
+    }
+  }
+
+  /* Opens the file if needed and returns the record prefix for the mote */
+  private static byte[] open(Mote mote) throws IOException {
+    if (out == null) {
+      String name = System.getProperty("cooja.trace", "COOJA.trace");
+      out = new BufferedOutputStream(new FileOutputStream(new File(name)));
+      out.write(FILE_MAGIC);
+      lastFlush = mote.getSimulation().getSimulationTime();
+    }
+
+    long time = mote.getSimulation().getSimulationTime();
+    byte[] prefix = new byte[10];
+    for (int i = 0; i < 8; i++) {
+      prefix[i] = (byte) (time >> (8 * i));
+    }
+    prefix[8] = (byte) mote.getID();
+    prefix[9] = (byte) (mote.getID() >> 8);
+    return prefix;
+  }
+
+  private static void flushPeriodically(Mote mote) throws IOException {
+    long time = mote.getSimulation().getSimulationTime();
+    if (time - lastFlush >= FLUSH_INTERVAL) {
+      out.flush();
+      lastFlush = time;
+    }
+  }
+
+  private static synchronized void flush() {
+    if (out == null) {
+      return;
+    }
+    try {
+      out.flush();
+    } catch (IOException e) {
+      logger.error("Trace file flush failed: " + e.getMessage());
+    }
+  }
+}
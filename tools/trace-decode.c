@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Decoder for the binary trace files written by the Cooja
+ *         ContikiTrace mote interface (see core/sys/trace.h).
+ *
+ *         By default all records are printed as one CSV table with a
+ *         fixed set of columns, the fields that do not apply to a
+ *         record type left empty. With -s PREFIX every record type is
+ *         written to its own table, PREFIX-tx.csv, PREFIX-rx.csv and so
+ *         on, holding only the columns of that type. Both forms load
+ *         directly into column-oriented tools.
+ *
+ *         Usage: trace-decode [-s prefix] [COOJA.trace]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+/* Record types, see core/sys/trace.h. Type 0 is added by Cooja. */
+enum {
+  LOST, PACKET_TX, PACKET_RX, PACKET_DROP, SLOT, QUEUE, NTYPES
+};
+
+static const char *type_names[NTYPES] = {
+  "lost", "tx", "rx", "drop", "slot", "queue"
+};
+
+/* Per-type column headers, used with -s */
+static const char *type_headers[NTYPES] = {
+  "time_us,mote,count",
+  "time_us,mote,addr,len,status,transmissions",
+  "time_us,mote,addr,len,rssi",
+  "time_us,mote,addr,len,reason",
+  "time_us,mote,timeslot,channel,event",
+  "time_us,mote,queue,length"
+};
+
+/* Minimum payload length of each type */
+static const int type_minlen[NTYPES] = { 2, 6, 5, 5, 4, 2 };
+
+#define WIDE_HEADER "time_us,mote,type,addr,len,status,transmissions," \
+  "rssi,reason,timeslot,channel,event,queue,length,count"
+
+static FILE *tables[NTYPES];
+/*---------------------------------------------------------------------------*/
+static unsigned
+u16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long long
+u64(const uint8_t *p)
+{
+  unsigned long long v = 0;
+  int i;
+
+  for(i = 7; i >= 0; i--) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+/*---------------------------------------------------------------------------*/
+/* Print the type-specific fields, either as the compact per-type columns
+   or spread over the wide table with empty cells for absent columns. */
+static void
+print_fields(FILE *f, int type, const uint8_t *p, int wide)
+{
+  switch(type) {
+  case LOST:
+    fprintf(f, wide ? ",,,,,,,,,,,,%u" : ",%u", u16(p));
+    break;
+  case PACKET_TX:
+    fprintf(f, wide ? ",%02x.%02x,%u,%u,%u,,,,,,,," : ",%02x.%02x,%u,%u,%u",
+            p[0], p[1], u16(p + 2), p[4], p[5]);
+    break;
+  case PACKET_RX:
+    fprintf(f, wide ? ",%02x.%02x,%u,,,%d,,,,,,," : ",%02x.%02x,%u,%d",
+            p[0], p[1], u16(p + 2), (int8_t)p[4]);
+    break;
+  case PACKET_DROP:
+    fprintf(f, wide ? ",%02x.%02x,%u,,,,%u,,,,,," : ",%02x.%02x,%u,%u",
+            p[0], p[1], u16(p + 2), p[4]);
+    break;
+  case SLOT:
+    fprintf(f, wide ? ",,,,,,,%u,%u,%u,,," : ",%u,%u,%u",
+            u16(p), p[2], p[3]);
+    break;
+  case QUEUE:
+    fprintf(f, wide ? ",,,,,,,,,,%u,%u," : ",%u,%u", p[0], p[1]);
+    break;
+  }
+  fputc('\n', f);
+}
+/*---------------------------------------------------------------------------*/
+static FILE *
+table(const char *prefix, int type)
+{
+  char name[FILENAME_MAX];
+
+  if(tables[type] == NULL) {
+    snprintf(name, sizeof(name), "%s-%s.csv", prefix, type_names[type]);
+    tables[type] = fopen(name, "w");
+    if(tables[type] == NULL) {
+      err(1, "%s", name);
+    }
+    fprintf(tables[type], "%s\n", type_headers[type]);
+  }
+  return tables[type];
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  const char *prefix = NULL;
+  const char *name = "COOJA.trace";
+  uint8_t hdr[12], payload[256], magic[4];
+  unsigned long skipped = 0;
+  FILE *in, *f;
+  int c, i, type, len;
+
+  while((c = getopt(argc, argv, "s:h")) != -1) {
+    switch(c) {
+    case 's':
+      prefix = optarg;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-s prefix] [tracefile]\n", argv[0]);
+      return 1;
+    }
+  }
+  if(optind < argc) {
+    name = argv[optind];
+  }
+
+  in = strcmp(name, "-") == 0 ? stdin : fopen(name, "rb");
+  if(in == NULL) {
+    err(1, "%s", name);
+  }
+  if(fread(magic, 1, 4, in) != 4 || memcmp(magic, "CTR1", 4) != 0) {
+    errx(1, "%s: not a trace file", name);
+  }
+
+  if(prefix == NULL) {
+    printf("%s\n", WIDE_HEADER);
+  }
+
+  /* time[8] mote[2] type[1] len[1] payload[len] */
+  while(fread(hdr, 1, sizeof(hdr), in) == sizeof(hdr)) {
+    type = hdr[10];
+    len = hdr[11];
+    if(fread(payload, 1, len, in) != (size_t)len) {
+      warnx("%s: truncated record at end of file", name);
+      break;
+    }
+    if(type >= NTYPES || len < type_minlen[type]) {
+      skipped++;
+      continue;
+    }
+    if(prefix == NULL) {
+      f = stdout;
+      fprintf(f, "%llu,%u,%s", u64(hdr), u16(hdr + 8), type_names[type]);
+      print_fields(f, type, payload, 1);
+    } else {
+      f = table(prefix, type);
+      fprintf(f, "%llu,%u", u64(hdr), u16(hdr + 8));
+      print_fields(f, type, payload, 0);
+    }
+  }
+
+  if(skipped > 0) {
+    warnx("%lu records of unknown type skipped", skipped);
+  }
+  for(i = 0; i < NTYPES; i++) {
+    if(tables[i] != NULL) {
+      fclose(tables[i]);
+    }
+  }
+  if(in != stdin) {
+    fclose(in);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
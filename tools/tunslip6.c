@@ -35,12 +35,19 @@
  /* Below define allows importing saved output into Wireshark as "Raw IP" packet type */
 #define WIRESHARK_IMPORT_FORMAT 1
 
+#ifdef linux
+#define _GNU_SOURCE /* posix_openpt() for the loopback mode */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
 #include <time.h>
+#include <stdint.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 
 #include <unistd.h>
 #include <errno.h>
@@ -165,179 +172,314 @@ is_sensible_string(const unsigned char *s, int len)
 }
 
 /*
- * Read from serial, when we have a packet write it to tun. No output
- * buffering, input buffered by stdio.
+ * Statistics, enabled with -S and printed on SIGUSR1 and at exit.
  */
+struct {
+  unsigned long tun_packets, tun_bytes;
+  unsigned long slip_packets, slip_bytes;
+  unsigned long slip_reads, slip_writes, slip_full;
+  unsigned long dropped;
+  unsigned long max_queued;
+  unsigned long latency_samples;
+  unsigned long long latency_total;
+  unsigned long latency_max;
+} stats;
+int showstats = 0;
+static volatile sig_atomic_t got_sigusr1;
+
+/* Number of frames to send through the pty pair in loopback mode. */
+long loopback = 0;
+static long loopback_received, loopback_errors;
+static void loopback_check(const unsigned char *buf, int len);
+
+static unsigned long
+usec_since(const struct timeval *t)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - t->tv_sec) * 1000000UL + now.tv_usec - t->tv_usec;
+}
+
 void
-serial_to_tun(FILE *inslip, int outfd)
+print_stats(void)
 {
-  static union {
-    unsigned char inbuf[2000];
-  } uip;
-  static int inbufptr = 0;
-  int ret,i;
-  unsigned char c;
+  fprintf(stderr, "*** tun -> slip: %lu packets, %lu bytes,"
+          " %lu writes, %lu times full, max %lu bytes queued\n",
+          stats.tun_packets, stats.tun_bytes, stats.slip_writes,
+          stats.slip_full, stats.max_queued);
+  fprintf(stderr, "*** slip queue latency: avg %lu us, max %lu us\n",
+          stats.latency_samples ?
+          (unsigned long)(stats.latency_total / stats.latency_samples) : 0,
+          stats.latency_max);
+  fprintf(stderr, "*** slip -> tun: %lu packets, %lu bytes, %lu reads,"
+          " %lu dropped\n",
+          stats.slip_packets, stats.slip_bytes, stats.slip_reads,
+          stats.dropped);
+}
 
-#ifdef linux
-  ret = fread(&c, 1, 1, inslip);
-  if(ret == -1 || ret == 0) err(1, "serial_to_tun: read");
-  goto after_fread;
-#endif
+/*
+ * SLIP input state. Frames are decoded into slip_inbuf as the bytes
+ * arrive from the serial line.
+ */
+static unsigned char slip_inbuf[2000];
+static int slip_inbufptr = 0;
+static int slip_inesc = 0;
 
- read_more:
-  if(inbufptr >= sizeof(uip.inbuf)) {
-     if(timestamp) stamptime();
-     fprintf(stderr, "*** dropping large %d byte packet\n",inbufptr);
-	 inbufptr = 0;
-  }
-  ret = fread(&c, 1, 1, inslip);
-#ifdef linux
- after_fread:
-#endif
-  if(ret == -1) {
-    err(1, "serial_to_tun: read");
-  }
-  if(ret == 0) {
-    clearerr(inslip);
+/*
+ * Handle a complete frame from the serial line: either a command or
+ * debug output from the node, or a packet that is written to tun.
+ */
+static void
+slip_input_frame(int outfd)
+{
+  unsigned char *inbuf = slip_inbuf;
+  int inbufptr = slip_inbufptr;
+  int i;
+
+  slip_inbufptr = 0;
+  if(inbufptr == 0) {
     return;
   }
-  PROGRESS(".");
-  switch(c) {
-  case SLIP_END:
-    if(inbufptr > 0) {
-      if(uip.inbuf[0] == '!') {
-	if(uip.inbuf[1] == 'M') {
-	  /* Read gateway MAC address and autoconfigure tap0 interface */
-	  char macs[24];
-	  int i, pos;
-	  for(i = 0, pos = 0; i < 16; i++) {
-	    macs[pos++] = uip.inbuf[2 + i];
-	    if((i & 1) == 1 && i < 14) {
-	      macs[pos++] = ':';
-	    }
-	  }
-          if(timestamp) stamptime();
-	  macs[pos] = '\0';
-//	  printf("*** Gateway's MAC address: %s\n", macs);
-	  fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s down", tundev);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s up", tundev);
+
+  if(inbuf[0] == '!') {
+    if(inbuf[1] == 'M') {
+      /* Read gateway MAC address and autoconfigure tap0 interface */
+      char macs[24];
+      int i, pos;
+      for(i = 0, pos = 0; i < 16; i++) {
+	macs[pos++] = inbuf[2 + i];
+	if((i & 1) == 1 && i < 14) {
+	  macs[pos++] = ':';
 	}
-      } else if(uip.inbuf[0] == '?') {
-	if(uip.inbuf[1] == 'P') {
-          /* Prefix info requested */
-          struct in6_addr addr;
-	  int i;
-	  char *s = strchr(ipaddr, '/');
-	  if(s != NULL) {
-	    *s = '\0';
-	  }
-          inet_pton(AF_INET6, ipaddr, &addr);
-          if(timestamp) stamptime();
-          fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
-		 ipaddr,
-		 addr.s6_addr[0], addr.s6_addr[1],
-		 addr.s6_addr[2], addr.s6_addr[3],
-		 addr.s6_addr[4], addr.s6_addr[5],
-		 addr.s6_addr[6], addr.s6_addr[7]);
-	  slip_send(slipfd, '!');
-	  slip_send(slipfd, 'P');
-	  for(i = 0; i < 8; i++) {
-	    /* need to call the slip_send_char for stuffing */
-	    slip_send_char(slipfd, addr.s6_addr[i]);
-	  }
-	  slip_send(slipfd, SLIP_END);
-        }
+      }
+      if(timestamp) stamptime();
+      macs[pos] = '\0';
+//	  printf("*** Gateway's MAC address: %s\n", macs);
+      fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s down", tundev);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s up", tundev);
+    }
+  } else if(inbuf[0] == '?') {
+    if(inbuf[1] == 'P') {
+      /* Prefix info requested */
+      struct in6_addr addr;
+      int i;
+      char *s = strchr(ipaddr, '/');
+      if(s != NULL) {
+	*s = '\0';
+      }
+      inet_pton(AF_INET6, ipaddr, &addr);
+      if(timestamp) stamptime();
+      fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
+	      ipaddr,
+	      addr.s6_addr[0], addr.s6_addr[1],
+	      addr.s6_addr[2], addr.s6_addr[3],
+	      addr.s6_addr[4], addr.s6_addr[5],
+	      addr.s6_addr[6], addr.s6_addr[7]);
+      slip_send(slipfd, '!');
+      slip_send(slipfd, 'P');
+      for(i = 0; i < 8; i++) {
+	/* need to call the slip_send_char for stuffing */
+	slip_send_char(slipfd, addr.s6_addr[i]);
+      }
+      slip_send(slipfd, SLIP_END);
+    }
 #define DEBUG_LINE_MARKER '\r'
-      } else if(uip.inbuf[0] == DEBUG_LINE_MARKER) {
-	fwrite(uip.inbuf + 1, inbufptr - 1, 1, stdout);
-      } else if(is_sensible_string(uip.inbuf, inbufptr)) {
-        if(verbose==1) {   /* strings already echoed below for verbose>1 */
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-        }
-      } else {
-        if(verbose>2) {
-          if (timestamp) stamptime();
-          printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
-          if (verbose>4) {
+  } else if(inbuf[0] == DEBUG_LINE_MARKER) {
+    fwrite(inbuf + 1, inbufptr - 1, 1, stdout);
+  } else if(is_sensible_string(inbuf, inbufptr)) {
+    if(verbose==1) {   /* strings already echoed below for verbose>1 */
+      if (timestamp) stamptime();
+      fwrite(inbuf, inbufptr, 1, stdout);
+    }
+  } else {
+    if(verbose>2) {
+      if (timestamp) stamptime();
+      printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
+      if (verbose>4) {
 #if WIRESHARK_IMPORT_FORMAT
-            printf("0000");
-	        for(i = 0; i < inbufptr; i++) printf(" %02x",uip.inbuf[i]);
+	printf("0000");
+	for(i = 0; i < inbufptr; i++) printf(" %02x",inbuf[i]);
 #else
-            printf("         ");
-            for(i = 0; i < inbufptr; i++) {
-              printf("%02x", uip.inbuf[i]);
-              if((i & 3) == 3) printf(" ");
-              if((i & 15) == 15) printf("\n         ");
-            }
-#endif
-            printf("\n");
-          }
-        }
-	if(write(outfd, uip.inbuf, inbufptr) != inbufptr) {
-	  err(1, "serial_to_tun: write");
+	printf("         ");
+	for(i = 0; i < inbufptr; i++) {
+	  printf("%02x", inbuf[i]);
+	  if((i & 3) == 3) printf(" ");
+	  if((i & 15) == 15) printf("\n         ");
 	}
+#endif
+	printf("\n");
       }
-      inbufptr = 0;
     }
-    break;
-
-  case SLIP_ESC:
-    if(fread(&c, 1, 1, inslip) != 1) {
-      clearerr(inslip);
-      /* Put ESC back and give up! */
-      ungetc(SLIP_ESC, inslip);
-      return;
+    stats.slip_packets++;
+    stats.slip_bytes += inbufptr;
+    if(loopback) {
+      loopback_check(inbuf, inbufptr);
+    } else if(write(outfd, inbuf, inbufptr) != inbufptr) {
+      err(1, "serial_to_tun: write");
     }
+  }
+}
 
-    switch(c) {
-    case SLIP_ESC_END:
-      c = SLIP_END;
-      break;
-    case SLIP_ESC_ESC:
-      c = SLIP_ESC;
-      break;
-    case SLIP_ESC_XON:
-      c = XON;
-      break;
-    case SLIP_ESC_XOFF:
-      c = XOFF;
-      break;
-    }
-    /* FALLTHROUGH */
-  default:
-    uip.inbuf[inbufptr++] = c;
-
-    /* Echo lines as they are received for verbose=2,3,5+ */
-    /* Echo all printable characters for verbose==4 */
-    if((verbose==2) || (verbose==3) || (verbose>4)) {
-      if(c=='\n') {
-        if(is_sensible_string(uip.inbuf, inbufptr)) {
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-          inbufptr=0;
-        }
-      }
-    } else if(verbose==4) {
-      if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
-	fwrite(&c, 1, 1, stdout);
-        if(c=='\n') if(timestamp) stamptime();
+static void
+slip_input_overflow(void)
+{
+  if(timestamp) stamptime();
+  fprintf(stderr, "*** dropping large %d byte packet\n", slip_inbufptr);
+  stats.dropped++;
+  slip_inbufptr = 0;
+}
+
+/*
+ * Add one decoded byte to the current frame, echoing it as the
+ * verbosity level asks for.
+ */
+static void
+slip_input_byte(unsigned char c)
+{
+  if(slip_inbufptr >= sizeof(slip_inbuf)) {
+    slip_input_overflow();
+  }
+  PROGRESS(".");
+  slip_inbuf[slip_inbufptr++] = c;
+
+  /* Echo lines as they are received for verbose=2,3,5+ */
+  /* Echo all printable characters for verbose==4 */
+  if((verbose==2) || (verbose==3) || (verbose>4)) {
+    if(c=='\n') {
+      if(is_sensible_string(slip_inbuf, slip_inbufptr)) {
+        if (timestamp) stamptime();
+        fwrite(slip_inbuf, slip_inbufptr, 1, stdout);
+        slip_inbufptr=0;
       }
     }
+  } else if(verbose==4) {
+    if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
+      fwrite(&c, 1, 1, stdout);
+      if(c=='\n') if(timestamp) stamptime();
+    }
+  }
+}
 
-    break;
+/*
+ * Add a run of bytes that contains no SLIP control characters to the
+ * current frame.
+ */
+static void
+slip_input_run(const unsigned char *p, int len)
+{
+  int n;
+
+  if(verbose > 1 || showprogress) {
+    /* The bytes must be echoed one by one. */
+    while(len-- > 0) {
+      slip_input_byte(*p++);
+    }
+    return;
   }
 
-  goto read_more;
+  while(len > 0) {
+    if(slip_inbufptr >= sizeof(slip_inbuf)) {
+      slip_input_overflow();
+    }
+    n = sizeof(slip_inbuf) - slip_inbufptr;
+    if(n > len) {
+      n = len;
+    }
+    memcpy(slip_inbuf + slip_inbufptr, p, n);
+    slip_inbufptr += n;
+    p += n;
+    len -= n;
+  }
 }
 
-unsigned char slip_buf[2000];
-int slip_end, slip_begin;
+/*
+ * Read from serial, when we have a packet write it to tun. No output
+ * buffering. The serial line is read in large chunks, and runs of
+ * bytes without SLIP control characters are copied in one go.
+ */
+void
+serial_to_tun(int infd, int outfd)
+{
+  static unsigned char rxbuf[4096];
+  const unsigned char *p, *end, *run;
+  int n;
+
+  n = read(infd, rxbuf, sizeof(rxbuf));
+  if(n == -1) {
+    if(errno == EAGAIN || errno == EINTR) {
+      return;
+    }
+    err(1, "serial_to_tun: read");
+  }
+  if(n == 0) {
+#ifdef linux
+    errx(1, "serial_to_tun: read: end of file");
+#endif
+    return;
+  }
+  stats.slip_reads++;
+
+  p = rxbuf;
+  end = rxbuf + n;
+  while(p < end) {
+    if(slip_inesc) {
+      slip_inesc = 0;
+      switch(*p) {
+      case SLIP_ESC_END:
+	slip_input_byte(SLIP_END);
+	break;
+      case SLIP_ESC_ESC:
+	slip_input_byte(SLIP_ESC);
+	break;
+      case SLIP_ESC_XON:
+	slip_input_byte(XON);
+	break;
+      case SLIP_ESC_XOFF:
+	slip_input_byte(XOFF);
+	break;
+      default:
+	slip_input_byte(*p);
+	break;
+      }
+      p++;
+    } else if(*p == SLIP_END) {
+      slip_input_frame(outfd);
+      p++;
+    } else if(*p == SLIP_ESC) {
+      slip_inesc = 1;
+      p++;
+    } else {
+      for(run = p; p < end && *p != SLIP_END && *p != SLIP_ESC; p++);
+      slip_input_run(run, p - run);
+    }
+  }
+}
+
+/*
+ * SLIP output is queued in a ring buffer that holds several frames,
+ * so that packets from tun need not wait for the serial line to drain
+ * the previous one. slip_begin and slip_end count all bytes ever
+ * written and queued; the ring offsets are these modulo SLIP_BUF_SIZE.
+ */
+#define SLIP_BUF_SIZE 16384
+/* Room needed to queue a worst-case encoded packet from tun. */
+#define SLIP_FRAME_MAX (2 * 2000 + 2)
+unsigned char slip_buf[SLIP_BUF_SIZE];
+uint64_t slip_end, slip_begin;
+
+/* Queue times of the most recent frames, for the latency statistics. */
+#define SLIP_MARKS 64
+static struct {
+  uint64_t end;
+  struct timeval queued;
+} slip_marks[SLIP_MARKS];
+static unsigned slip_mark_first, slip_mark_count;
 
 void
 slip_send_char(int fd, unsigned char c)
@@ -373,50 +515,113 @@ slip_send_char(int fd, unsigned char c)
   }
 }
 
+int
+slip_space(void)
+{
+  return SLIP_BUF_SIZE - (int)(slip_end - slip_begin);
+}
+
 void
 slip_send(int fd, unsigned char c)
 {
-  if(slip_end >= sizeof(slip_buf)) {
+  if(slip_space() == 0) {
     err(1, "slip_send overflow");
   }
-  slip_buf[slip_end] = c;
+  slip_buf[slip_end % SLIP_BUF_SIZE] = c;
   slip_end++;
 }
 
+/*
+ * Queue a run of bytes that need no escaping.
+ */
+void
+slip_send_run(int fd, const unsigned char *p, int len)
+{
+  int off, n;
+
+  if(len > slip_space()) {
+    err(1, "slip_send overflow");
+  }
+  while(len > 0) {
+    off = slip_end % SLIP_BUF_SIZE;
+    n = SLIP_BUF_SIZE - off;
+    if(n > len) {
+      n = len;
+    }
+    memcpy(slip_buf + off, p, n);
+    slip_end += n;
+    p += n;
+    len -= n;
+  }
+}
+
 int
 slip_empty()
 {
-  return slip_end == 0;
+  return slip_end == slip_begin;
 }
 
 void
 slip_flushbuf(int fd)
 {
-  int n;
+  struct iovec iov[2];
+  int off, n;
 
   if(slip_empty()) {
     return;
   }
 
-  n = write(fd, slip_buf + slip_begin, (slip_end - slip_begin));
+  /* The queued data may wrap around the end of the ring. */
+  off = slip_begin % SLIP_BUF_SIZE;
+  n = slip_end - slip_begin;
+  iov[0].iov_base = slip_buf + off;
+  if(off + n > SLIP_BUF_SIZE) {
+    iov[0].iov_len = SLIP_BUF_SIZE - off;
+    iov[1].iov_base = slip_buf;
+    iov[1].iov_len = n - iov[0].iov_len;
+    n = writev(fd, iov, 2);
+  } else {
+    iov[0].iov_len = n;
+    n = writev(fd, iov, 1);
+  }
 
   if(n == -1 && errno != EAGAIN) {
     err(1, "slip_flushbuf write failed");
   } else if(n == -1) {
     PROGRESS("Q");		/* Outqueueis full! */
+    stats.slip_full++;
   } else {
     slip_begin += n;
-    if(slip_begin == slip_end) {
-      slip_begin = slip_end = 0;
+    stats.slip_writes++;
+    while(slip_mark_count > 0 &&
+          slip_marks[slip_mark_first].end <= slip_begin) {
+      unsigned long usec = usec_since(&slip_marks[slip_mark_first].queued);
+      stats.latency_samples++;
+      stats.latency_total += usec;
+      if(usec > stats.latency_max) {
+        stats.latency_max = usec;
+      }
+      slip_mark_first = (slip_mark_first + 1) % SLIP_MARKS;
+      slip_mark_count--;
     }
   }
 }
 
+/*
+ * Returns non-zero if c must be escaped in SLIP output.
+ */
+static int
+slip_special(unsigned char c)
+{
+  return c == SLIP_END || c == SLIP_ESC ||
+    (flowcontrol_xonxoff && (c == XON || c == XOFF));
+}
+
 void
 write_to_serial(int outfd, void *inbuf, int len)
 {
   u_int8_t *p = inbuf;
-  int i;
+  int i, j;
 
   if(verbose>2) {
     if (timestamp) stamptime();
@@ -442,44 +647,36 @@ write_to_serial(int outfd, void *inbuf, int len)
    */
   /* slip_send(outfd, SLIP_END); */
 
-  for(i = 0; i < len; i++) {
-    switch(p[i]) {
-    case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
-      break;
-    case XON:
-      if(flowcontrol_xonxoff) {
-        slip_send(outfd, SLIP_ESC);
-        slip_send(outfd, SLIP_ESC_XON);
-      } else {
-        slip_send(outfd, p[i]);
-      }
-      break;
-    case XOFF:
-      if(flowcontrol_xonxoff) {
-        slip_send(outfd, SLIP_ESC);
-        slip_send(outfd, SLIP_ESC_XOFF);
-      } else {
-        slip_send(outfd, p[i]);
-      }
-      break;
-    default:
-      slip_send(outfd, p[i]);
-      break;
+  for(i = 0; i < len; i = j) {
+    /* Queue the bytes up to the next one that must be escaped in one
+       go. */
+    for(j = i; j < len && !slip_special(p[j]); j++);
+    slip_send_run(outfd, p + i, j - i);
+    if(j < len) {
+      slip_send_char(outfd, p[j]);
+      j++;
     }
   }
   slip_send(outfd, SLIP_END);
   PROGRESS("t");
+
+  stats.tun_packets++;
+  stats.tun_bytes += len;
+  if(slip_end - slip_begin > stats.max_queued) {
+    stats.max_queued = slip_end - slip_begin;
+  }
+  if(showstats && slip_mark_count < SLIP_MARKS) {
+    i = (slip_mark_first + slip_mark_count) % SLIP_MARKS;
+    slip_marks[i].end = slip_end;
+    gettimeofday(&slip_marks[i].queued, NULL);
+    slip_mark_count++;
+  }
 }
 
 
 /*
- * Read from tun, write to slip.
+ * Read from tun, write to slip. Returns the size of the packet, or
+ * -1 if there was none.
  */
 int
 tun_to_serial(int infd, int outfd)
@@ -489,12 +686,144 @@ tun_to_serial(int infd, int outfd)
   } uip;
   int size;
 
-  if((size = read(infd, uip.inbuf, 2000)) == -1) err(1, "tun_to_serial: read");
+  if((size = read(infd, uip.inbuf, 2000)) == -1) {
+    if(errno == EAGAIN || errno == EINTR) {
+      return -1;
+    }
+    err(1, "tun_to_serial: read");
+  }
 
   write_to_serial(outfd, uip.inbuf, size);
   return size;
 }
 
+/*
+ * Loopback mode: send frames through a pty pair whose other end
+ * echoes everything back, and check that they come back intact. No
+ * serial device or tun interface is needed.
+ */
+static void
+loopback_frame(long seq, unsigned char *buf, int *len)
+{
+  uint32_t x;
+  int i;
+
+  x = seq * 2654435761UL + 1;
+  *len = 40 + seq % 1200;
+  buf[0] = 0x60;
+  for(i = 1; i < *len; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    buf[i] = x;
+  }
+  /* Make sure that every frame has something to escape, and is never
+     taken for a printable string. */
+  buf[1] = SLIP_END;
+  buf[*len - 1] = SLIP_ESC;
+}
+
+static void
+loopback_check(const unsigned char *buf, int len)
+{
+  unsigned char expected[2000];
+  int expected_len;
+
+  loopback_frame(loopback_received, expected, &expected_len);
+  if(len != expected_len || memcmp(buf, expected, len) != 0) {
+    fprintf(stderr, "*** loopback: frame %ld corrupted (%d bytes, expected %d)\n",
+            loopback_received, len, expected_len);
+    loopback_errors++;
+  }
+  loopback_received++;
+}
+
+void
+loopback_run(void)
+{
+  unsigned char buf[2000], echo[4096];
+  int peerfd, echolen, echooff, len, maxfd, ret;
+  long sent;
+  struct termios tty;
+  struct timeval start, tv;
+  fd_set rset, wset;
+
+  slipfd = posix_openpt(O_RDWR | O_NOCTTY);
+  if(slipfd == -1 || grantpt(slipfd) == -1 || unlockpt(slipfd) == -1) {
+    err(1, "loopback: can't open pty");
+  }
+  peerfd = open(ptsname(slipfd), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if(peerfd == -1) {
+    err(1, "loopback: can't open ``%s''", ptsname(slipfd));
+  }
+  if(tcgetattr(peerfd, &tty) == -1) err(1, "tcgetattr");
+  cfmakeraw(&tty);
+  if(tcsetattr(peerfd, TCSANOW, &tty) == -1) err(1, "tcsetattr");
+  fcntl(slipfd, F_SETFL, O_NONBLOCK);
+  fprintf(stderr, "********SLIP loopback on ``%s''\n", ptsname(slipfd));
+
+  sent = 0;
+  echolen = echooff = 0;
+  gettimeofday(&start, NULL);
+  while(loopback_received < loopback) {
+    while(sent < loopback && slip_space() >= SLIP_FRAME_MAX) {
+      loopback_frame(sent++, buf, &len);
+      write_to_serial(slipfd, buf, len);
+    }
+
+    FD_ZERO(&rset);
+    FD_ZERO(&wset);
+    FD_SET(slipfd, &rset);
+    if(!slip_empty()) {
+      FD_SET(slipfd, &wset);
+    }
+    if(echolen == 0) {
+      FD_SET(peerfd, &rset);
+    } else {
+      FD_SET(peerfd, &wset);
+    }
+    maxfd = slipfd > peerfd ? slipfd : peerfd;
+
+    tv.tv_sec = 5;
+    tv.tv_usec = 0;
+    ret = select(maxfd + 1, &rset, &wset, NULL, &tv);
+    if(ret == -1 && errno != EINTR) {
+      err(1, "select");
+    } else if(ret == 0) {
+      errx(1, "loopback: timeout after %ld of %ld frames",
+           loopback_received, loopback);
+    } else if(ret > 0) {
+      if(FD_ISSET(slipfd, &rset)) {
+        serial_to_tun(slipfd, -1);
+      }
+      if(FD_ISSET(slipfd, &wset)) {
+        slip_flushbuf(slipfd);
+      }
+      if(FD_ISSET(peerfd, &rset)) {
+        ret = read(peerfd, echo, sizeof(echo));
+        if(ret > 0) {
+          echolen = ret;
+          echooff = 0;
+        }
+      }
+      if(FD_ISSET(peerfd, &wset)) {
+        ret = write(peerfd, echo + echooff, echolen - echooff);
+        if(ret > 0) {
+          echooff += ret;
+          if(echooff == echolen) {
+            echolen = 0;
+          }
+        }
+      }
+    }
+  }
+
+  fprintf(stderr, "*** loopback: %ld frames, %lu bytes in %lu ms, %ld errors\n",
+          loopback_received, stats.slip_bytes, usec_since(&start) / 1000,
+          loopback_errors);
+  exit(loopback_errors ? 1 : 0);
+}
+
 void
 stty_telos(int fd)
 {
@@ -639,6 +968,12 @@ sigcleanup(int signo)
 
 static int got_sigalarm;
 
+void
+sigusr1(int signo)
+{
+  got_sigusr1 = 1;
+}
+
 void
 sigalarm(int signo)
 {
@@ -749,7 +1084,6 @@ main(int argc, char **argv)
   int tunfd, maxfd;
   int ret;
   fd_set rset, wset;
-  FILE *inslip;
   const char *siodev = NULL;
   const char *host = NULL;
   const char *port = NULL;
@@ -762,7 +1096,7 @@ main(int argc, char **argv)
   prog = argv[0];
   setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
 
-  while((c = getopt(argc, argv, "B:HILPhXM:s:t:v::d::a:p:T")) != -1) {
+  while((c = getopt(argc, argv, "B:HILPhXM:s:t:v::d::a:p:TSl:")) != -1) {
     switch(c) {
     case 'B':
       baudrate = atoi(optarg);
@@ -833,6 +1167,14 @@ main(int argc, char **argv)
       tap = 1;
       break;
 
+    case 'S':
+      showstats = 1;
+      break;
+
+    case 'l':
+      loopback = atol(optarg);
+      break;
+
     case '?':
     case 'h':
     default:
@@ -865,6 +1207,8 @@ fprintf(stderr,"                Actual delay is basedelay*(#6LowPAN fragments) m
 fprintf(stderr,"                -d is equivalent to -d10.\n");
 fprintf(stderr," -a serveraddr  \n");
 fprintf(stderr," -p serverport  \n");
+fprintf(stderr," -S             Print statistics on SIGUSR1 and at exit\n");
+fprintf(stderr," -l frames      Loopback test through a pty pair, no tun or serial device\n");
 exit(1);
       break;
     }
@@ -872,6 +1216,14 @@ exit(1);
   argc -= (optind - 1);
   argv += (optind - 1);
 
+  if(showstats) {
+    atexit(print_stats);
+    signal(SIGUSR1, sigusr1);
+  }
+  if(loopback > 0) {
+    loopback_run();
+  }
+
   if(argc != 2 && argc != 3) {
     err(1, "usage: %s [-B baudrate] [-H] [-L] [-s siodev] [-t tundev] [-T] [-v verbosity] [-d delay] [-a serveraddress] [-p serverport] ipaddress", prog);
   }
@@ -957,11 +1309,10 @@ exit(1);
     stty_telos(slipfd);
   }
   slip_send(slipfd, SLIP_END);
-  inslip = fdopen(slipfd, "r");
-  if(inslip == NULL) err(1, "main: fdopen");
 
   tunfd = tun_alloc(tundev, tap);
   if(tunfd == -1) err(1, "main: open /dev/tun");
+  fcntl(tunfd, F_SETFL, O_NONBLOCK);
   if (timestamp) stamptime();
   fprintf(stderr, "opened %s device ``/dev/%s''\n",
           tap ? "tap" : "tun", tundev);
@@ -988,6 +1339,11 @@ exit(1);
       got_sigalarm = 0;
     }
 
+    if(got_sigusr1) {
+      print_stats();
+      got_sigusr1 = 0;
+    }
+
     if(!slip_empty()) {		/* Anything to flush? */
       FD_SET(slipfd, &wset);
     }
@@ -995,8 +1351,9 @@ exit(1);
     FD_SET(slipfd, &rset);	/* Read from slip ASAP! */
     if(slipfd > maxfd) maxfd = slipfd;
 
-    /* We only have one packet at a time queued for slip output. */
-    if(slip_empty()) {
+    /* Read from tun as long as a full packet fits in the slip output
+       queue. */
+    if(slip_space() >= SLIP_FRAME_MAX) {
       FD_SET(tunfd, &rset);
       if(tunfd > maxfd) maxfd = tunfd;
     }
@@ -1006,7 +1363,7 @@ exit(1);
       err(1, "select");
     } else if(ret > 0) {
       if(FD_ISSET(slipfd, &rset)) {
-        serial_to_tun(inslip, tunfd);
+        serial_to_tun(slipfd, tunfd);
       }
 
       if(FD_ISSET(slipfd, &wset)) {
@@ -1025,12 +1382,15 @@ exit(1);
        if(dmsec>delaymsec) delaymsec=0;
       }
       if(delaymsec==0) {
-        int size;
-        if(slip_empty() && FD_ISSET(tunfd, &rset)) {
-          size=tun_to_serial(tunfd, slipfd);
+        int size = -1;
+        if(FD_ISSET(tunfd, &rset)) {
+          /* Take all packets that are waiting, unless they must be
+             spaced out. */
+          while(slip_space() >= SLIP_FRAME_MAX &&
+                (size = tun_to_serial(tunfd, slipfd)) >= 0 && !basedelay);
           slip_flushbuf(slipfd);
           if(ipa_enable) sigalarm_reset();
-          if(basedelay) {
+          if(basedelay && size >= 0) {
             struct timeval tv;
             gettimeofday(&tv, NULL) ;
  //         delaymsec=basedelay*(1+(size/120));//multiply by # of 6lowpan packets?